@@ -0,0 +1,166 @@
+/* Router benchmark.
+ *
+ * Registers REST style route sets of several sizes, replays a skewed
+ * (zipf) distribution of paths against them and reports time and heap
+ * allocations per routed request, with and without route cache, as well
+ * as urlFor throughput.
+ */
+#include "yahttp/yahttp.hpp"
+#include "yahttp/router.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <new>
+#include <random>
+
+static std::atomic<unsigned long> allocations(0);
+
+void* operator new(std::size_t size) {
+  allocations++;
+  void *ptr = std::malloc(size ? size : 1);
+  if (ptr == NULL) throw std::bad_alloc();
+  return ptr;
+}
+
+void operator delete(void* ptr) noexcept {
+  std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+  std::free(ptr);
+}
+
+static void handler(YaHTTP::Request*, YaHTTP::Response*) {}
+
+struct Target {
+  std::string method;
+  std::string url;
+};
+
+/* registers routes for resources, returns list of urls hitting them */
+static std::vector<Target> setupRoutes(size_t nroutes) {
+  std::vector<Target> targets;
+  YaHTTP::Router::Clear();
+  for(size_t i = 0; YaHTTP::Router::GetRoutes().size() < nroutes; i++) {
+    std::ostringstream base;
+    base << "/api/v1/resource" << i;
+    std::string b = base.str();
+    std::string n = "resource" + std::to_string(i);
+    YaHTTP::Router::Get(b, handler, n + "_index");
+    YaHTTP::Router::Post(b, handler, n + "_create");
+    YaHTTP::Router::Get(b + "/<id:int>", handler, n + "_show");
+    YaHTTP::Router::Put(b + "/<id:int>", handler, n + "_update");
+    YaHTTP::Router::Delete(b + "/<id:int>", handler, n + "_delete");
+    YaHTTP::Router::Get(b + "/<id>/children/<child>.<format>", handler, n + "_child");
+    YaHTTP::Router::Any("/static" + std::to_string(i) + "/<*path>", handler, n + "_static");
+
+    targets.push_back(Target{"GET", b});
+    targets.push_back(Target{"POST", b});
+    targets.push_back(Target{"GET", b + "/1234"});
+    targets.push_back(Target{"PUT", b + "/99"});
+    targets.push_back(Target{"DELETE", b + "/7"});
+    targets.push_back(Target{"GET", b + "/abc/children/def%20ghi.json"});
+    targets.push_back(Target{"HEAD", "/static" + std::to_string(i) + "/css/site.css"});
+  }
+  targets.push_back(Target{"GET", "/not/found"});
+  return targets;
+}
+
+/* zipf distributed indexes, most popular targets are shuffled so they are not all at the start of the table */
+static std::vector<size_t> zipfSequence(size_t n, size_t count, double s) {
+  std::mt19937 rng(42);
+  std::vector<double> weights;
+  std::vector<size_t> order;
+  for(size_t i = 0; i < n; i++) {
+    weights.push_back(1.0 / std::pow(static_cast<double>(i + 1), s));
+    order.push_back(i);
+  }
+  std::shuffle(order.begin(), order.end(), rng);
+  std::discrete_distribution<size_t> dist(weights.begin(), weights.end());
+  std::vector<size_t> seq;
+  for(size_t i = 0; i < count; i++)
+    seq.push_back(order[dist(rng)]);
+  return seq;
+}
+
+static void benchRoute(size_t nroutes, bool cached, size_t iterations) {
+  std::vector<Target> targets = setupRoutes(nroutes);
+  std::vector<YaHTTP::Request> requests(targets.size());
+  std::vector<size_t> seq = zipfSequence(targets.size(), iterations, 1.1);
+  YaHTTP::THandlerFunction func;
+  size_t routed = 0;
+
+  for(size_t i = 0; i < targets.size(); i++)
+    requests[i].setup(targets[i].method, "http://bench.example" + targets[i].url);
+
+  if (cached) YaHTTP::Router::EnableCache(4096);
+
+  unsigned long allocs = allocations;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for(size_t i = 0; i < seq.size(); i++) {
+    if (YaHTTP::Router::Route(&requests[seq[i]], func)) routed++;
+  }
+  std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+  allocs = allocations - allocs;
+
+  double ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+  std::cout << "route    routes=" << std::setw(5) << YaHTTP::Router::GetRoutes().size()
+            << " cache=" << (cached ? "on " : "off")
+            << " ns/route=" << std::setw(9) << std::fixed << std::setprecision(1) << ns / seq.size()
+            << " allocs/route=" << std::setw(6) << std::setprecision(2) << static_cast<double>(allocs) / seq.size()
+            << " routed=" << routed << "/" << seq.size();
+  if (cached)
+    std::cout << " hits=" << YaHTTP::Router::CacheHits() << " misses=" << YaHTTP::Router::CacheMisses();
+  std::cout << std::endl;
+
+  YaHTTP::Router::DisableCache();
+}
+
+static void benchURLFor(size_t nroutes, size_t iterations) {
+  setupRoutes(nroutes);
+  std::vector<std::string> names;
+  YaHTTP::strstr_map_t args;
+  size_t len = 0;
+
+  args["id"] = "1234";
+  args["child"] = "some child";
+  args["format"] = "json";
+  args["path"] = "css/site.css";
+  for(size_t i = 0; i < nroutes / 7; i++) {
+    names.push_back("resource" + std::to_string(i) + "_child");
+    names.push_back("resource" + std::to_string(i) + "_show");
+  }
+  std::vector<size_t> seq = zipfSequence(names.size(), iterations, 1.1);
+
+  unsigned long allocs = allocations;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for(size_t i = 0; i < seq.size(); i++) {
+    len += YaHTTP::Router::URLFor(names[seq[i]], args).second.size();
+  }
+  std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+  allocs = allocations - allocs;
+
+  double ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+  std::cout << "urlFor   routes=" << std::setw(5) << YaHTTP::Router::GetRoutes().size()
+            << " ns/call=" << std::setw(9) << std::fixed << std::setprecision(1) << ns / seq.size()
+            << " calls/s=" << std::setw(10) << std::setprecision(0) << seq.size() / (ns / 1e9)
+            << " allocs/call=" << std::setw(6) << std::setprecision(2) << static_cast<double>(allocs) / seq.size()
+            << " bytes=" << len << std::endl;
+}
+
+int main(int argc, char **argv) {
+  size_t iterations = 200000;
+  if (argc > 1) iterations = std::strtoul(argv[1], NULL, 10);
+
+  const size_t sizes[] = { 14, 105, 1001 };
+  for(size_t i = 0; i < sizeof(sizes)/sizeof(sizes[0]); i++) {
+    benchRoute(sizes[i], false, iterations);
+    benchRoute(sizes[i], true, iterations);
+  }
+  for(size_t i = 0; i < sizeof(sizes)/sizeof(sizes[0]); i++) {
+    benchURLFor(sizes[i], iterations);
+  }
+  return 0;
+}
@@ -0,0 +1,207 @@
+/* Server benchmark.
+ *
+ * Starts ServerPool with increasing number of SO_REUSEPORT workers and
+ * drives it from client threads over loopback with keep-alive connections
+ * and pipelined GET requests. Reports requests per second, scaling
+ * relative to single worker, 99th percentile round trip time of a
+ * pipelined batch and system calls made by workers per request, for epoll
+ * and io_uring backends. System calls are counted by wrapping the libc
+ * functions Server calls, calls from client and main threads are not
+ * counted. Client threads run on the same machine, so they compete with
+ * workers for CPU.
+ */
+#include "yahttp/yahttp.hpp"
+#include "yahttp/router.hpp"
+#include "yahttp/server.hpp"
+
+#ifdef HAVE_SYS_EPOLL_H
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <cstdarg>
+#include <dlfcn.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static std::atomic<unsigned long> syscalls(0);
+static thread_local bool uncounted = false; // set on client and main threads
+
+/* wraps libc function, so that calls from worker threads get counted */
+#define COUNTED(ret, name, params, args) \
+  extern "C" ret name params { \
+    static ret (*real) params = reinterpret_cast<ret (*) params>(::dlsym(RTLD_NEXT, #name)); \
+    if (!uncounted) syscalls++; \
+    return real args; \
+  }
+
+COUNTED(ssize_t, read, (int fd, void* buf, size_t len), (fd, buf, len))
+COUNTED(ssize_t, write, (int fd, const void* buf, size_t len), (fd, buf, len))
+COUNTED(ssize_t, send, (int fd, const void* buf, size_t len, int flags), (fd, buf, len, flags))
+COUNTED(ssize_t, sendfile, (int out, int in, off_t* offset, size_t len), (out, in, offset, len))
+COUNTED(int, accept4, (int fd, struct sockaddr* addr, socklen_t* len, int flags), (fd, addr, len, flags))
+COUNTED(int, close, (int fd), (fd))
+COUNTED(int, shutdown, (int fd, int how), (fd, how))
+COUNTED(int, setsockopt, (int fd, int level, int name, const void* value, socklen_t len), (fd, level, name, value, len))
+COUNTED(int, epoll_ctl, (int epfd, int op, int fd, struct epoll_event* event), (epfd, op, fd, event))
+COUNTED(int, epoll_wait, (int epfd, struct epoll_event* events, int max, int timeout), (epfd, events, max, timeout))
+
+// io_uring_enter is made through syscall(2)
+extern "C" long syscall(long number, ...) {
+  static long (*real)(long, ...) = reinterpret_cast<long (*)(long, ...)>(::dlsym(RTLD_NEXT, "syscall"));
+  long args[6];
+  va_list ap;
+  va_start(ap, number);
+  for(int i = 0; i < 6; i++) args[i] = va_arg(ap, long);
+  va_end(ap);
+  if (!uncounted) syscalls++;
+  return real(number, args[0], args[1], args[2], args[3], args[4], args[5]);
+}
+
+static void handler(YaHTTP::Request* req, YaHTTP::Response* resp) {
+  resp->headers["content-type"] = "text/plain";
+  resp->body = "Hello, " + req->parameters["name"];
+}
+
+static std::atomic<bool> done(false);
+
+/* keeps pipeline of depth requests going on one connection until done, returns number of responses */
+static unsigned long client(int port, size_t depth, std::vector<double>& latencies) {
+  uncounted = true;
+  struct sockaddr_in sa;
+  unsigned long responses = 0;
+  std::string request, batch, buffer;
+  char buf[65536];
+  int val = 1;
+  int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+
+  ::memset(&sa, 0, sizeof(sa));
+  sa.sin_family = AF_INET;
+  sa.sin_port = htons(port);
+  sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &val, sizeof(val));
+  if (::connect(fd, reinterpret_cast<struct sockaddr*>(&sa), sizeof(sa)) < 0) {
+    ::close(fd);
+    return 0;
+  }
+
+  request = "GET /hello/world HTTP/1.1\r\nHost: localhost\r\nUser-Agent: bench_server\r\n\r\n";
+  for(size_t i = 0; i < depth; i++) batch += request;
+
+  while(!done) {
+    std::chrono::steady_clock::time_point sent = std::chrono::steady_clock::now();
+    if (::write(fd, batch.data(), batch.size()) != static_cast<ssize_t>(batch.size())) break;
+    size_t pending = depth;
+    while(pending > 0) {
+      size_t end, len;
+      while((end = buffer.find("\r\n\r\n")) != std::string::npos) {
+        size_t cl = buffer.find("Content-Length: ");
+        if (cl == std::string::npos || cl > end) break;
+        len = std::strtoul(buffer.c_str() + cl + 16, NULL, 10);
+        if (buffer.size() < end + 4 + len) break;
+        buffer.erase(0, end + 4 + len);
+        pending--;
+        responses++;
+      }
+      if (pending == 0) break;
+      ssize_t n = ::read(fd, buf, sizeof(buf));
+      if (n <= 0) {
+        ::close(fd);
+        return responses;
+      }
+      buffer.append(buf, n);
+    }
+    latencies.push_back(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - sent).count());
+  }
+  ::close(fd);
+  return responses;
+}
+
+static double benchWorkers(YaHTTP::serverbackend_t backend, size_t workers, size_t clients, size_t depth, double seconds, double& p99, double& calls) {
+  YaHTTP::ServerPool pool(workers);
+  std::vector<std::thread> threads;
+  std::atomic<unsigned long> total(0);
+  std::vector<double> latencies;
+  std::mutex lock;
+
+  for(size_t i = 0; i < pool.size(); i++) pool.worker(i).backend = backend;
+  pool.pin_cpus = true;
+  pool.listen("127.0.0.1", 0);
+  syscalls = 0;
+  pool.start();
+
+  done = false;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for(size_t i = 0; i < clients; i++) {
+    int port = pool.localPort();
+    threads.push_back(std::thread([port, depth, &total, &latencies, &lock]() {
+      std::vector<double> own;
+      total += client(port, depth, own);
+      std::lock_guard<std::mutex> guard(lock);
+      latencies.insert(latencies.end(), own.begin(), own.end());
+    }));
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(static_cast<long>(seconds * 1000)));
+  done = true;
+  for(size_t i = 0; i < threads.size(); i++) threads[i].join();
+  std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+  pool.stop();
+  pool.join();
+
+  std::sort(latencies.begin(), latencies.end());
+  p99 = (latencies.empty() ? 0 : latencies[latencies.size() * 99 / 100]);
+  calls = (total > 0 ? static_cast<double>(syscalls) / total : 0);
+  double elapsed = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1e6;
+  return total / elapsed;
+}
+
+int main(int argc, char **argv) {
+  double seconds = 2;
+  size_t ncpu = std::thread::hardware_concurrency();
+  size_t depth = 16;
+  const YaHTTP::serverbackend_t backends[] = { YaHTTP::backend_epoll, YaHTTP::backend_uring };
+
+  uncounted = true;
+  if (argc > 1) seconds = std::strtod(argv[1], NULL);
+  if (argc > 2) depth = std::strtoul(argv[2], NULL, 10);
+  if (ncpu == 0) ncpu = 1;
+
+  YaHTTP::Router::Get("/hello/<name>", handler);
+  YaHTTP::Router::EnableThreadCache(1024);
+
+  std::vector<size_t> counts;
+  for(size_t n = 1; n < ncpu; n *= 2) counts.push_back(n);
+  counts.push_back(ncpu);
+
+  for(size_t b = 0; b < sizeof(backends)/sizeof(backends[0]); b++) {
+    double base = 0, p99 = 0, calls = 0;
+    for(size_t i = 0; i < counts.size(); i++) {
+      size_t clients = counts[i] * 4;
+      double rps = benchWorkers(backends[b], counts[i], clients, depth, seconds, p99, calls);
+      if (i == 0) base = rps;
+      std::cout << "server   backend=" << (backends[b] == YaHTTP::backend_uring ? "uring" : "epoll")
+                << " workers=" << std::setw(3) << counts[i]
+                << " clients=" << std::setw(4) << clients
+                << " depth=" << depth
+                << " req/s=" << std::setw(10) << std::fixed << std::setprecision(0) << rps
+                << " scaling=" << std::setprecision(2) << (base > 0 ? rps / base : 0) << "x"
+                << " p99=" << std::setprecision(0) << p99 << "us"
+                << " syscalls/req=" << std::setprecision(3) << calls << std::endl;
+    }
+  }
+  return 0;
+}
+#else
+int main(void) {
+  std::cout << "bench_server needs epoll" << std::endl;
+  return 0;
+}
+#endif
@@ -0,0 +1,121 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_NO_MAIN
+
+#include <boost/test/unit_test.hpp>
+#include "yahttp/yahttp.hpp"
+
+#include <cstdlib>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// directory with a few files to pack, removed when test ends
+struct BundleFixture {
+  BundleFixture() {
+    std::strcpy(dir, "/tmp/yahttp-bundle-XXXXXX");
+    BOOST_REQUIRE(::mkdtemp(dir) != NULL);
+    root = dir;
+    BOOST_REQUIRE(::mkdir((root + "/css").c_str(), 0700) == 0);
+    BOOST_REQUIRE(::mkdir((root + "/many").c_str(), 0700) == 0);
+    for(int i = 0; i < 200; i++) css += ".rule" + std::to_string(i) + " { color: red; }\n";
+    write("/index.html", "<html></html>");
+    write("/css/site.css", css);
+    write("/app.js", "plain");
+    write("/app.js.br", "brotli");
+    write("/lonely.gz", "not a sibling");
+    write("/empty.txt", "");
+    for(int i = 0; i < 100; i++) write("/many/" + std::to_string(i) + ".txt", std::to_string(i));
+  }
+
+  ~BundleFixture() {
+    for(size_t i = 0; i < files.size(); i++) ::unlink(files[i].c_str());
+    ::unlink((root + ".bundle").c_str());
+    ::rmdir((root + "/many").c_str());
+    ::rmdir((root + "/css").c_str());
+    ::rmdir(dir);
+  }
+
+  void write(const std::string& path, const std::string& content) {
+    std::ofstream(root + path, std::ofstream::binary) << content;
+    files.push_back(root + path);
+  }
+
+  char dir[32];
+  std::string root;
+  std::string css;
+  std::vector<std::string> files;
+};
+
+BOOST_FIXTURE_TEST_SUITE(test_bundle, BundleFixture)
+
+BOOST_AUTO_TEST_CASE(test_bundle_pack) {
+  std::string path = root + ".bundle";
+  BOOST_CHECK_EQUAL(YaHTTP::Bundle::pack(root, path, true), 105);
+  YaHTTP::Bundle bundle(path);
+  BOOST_CHECK_EQUAL(bundle.size(), 105);
+  BOOST_CHECK_EQUAL(bundle.str(bundle.entry(0).path), "/app.js");
+
+  // every file is found and nothing else is
+  for(int i = 0; i < 100; i++) {
+    const YaHTTP::Bundle::Entry* e = bundle.find("/many/" + std::to_string(i) + ".txt");
+    BOOST_REQUIRE(e != NULL);
+    BOOST_CHECK_EQUAL(bundle.str(e->variant[YaHTTP::Bundle::coding_identity].content_length), std::to_string(std::to_string(i).size()));
+    BOOST_CHECK(e->variant[YaHTTP::Bundle::coding_identity].offset % 4096 == 0);
+  }
+  BOOST_CHECK(bundle.find("/many/100.txt") == NULL);
+  BOOST_CHECK(bundle.find("/app.js.br") == NULL);
+  BOOST_CHECK(bundle.find("/lonely.gz") != NULL);
+  BOOST_CHECK(bundle.find("") == NULL);
+
+  YaHTTP::Request req;
+  YaHTTP::Response resp;
+  std::ostringstream oss;
+  BOOST_CHECK(bundle.serve("/index.html", resp));
+  BOOST_CHECK_EQUAL(resp.headers["content-type"], "text/html; charset=utf-8");
+  BOOST_CHECK_EQUAL(resp.headers["content-length"], "13");
+  BOOST_CHECK(resp.headers["etag"].size() > 2);
+  BOOST_CHECK(resp.headers["last-modified"].find("GMT") != std::string::npos);
+  resp.status = 200;
+  resp.write(oss);
+  BOOST_CHECK_EQUAL(oss.str().substr(oss.str().find("\r\n\r\n") + 4), "<html></html>");
+
+  // precompressed sibling
+  req.headers["accept-encoding"] = "gzip, br";
+  resp.initialize();
+  BOOST_CHECK(bundle.serve("/app.js", req, resp));
+  BOOST_CHECK_EQUAL(resp.headers["content-encoding"], "br");
+  BOOST_CHECK_EQUAL(resp.headers["content-length"], "6");
+  BOOST_CHECK_EQUAL(resp.headers["vary"], "Accept-Encoding");
+  resp.initialize();
+  BOOST_CHECK(bundle.serve("/empty.txt", req, resp));
+  BOOST_CHECK_EQUAL(resp.headers["content-length"], "0");
+  BOOST_CHECK(resp.headers.find("vary") == resp.headers.end());
+
+#ifdef HAVE_ZLIB
+  // gzip variant made while packing
+  resp.initialize();
+  BOOST_CHECK(bundle.serve("/css/site.css", req, resp));
+  BOOST_CHECK_EQUAL(resp.headers["content-encoding"], "gzip");
+  BOOST_CHECK(std::stoul(resp.headers["content-length"]) < css.size());
+  req.headers.clear();
+  resp.initialize();
+  BOOST_CHECK(bundle.serve("/css/site.css", req, resp));
+  BOOST_CHECK(resp.headers.find("content-encoding") == resp.headers.end());
+  BOOST_CHECK_EQUAL(resp.headers["content-length"], std::to_string(css.size()));
+#endif
+  BOOST_CHECK(!bundle.serve("/missing", req, resp));
+}
+
+BOOST_AUTO_TEST_CASE(test_bundle_invalid) {
+  std::string path = root + ".bundle";
+  BOOST_CHECK_THROW(YaHTTP::Bundle missing(path), YaHTTP::Error);
+  BOOST_CHECK_THROW(YaHTTP::Bundle::pack(root + "/nowhere", path), YaHTTP::Error);
+
+  BOOST_CHECK_EQUAL(YaHTTP::Bundle::pack(root, path), 105);
+  // truncated bundle is refused
+  BOOST_REQUIRE(::truncate(path.c_str(), 4096) == 0);
+  BOOST_CHECK_THROW(YaHTTP::Bundle truncated(path), YaHTTP::Error);
+  std::ofstream(path, std::ofstream::binary | std::ofstream::trunc) << "not a bundle";
+  BOOST_CHECK_THROW(YaHTTP::Bundle garbage(path), YaHTTP::Error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
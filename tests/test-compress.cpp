@@ -0,0 +1,169 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_NO_MAIN
+
+#include <boost/test/unit_test.hpp>
+#include "yahttp/yahttp.hpp"
+
+#include <cstdlib>
+#include <unistd.h>
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+
+// inflates gzip or zlib data
+static std::string inflateData(const std::string& data) {
+  z_stream zs;
+  char buf[4096];
+  std::string result;
+  ::memset(&zs, 0, sizeof(zs));
+  BOOST_REQUIRE(::inflateInit2(&zs, 47) == Z_OK);
+  zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+  zs.avail_in = data.size();
+  int r;
+  do {
+    zs.next_out = reinterpret_cast<Bytef*>(buf);
+    zs.avail_out = sizeof(buf);
+    r = ::inflate(&zs, Z_NO_FLUSH);
+    result.append(buf, sizeof(buf) - zs.avail_out);
+  } while(r == Z_OK);
+  BOOST_CHECK_EQUAL(r, Z_STREAM_END);
+  ::inflateEnd(&zs);
+  return result;
+}
+
+// removes chunked framing
+static std::string dechunk(const std::string& data) {
+  std::string result;
+  size_t pos = 0;
+  while(pos < data.size()) {
+    size_t len = std::strtoul(data.c_str() + pos, NULL, 16);
+    pos = data.find("\r\n", pos) + 2;
+    if (len == 0) break;
+    result.append(data, pos, len);
+    pos += len + 2;
+  }
+  return result;
+}
+#endif
+
+BOOST_AUTO_TEST_SUITE(test_compress)
+
+BOOST_AUTO_TEST_CASE(test_compress_negotiate) {
+  std::vector<std::string> codings = { "br", "gzip" };
+  BOOST_CHECK_EQUAL(YaHTTP::Compression::negotiate("gzip, deflate, br", codings), "br");
+  BOOST_CHECK_EQUAL(YaHTTP::Compression::negotiate("br;q=0.5, gzip", codings), "gzip");
+  BOOST_CHECK_EQUAL(YaHTTP::Compression::negotiate("GZIP;q=0.8, *;q=0.1", codings), "gzip");
+  BOOST_CHECK_EQUAL(YaHTTP::Compression::negotiate("*", codings), "br");
+  BOOST_CHECK_EQUAL(YaHTTP::Compression::negotiate("br;q=0, gzip;q=0", codings), "");
+  BOOST_CHECK_EQUAL(YaHTTP::Compression::negotiate("identity, gzip;q=0.5", codings), "");
+  BOOST_CHECK_EQUAL(YaHTTP::Compression::negotiate("", codings), "");
+  BOOST_CHECK_EQUAL(YaHTTP::Compression::quality("gzip;q=0.25", "gzip"), 0.25);
+  BOOST_CHECK_EQUAL(YaHTTP::Compression::quality("gzip", "identity"), 1);
+  BOOST_CHECK_EQUAL(YaHTTP::Compression::quality("gzip, *;q=0", "identity"), 0);
+
+  BOOST_CHECK(YaHTTP::Compression::compressible("text/html; charset=utf-8"));
+  BOOST_CHECK(YaHTTP::Compression::compressible("application/json"));
+  BOOST_CHECK(YaHTTP::Compression::compressible("application/problem+json"));
+  BOOST_CHECK(!YaHTTP::Compression::compressible("image/png"));
+}
+
+BOOST_AUTO_TEST_CASE(test_compress_precompressed) {
+  char dir[] = "/tmp/yahttp-precompressed-XXXXXX";
+  BOOST_REQUIRE(::mkdtemp(dir) != NULL);
+  std::string path = std::string(dir) + "/app.js";
+  std::ofstream(path) << "plain";
+  std::ofstream(path + ".gz") << "gzipped";
+  std::ofstream(path + ".br") << "brotli";
+  std::string coding;
+
+  BOOST_CHECK_EQUAL(YaHTTP::Compression::precompressed(path, "gzip, br", coding), path + ".br");
+  BOOST_CHECK_EQUAL(coding, "br");
+  BOOST_CHECK_EQUAL(YaHTTP::Compression::precompressed(path, "gzip, zstd", coding), path + ".gz");
+  BOOST_CHECK_EQUAL(coding, "gzip");
+  BOOST_CHECK_EQUAL(YaHTTP::Compression::precompressed(path, "zstd", coding), path);
+  BOOST_CHECK_EQUAL(coding, "");
+
+  // file cache keeps siblings with the file
+  YaHTTP::FileCache cache;
+  YaHTTP::Request req;
+  YaHTTP::Response resp;
+  req.headers["accept-encoding"] = "gzip";
+  BOOST_CHECK(cache.serve(path, req, resp));
+  BOOST_CHECK_EQUAL(resp.headers["content-encoding"], "gzip");
+  BOOST_CHECK_EQUAL(resp.headers["content-type"], "application/javascript; charset=utf-8");
+  BOOST_CHECK_EQUAL(resp.headers["vary"], "Accept-Encoding");
+  BOOST_CHECK_EQUAL(resp.headers["content-length"], "7");
+  req.headers.clear();
+  resp.initialize();
+  BOOST_CHECK(cache.serve(path, req, resp));
+  BOOST_CHECK(resp.headers.find("content-encoding") == resp.headers.end());
+  BOOST_CHECK_EQUAL(resp.headers["content-length"], "5");
+  BOOST_CHECK_EQUAL(cache.size(), 1);
+
+  ::unlink((path + ".br").c_str());
+  ::unlink((path + ".gz").c_str());
+  ::unlink(path.c_str());
+  ::rmdir(dir);
+}
+
+#ifdef HAVE_ZLIB
+BOOST_AUTO_TEST_CASE(test_compress_body) {
+  YaHTTP::Request req;
+  YaHTTP::Response resp;
+  std::string json = "[";
+  for(int i = 0; i < 200; i++) json += "{\"id\":" + std::to_string(i) + ",\"name\":\"item\"},";
+  json += "{}]";
+
+  resp.status = 200;
+  resp.headers["content-type"] = "application/json";
+  resp.headers["etag"] = "\"v1\"";
+  resp.body = json;
+  // client does not accept compression
+  BOOST_CHECK(!YaHTTP::Compression::apply(req, resp));
+  BOOST_CHECK_EQUAL(resp.body, json);
+  BOOST_CHECK_EQUAL(resp.headers["vary"], "Accept-Encoding");
+
+  req.headers["accept-encoding"] = "deflate, gzip";
+  BOOST_CHECK(YaHTTP::Compression::apply(req, resp, 9));
+  BOOST_CHECK_EQUAL(resp.headers["content-encoding"], "gzip");
+  BOOST_CHECK_EQUAL(resp.headers["etag"], "W/\"v1\"");
+  BOOST_CHECK(resp.body.size() < json.size());
+  BOOST_CHECK_EQUAL(inflateData(resp.body), json);
+  // already encoded
+  BOOST_CHECK(!YaHTTP::Compression::apply(req, resp));
+
+  // too small to bother
+  resp.initialize();
+  resp.status = 200;
+  resp.headers["content-type"] = "text/plain";
+  resp.body = "short";
+  BOOST_CHECK(!YaHTTP::Compression::apply(req, resp));
+  BOOST_CHECK_EQUAL(resp.body, "short");
+}
+
+BOOST_AUTO_TEST_CASE(test_compress_render) {
+  YaHTTP::Request req;
+  YaHTTP::Response resp;
+  std::ostringstream oss, content;
+  std::ifstream ifs("request-post-ok.txt", std::ifstream::binary);
+  content << ifs.rdbuf();
+
+  req.headers["accept-encoding"] = "deflate";
+  resp.status = 200;
+  resp.headers["content-type"] = "text/plain";
+  resp.renderer = YaHTTP::HTTPBase::SendFileRender("request-post-ok.txt");
+  BOOST_CHECK(YaHTTP::Compression::apply(req, resp, 6, 0));
+  BOOST_CHECK_EQUAL(resp.headers["content-encoding"], "deflate");
+  oss << resp;
+  std::string data = oss.str();
+  BOOST_CHECK(data.find("Transfer-Encoding: chunked\r\n") != std::string::npos);
+  BOOST_CHECK_EQUAL(inflateData(dechunk(data.substr(data.find("\r\n\r\n") + 4))), content.str());
+
+  // pooled stream is reused
+  oss.str("");
+  resp.write(oss);
+  data = oss.str();
+  BOOST_CHECK_EQUAL(inflateData(dechunk(data.substr(data.find("\r\n\r\n") + 4))), content.str());
+}
+#endif
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -5,6 +5,7 @@
 #include <boost/assign/list_of.hpp>
 #include <boost/foreach.hpp>
 #include "yahttp/yahttp.hpp"
+#include "yahttp/cookiestore.hpp"
 
 BOOST_AUTO_TEST_SUITE(test_cookie)
 
@@ -25,6 +26,17 @@ BOOST_AUTO_TEST_CASE(test_cookie_cookie) {
   BOOST_CHECK_EQUAL(c.str(), "hello%20world=world%20hello; expires=05-May-2014 00:17:36 GMT; domain=test.org; path=/test; secure");
 }
 
+BOOST_AUTO_TEST_CASE(test_cookie_encode) {
+  YaHTTP::Cookie c;
+  c.name = "a=b";
+  c.value = "x;y,z \"50%\"/?:=";
+  BOOST_CHECK_EQUAL(c.str(), "a%3Db=x%3By%2Cz%20%2250%25%22/?:=");
+  YaHTTP::CookieList list;
+  list.parse(c.pair());
+  BOOST_CHECK_EQUAL(list.name(0), "a=b");
+  BOOST_CHECK_EQUAL(list.get("a=b"), c.value);
+}
+
 BOOST_AUTO_TEST_CASE(test_cookie_parse)
 {
   YaHTTP::CookieJar jar;
@@ -49,4 +61,144 @@ BOOST_AUTO_TEST_CASE(test_cookie_parse)
 
 }
 
+BOOST_AUTO_TEST_CASE(test_cookie_serialize)
+{
+  YaHTTP::Cookie c;
+  std::string line = "Set-Cookie: ";
+  c.name = "sess ion";
+  c.value = "v";
+  c.path = "/";
+  BOOST_CHECK_EQUAL(c.str(), "sess%20ion=v; path=/");
+  c.append(line);
+  BOOST_CHECK_EQUAL(line, "Set-Cookie: sess%20ion=v; path=/");
+  BOOST_CHECK_EQUAL(c.pair(), "sess%20ion=v");
+
+  c.secure = true;
+  BOOST_CHECK_EQUAL(c.str(), "sess%20ion=v; path=/; secure");
+  c.expires.fromGmtime(1399210620);
+  BOOST_CHECK_EQUAL(c.str(), "sess%20ion=v; expires=04-May-2014 13:37:00 GMT; path=/; secure");
+  c.value = "w";
+  BOOST_CHECK_EQUAL(c.pair(), "sess%20ion=w");
+
+  YaHTTP::Cookie copy(c);
+  BOOST_CHECK_EQUAL(copy.str(), c.str());
+
+  YaHTTP::Request req;
+  req.setup("GET", "http://example.com/");
+  req.jar.cookies["a"] = c;
+  req.jar.cookies["b"].name = "b";
+  req.jar.cookies["b"].value = "1";
+  BOOST_CHECK_EQUAL(req.str(), "GET / HTTP/1.1\r\nHost: example.com\r\nUser-Agent: YaHTTP v1.0\r\nCookie: sess%20ion=w; b=1\r\n\r\n");
+}
+
+BOOST_AUTO_TEST_CASE(test_cookie_list)
+{
+  YaHTTP::CookieList list;
+  list.parse("a=1;b = two%20words ;; c=x=y;");
+  list.parse("A=3");
+  BOOST_CHECK_EQUAL(list.size(), 4);
+  BOOST_CHECK_EQUAL(list.rawName(1).str(), "b");
+  BOOST_CHECK_EQUAL(list.rawValue(1).str(), "two%20words");
+  BOOST_CHECK_EQUAL(list.get("b"), "two words");
+  BOOST_CHECK_EQUAL(list.get("c"), "x=y");
+  BOOST_CHECK_EQUAL(list.get("a"), "3");
+  BOOST_CHECK(!list.has("d"));
+  BOOST_CHECK_THROW(list.parse("novalue; e=1"), YaHTTP::ParseError);
+
+  YaHTTP::CookieJar jar;
+  list.load(jar, 1);
+  BOOST_CHECK_EQUAL(jar.cookies.size(), 3);
+  BOOST_CHECK_EQUAL(jar.cookies["A"].value, "3");
+}
+
+BOOST_AUTO_TEST_CASE(test_cookie_store)
+{
+  YaHTTP::CookieStore store;
+  YaHTTP::URL url("http://www.Example.com/app/login");
+  time_t now = 1400000000;
+
+  store.storeSetCookie(url, "session=abc; path=/", now);
+  store.storeSetCookie(url, "pref=dark; domain=.example.com; path=/app", now);
+  store.storeSetCookie(url, "local=1", now); // host only, default path /app
+  store.storeSetCookie(url, "token=s%3Bx; path=/; secure", now);
+  BOOST_CHECK(!store.store(url, YaHTTP::Cookie(), now)); // no name
+  BOOST_CHECK_EQUAL(store.size(), 4);
+
+  // foreign and top level domains are rejected
+  YaHTTP::Cookie evil;
+  evil.name = "evil"; evil.value = "1";
+  evil.domain = "other.com";
+  BOOST_CHECK(!store.store(url, evil, now));
+  evil.domain = "com";
+  BOOST_CHECK(!store.store(url, evil, now));
+  evil.domain = "ample.com";
+  BOOST_CHECK(!store.store(url, evil, now));
+
+  BOOST_CHECK_EQUAL(store.cookieHeader(YaHTTP::URL("http://www.example.com/app/page"), now), "pref=dark; local=1; session=abc");
+  BOOST_CHECK_EQUAL(store.cookieHeader(YaHTTP::URL("https://www.example.com/"), now), "session=abc; token=s%3Bx");
+  // header can be parsed back into same cookies
+  YaHTTP::CookieList sent;
+  sent.parse(store.cookieHeader(YaHTTP::URL("https://www.example.com/"), now));
+  BOOST_CHECK_EQUAL(sent.get("token"), "s;x");
+  BOOST_CHECK_EQUAL(store.cookieHeader(YaHTTP::URL("http://static.example.com/app"), now), "pref=dark");
+  BOOST_CHECK_EQUAL(store.cookieHeader(YaHTTP::URL("http://static.example.com/application"), now), "");
+  BOOST_CHECK_EQUAL(store.cookieHeader(YaHTTP::URL("http://example.org/"), now), "");
+
+  // replacing keeps one cookie
+  store.storeSetCookie(url, "session=def; path=/", now);
+  BOOST_CHECK_EQUAL(store.size(), 4);
+
+  YaHTTP::Cookie temp;
+  temp.name = "temp"; temp.value = "x"; temp.path = "/";
+  temp.expires.fromGmtime(now + 60);
+  time_t expires = temp.expires.unixtime();
+  BOOST_CHECK(store.store(url, temp, now));
+  YaHTTP::Request req;
+  req.setup("GET", "http://www.example.com/");
+  store.apply(req, expires - 1);
+  BOOST_CHECK_EQUAL(req.headers["cookie"], "session=def; temp=x");
+  BOOST_CHECK_EQUAL(store.expire(expires), 1);
+  BOOST_CHECK_EQUAL(store.size(), 4);
+
+  // expired cookie removes stored one
+  temp.name = "session";
+  BOOST_CHECK(store.store(YaHTTP::URL("http://www.example.com/"), temp, expires + 1));
+  BOOST_CHECK_EQUAL(store.size(), 3);
+
+  store.clear();
+  BOOST_CHECK_EQUAL(store.size(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_cookie_store_timezone)
+{
+  YaHTTP::CookieStore store;
+  YaHTTP::URL url("http://www.example.com/");
+  time_t expires = 1420070400; // 01-Jan-2015 00:00:00 GMT
+  const char* tz = getenv("TZ");
+  std::string saved(tz ? tz : "");
+
+  // expiration must not depend on local time zone
+  setenv("TZ", "EST5", 1);
+  tzset();
+  store.storeSetCookie(url, "temp=x; expires=01-Jan-2015 00:00:00 GMT", expires - 3600);
+  BOOST_CHECK_EQUAL(store.cookieHeader(url, expires - 1), "temp=x");
+  BOOST_CHECK_EQUAL(store.cookieHeader(url, expires), "");
+
+  // storing again with new expiration keeps only latest one
+  YaHTTP::Cookie temp;
+  temp.name = "temp"; temp.value = "y"; temp.path = "/";
+  for(int i = 0; i < 100; i++) {
+    temp.expires.fromGmtime(expires + i);
+    BOOST_CHECK(store.store(url, temp, expires - 3600));
+  }
+  BOOST_CHECK_EQUAL(store.size(), 1);
+  BOOST_CHECK_EQUAL(store.cookieHeader(url, expires + 98), "temp=y");
+  BOOST_CHECK_EQUAL(store.expire(expires + 98), 0);
+  BOOST_CHECK_EQUAL(store.expire(expires + 99), 1);
+
+  if (tz) setenv("TZ", saved.c_str(), 1);
+  else unsetenv("TZ");
+  tzset();
+}
+
 }
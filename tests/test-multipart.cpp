@@ -0,0 +1,178 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_NO_MAIN
+
+#include <boost/test/unit_test.hpp>
+#include "yahttp/yahttp.hpp"
+
+#include <unistd.h>
+
+static const char formData[] =
+  "preamble is ignored\r\n"
+  "--XyZ\r\n"
+  "Content-Disposition: form-data; name=\"title\"\r\n"
+  "\r\n"
+  "hello world\r\n"
+  "--XyZ  \r\n"
+  "Content-Disposition: form-data; name=\"upload\"; filename=\"a \\\"b\\\".bin\"\r\n"
+  "Content-Type: application/octet-stream\r\n"
+  "\r\n"
+  "\r\n--XyA binary\0 data\r\n-\r\n--X\r\n"
+  "--XyZ\r\n"
+  "content-disposition: form-data; name=empty\r\n"
+  "\r\n"
+  "\r\n"
+  "--XyZ--\r\n"
+  "epilogue is ignored";
+
+static const char fileContents[] = "\r\n--XyA binary\0 data\r\n-\r\n--X";
+static const std::string formBody(formData, sizeof(formData) - 1);
+static const std::string fileData(fileContents, sizeof(fileContents) - 1);
+
+// request with multipart/form-data body
+static std::string makeRequest(const std::string& body) {
+  std::ostringstream request;
+  request << "POST /upload HTTP/1.1\r\nHost: localhost\r\nContent-Type: multipart/form-data; boundary=XyZ\r\nContent-Length: " << body.size() << "\r\n\r\n" << body;
+  return request.str();
+}
+
+// feeds body to parser in pieces of given size and collects parts
+static std::vector<std::pair<YaHTTP::MultipartPart, std::string> > parseForm(const std::string& body, size_t piece) {
+  std::vector<std::pair<YaHTTP::MultipartPart, std::string> > parts;
+  YaHTTP::MultipartParser parser("XyZ");
+  parser.on_begin = [&parts](const YaHTTP::MultipartPart& part) { parts.push_back(std::make_pair(part, std::string())); };
+  parser.on_data = [&parts](const YaHTTP::MultipartPart& part, const char* data, size_t len) { parts.back().second.append(data, len); };
+  parser.on_end = [&parts](const YaHTTP::MultipartPart& part) { parts.back().first = part; };
+  for(size_t pos = 0; pos < body.size(); pos += piece) parser.feed(body.substr(pos, piece));
+  BOOST_CHECK(parser.done());
+  return parts;
+}
+
+BOOST_AUTO_TEST_SUITE(test_multipart)
+
+BOOST_AUTO_TEST_CASE(test_multipart_parser) {
+  std::string body = formBody;
+  BOOST_CHECK_EQUAL(YaHTTP::MultipartParser::boundary("multipart/form-data; boundary=XyZ"), "XyZ");
+  BOOST_CHECK_EQUAL(YaHTTP::MultipartParser::boundary("multipart/form-data; charset=utf-8; Boundary=\"a b;c\""), "a b;c");
+  BOOST_CHECK_EQUAL(YaHTTP::MultipartParser::boundary("multipart/form-data"), "");
+
+  // delimiters split at every position give same parts
+  for(size_t piece = 1; piece <= body.size(); piece++) {
+    std::vector<std::pair<YaHTTP::MultipartPart, std::string> > parts = parseForm(body, piece);
+    BOOST_REQUIRE_EQUAL(parts.size(), 3);
+    BOOST_CHECK_EQUAL(parts[0].first.name, "title");
+    BOOST_CHECK(!parts[0].first.file);
+    BOOST_CHECK_EQUAL(parts[0].first.content_type, "text/plain");
+    BOOST_CHECK_EQUAL(parts[0].second, "hello world");
+    BOOST_CHECK_EQUAL(parts[1].first.name, "upload");
+    BOOST_CHECK(parts[1].first.file);
+    BOOST_CHECK_EQUAL(parts[1].first.filename, "a \"b\".bin");
+    BOOST_CHECK_EQUAL(parts[1].first.content_type, "application/octet-stream");
+    BOOST_CHECK_EQUAL(parts[1].first.size, fileData.size());
+    BOOST_CHECK(parts[1].second == fileData);
+    BOOST_CHECK_EQUAL(parts[2].first.name, "empty");
+    BOOST_CHECK_EQUAL(parts[2].second, "");
+  }
+
+  // delimiter at very start of body
+  BOOST_CHECK_EQUAL(parseForm("--XyZ\r\nContent-Disposition: form-data; name=a\r\n\r\nb\r\n--XyZ--", 1).size(), 1);
+
+  YaHTTP::MultipartParser parser("XyZ");
+  BOOST_CHECK_THROW(parser.feed("--XyZ\r\nContent-Type: text/plain\r\n\r\n"), YaHTTP::ParseError);
+  YaHTTP::MultipartParser garbage("XyZ");
+  BOOST_CHECK_THROW(garbage.feed("--XyZgarbage"), YaHTTP::ParseError);
+  YaHTTP::MultipartParser huge("XyZ");
+  huge.max_header_size = 64;
+  huge.feed("--XyZ\r\n");
+  BOOST_CHECK_THROW(huge.feed(std::string(100, 'x')), YaHTTP::ParseError);
+}
+
+BOOST_AUTO_TEST_CASE(test_multipart_loader) {
+  std::string body = formBody;
+  std::string data = makeRequest(body);
+  YaHTTP::Request req;
+  YaHTTP::AsyncRequestLoader arl;
+  std::string path;
+
+  arl.parse_multipart = true;
+  arl.initialize(&req);
+  for(size_t pos = 0; pos < data.size(); pos += 7) arl.feed(data.substr(pos, 7));
+  BOOST_REQUIRE(arl.ready());
+  arl.finalize();
+  BOOST_CHECK_EQUAL(req.body, "");
+  BOOST_CHECK_EQUAL(req.postvars.size(), 2);
+  BOOST_CHECK_EQUAL(req.POST()["title"], "hello world");
+  BOOST_CHECK_EQUAL(req.POST()["empty"], "");
+  BOOST_REQUIRE_EQUAL(req.uploads.size(), 1);
+  BOOST_CHECK_EQUAL(req.uploads[0].name, "upload");
+  BOOST_CHECK_EQUAL(req.uploads[0].size, fileData.size());
+  path = req.uploads[0].path;
+  std::ifstream ifs(path, std::ifstream::binary);
+  std::ostringstream content;
+  content << ifs.rdbuf();
+  BOOST_CHECK(content.str() == fileData);
+  // temporary file goes with request
+  req.initialize();
+  BOOST_CHECK(::access(path.c_str(), F_OK) < 0);
+
+  // unless it is kept
+  arl.initialize(&req);
+  BOOST_CHECK(arl.feed(data));
+  arl.finalize();
+  BOOST_REQUIRE_EQUAL(req.uploads.size(), 1);
+  path = req.uploads[0].path;
+  std::string kept = path + ".kept";
+  BOOST_CHECK(req.uploads[0].keep(kept));
+  BOOST_CHECK_EQUAL(req.uploads[0].path, kept);
+  BOOST_CHECK(!req.uploads[0].keep(kept + ".again"));
+  req.initialize();
+  BOOST_CHECK(::access(path.c_str(), F_OK) < 0);
+  BOOST_CHECK(::access(kept.c_str(), F_OK) == 0);
+  ::unlink(kept.c_str());
+
+  // or released
+  arl.initialize(&req);
+  BOOST_CHECK(arl.feed(data));
+  arl.finalize();
+  BOOST_REQUIRE_EQUAL(req.uploads.size(), 1);
+  path = req.uploads[0].path;
+  req.uploads[0].release();
+  req.initialize();
+  BOOST_CHECK(::access(path.c_str(), F_OK) == 0);
+  ::unlink(path.c_str());
+
+  // file contents to callback
+  std::string received;
+  bool ended = false;
+  arl.upload = [&](YaHTTP::Request* r, const YaHTTP::MultipartPart& part, const char* d, size_t len) {
+    BOOST_CHECK(r == &req);
+    if (d == NULL) ended = true;
+    else received.append(d, len);
+  };
+  arl.initialize(&req);
+  BOOST_CHECK(arl.feed(data));
+  arl.finalize();
+  BOOST_CHECK(ended);
+  BOOST_CHECK(received == fileData);
+  BOOST_CHECK(req.uploads.empty());
+  BOOST_CHECK_EQUAL(req.POST()["title"], "hello world");
+
+  // field over max_field_size
+  arl.max_field_size = 5;
+  arl.initialize(&req);
+  BOOST_CHECK_THROW(arl.feed(data), YaHTTP::ParseError);
+  arl.max_field_size = 65536;
+
+  // body ends before closing delimiter
+  arl.initialize(&req);
+  BOOST_CHECK_THROW(arl.feed(makeRequest(body.substr(0, body.find("--XyZ--")))), YaHTTP::ParseError);
+
+  // disabled
+  arl.parse_multipart = false;
+  arl.initialize(&req);
+  BOOST_CHECK(arl.feed(data));
+  arl.finalize();
+  BOOST_CHECK(req.body == body);
+  BOOST_CHECK(req.postvars.empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -80,6 +80,49 @@ BOOST_CHECK_EQUAL(req.COOKIES()["more"].value, "values");
 BOOST_CHECK_EQUAL(req.COOKIES()["just"].value, "like this");
 BOOST_CHECK_EQUAL(req.COOKIES()["even"].value, "more");
 BOOST_CHECK_EQUAL(req.COOKIES()["cookies"].value, "kääkkä");
+
+std::ifstream ifs2("request-get-cookies-ok.txt");
+YaHTTP::AsyncRequestLoader arl;
+std::string data((std::istreambuf_iterator<char>(ifs2)), std::istreambuf_iterator<char>());
+arl.parse_cookies = false;
+arl.initialize(&req);
+arl.initializeNext(&req);
+BOOST_CHECK(arl.feed(data));
+arl.finalize();
+BOOST_CHECK(req.jar.cookies.empty());
+BOOST_CHECK_EQUAL(req.cookies.size(), 6);
+BOOST_CHECK_EQUAL(req.cookies.get("TYPE"), "data");
+BOOST_CHECK_EQUAL(req.cookies.rawValue(req.cookies.find("just")).str(), "like%20this");
+BOOST_CHECK_EQUAL(req.COOKIES()["just"].value, "like this");
+BOOST_CHECK_EQUAL(req.COOKIES()["type"].value, "data");
+BOOST_CHECK_EQUAL(req.jar.cookies.size(), 5);
+}
+
+BOOST_AUTO_TEST_CASE(test_request_parse_query)
+{
+std::istringstream iss("GET /search?tag=a&tag=b&q=x%20y HTTP/1.1\r\nHost: test.org\r\n\r\n");
+YaHTTP::Request req;
+iss >> req;
+
+BOOST_CHECK_EQUAL(req.query.size(), 3);
+BOOST_CHECK_EQUAL(req.query.getAll("tag").size(), 2);
+BOOST_CHECK_EQUAL(req.query.getAll("tag")[1], "b");
+BOOST_CHECK_EQUAL(req.getvars["tag"], "b");
+BOOST_CHECK_EQUAL(req.getvars["q"], "x y");
+
+YaHTTP::AsyncRequestLoader arl;
+arl.parse_getvars = false;
+arl.initialize(&req);
+BOOST_CHECK(arl.feed("GET /search?tag=a&tag=b&q=x%20y HTTP/1.1\r\nHost: test.org\r\n\r\nGET /next?q=z HTTP/1.1\r\nHost: test.org\r\n\r\n"));
+arl.finalize();
+BOOST_CHECK(req.getvars.empty());
+BOOST_CHECK_EQUAL(req.query.get("q"), "x y");
+// kept for next request on same stream
+arl.initializeNext(&req);
+BOOST_CHECK(arl.feed("", 0));
+arl.finalize();
+BOOST_CHECK(req.getvars.empty());
+BOOST_CHECK_EQUAL(req.query.get("q"), "z");
 }
 
 BOOST_AUTO_TEST_CASE(test_request_build_post) 
@@ -116,6 +159,43 @@ ifs>>req;
 BOOST_CHECK_EQUAL(req.body, "{\"login\":\"cmouse\",\"pwhash\":\"1234\",\"remote\":\"127.0.0.1\"}");
 }
 
+BOOST_AUTO_TEST_CASE(test_request_chunked_limit)
+{
+YaHTTP::Request req;
+YaHTTP::AsyncRequestLoader arl;
+arl.initialize(&req);
+req.max_request_size = 10;
+BOOST_CHECK(arl.feed("POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n5\r\nhello\r\n5\r\nworld\r\n0\r\n\r\n"));
+arl.finalize();
+BOOST_CHECK_EQUAL(req.body, "helloworld");
+
+// refused at chunk size, before chunk is buffered
+arl.initialize(&req);
+req.max_request_size = 10;
+BOOST_CHECK_THROW(arl.feed("POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n5\r\nhello\r\n6\r\n"), YaHTTP::SizeError);
+}
+
+BOOST_AUTO_TEST_CASE(test_request_chunked_stream)
+{
+YaHTTP::Request req;
+YaHTTP::AsyncRequestLoader arl;
+std::string data(100000, 'x');
+size_t largest = 0;
+arl.initialize(&req);
+BOOST_CHECK(!arl.feed("POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n186a0\r\n"));
+// chunk data is not kept in buffer until chunk is complete
+for(size_t i = 0; i < data.size(); i += 1000) {
+  BOOST_CHECK(!arl.feed(data.substr(i, 1000)));
+  largest = std::max(largest, arl.buffer.size());
+}
+BOOST_CHECK(largest < 1000);
+BOOST_CHECK(!arl.feed("\r"));
+BOOST_CHECK(!arl.feed("\n0\r"));
+BOOST_CHECK(arl.feed("\n\r\n"));
+arl.finalize();
+BOOST_CHECK_EQUAL(req.body, data);
+}
+
 BOOST_AUTO_TEST_CASE(test_request_version)
 {
 YaHTTP::Request req;
@@ -199,6 +279,95 @@ Host: example.org\r\n\
 User-Agent: YaHTTP v1.0\r\n\r\n");
 }
 
+BOOST_AUTO_TEST_CASE(test_request_headers_complete)
+{
+YaHTTP::Request req;
+YaHTTP::AsyncRequestLoader arl;
+int calls = 0;
+arl.headers_complete = [&calls](YaHTTP::Request* target) {
+  calls++;
+  return target->headers["x-upload"] != "deny";
+};
+
+// accepted request loads as usual
+arl.initialize(&req);
+BOOST_CHECK(!arl.feed("POST /upload HTTP/1.1\r\nContent-Length: 4\r\n"));
+BOOST_CHECK(!arl.headersReady());
+BOOST_CHECK_EQUAL(calls, 0);
+BOOST_CHECK(!arl.feed("\r\nbo"));
+BOOST_CHECK(arl.headersReady());
+BOOST_CHECK_EQUAL(calls, 1);
+BOOST_CHECK(arl.feed("dy"));
+arl.finalize();
+BOOST_CHECK_EQUAL(req.body, "body");
+BOOST_CHECK_EQUAL(calls, 1);
+
+// rejected request stops before body
+arl.initialize(&req);
+BOOST_CHECK(!arl.feed("POST /upload HTTP/1.1\r\nX-Upload: deny\r\nContent-Length: 4\r\n\r\nbody"));
+BOOST_CHECK(arl.headersReady());
+BOOST_CHECK(!arl.ready());
+BOOST_CHECK(!arl.feed("more"));
+BOOST_CHECK_EQUAL(calls, 2);
+BOOST_CHECK(req.body.empty());
+}
+
+#ifdef HAVE_ZLIB
+BOOST_AUTO_TEST_CASE(test_request_inflate)
+{
+std::string form, compressed, chunked, request;
+for(int i = 0; i < 50; i++) form += "field" + std::to_string(i) + "=" + std::string(100, 'a' + i % 26) + "&";
+form += "last=1";
+BOOST_REQUIRE(YaHTTP::Compression::compress(form, compressed, "gzip"));
+
+// fed byte by byte with Content-Length
+YaHTTP::Request req;
+YaHTTP::AsyncRequestLoader arl;
+arl.inflate = true;
+arl.initialize(&req);
+request = "POST /upload HTTP/1.1\r\nContent-Type: application/x-www-form-urlencoded\r\nContent-Encoding: gzip\r\nContent-Length: " + std::to_string(compressed.size()) + "\r\n\r\n" + compressed;
+for(size_t i = 0; i < request.size(); i++)
+  BOOST_CHECK_EQUAL(arl.feed(request.data() + i, 1), i + 1 == request.size());
+arl.finalize();
+BOOST_CHECK_EQUAL(req.body, form);
+BOOST_CHECK_EQUAL(req.POST()["last"], "1");
+BOOST_CHECK(req.headers.find("content-encoding") == req.headers.end());
+BOOST_CHECK_EQUAL(req.headers["content-length"], std::to_string(form.size()));
+
+// chunked, reusing inflater
+for(size_t i = 0; i < compressed.size(); i += 100) {
+  std::ostringstream chunk;
+  size_t n = std::min(static_cast<size_t>(100), compressed.size() - i);
+  chunk << std::hex << n << "\r\n" << compressed.substr(i, n) << "\r\n";
+  chunked += chunk.str();
+}
+arl.initialize(&req);
+BOOST_CHECK(arl.feed("POST /upload HTTP/1.1\r\nContent-Encoding: gzip\r\nTransfer-Encoding: chunked\r\n\r\n" + chunked + "0\r\n\r\n"));
+arl.finalize();
+BOOST_CHECK_EQUAL(req.body, form);
+
+// inflated size is limited
+arl.max_inflated_size = 1000;
+arl.initialize(&req);
+BOOST_CHECK_THROW(arl.feed(request), YaHTTP::ParseError);
+
+// truncated and invalid data
+arl.max_inflated_size = 1048576;
+arl.initialize(&req);
+BOOST_CHECK_THROW(arl.feed("POST / HTTP/1.1\r\nContent-Encoding: gzip\r\nContent-Length: 10\r\n\r\n" + compressed.substr(0, 10)), YaHTTP::ParseError);
+arl.initialize(&req);
+BOOST_CHECK_THROW(arl.feed("POST / HTTP/1.1\r\nContent-Encoding: deflate\r\nContent-Length: 10\r\n\r\nnot zipped"), YaHTTP::ParseError);
+
+// left alone when not asked for
+arl.inflate = false;
+arl.initialize(&req);
+BOOST_CHECK(arl.feed(request));
+arl.finalize();
+BOOST_CHECK_EQUAL(req.body, compressed);
+BOOST_CHECK_EQUAL(req.headers["content-encoding"], "gzip");
+}
+#endif
+
 }
 BOOST_AUTO_TEST_CASE(test_get_host_ipv6_literal_with_port) 
 {
@@ -146,4 +146,197 @@ BOOST_AUTO_TEST_CASE(test_response_content_length) {
   BOOST_CHECK_EQUAL(oss.str(), "HTTP/1.1 200 OK\r\nContent-Length: 12\r\nContent-Type: text/html; charset=utf-8\r\n\r\nhello, world");
 }
 
+BOOST_AUTO_TEST_CASE(test_response_zero_copy_file) {
+  YaHTTP::Response resp;
+  std::ostringstream oss, expected;
+  std::ifstream ifs("response-binary.txt", std::ifstream::binary);
+  expected << ifs.rdbuf();
+
+  resp.status = 200;
+  resp.renderer = YaHTTP::HTTPBase::ZeroCopyFileRender("response-binary.txt");
+  BOOST_CHECK(resp.renderer.target<YaHTTP::HTTPBase::ZeroCopyFileRender>()->valid());
+  oss << resp;
+  // length comes from the file, no chunking
+  BOOST_CHECK_EQUAL(oss.str(), "HTTP/1.1 200 OK\r\nContent-Length: " + std::to_string(expected.str().size()) + "\r\n\r\n" + expected.str());
+
+  YaHTTP::HTTPBase::ZeroCopyFileRender missing("no-such-file.txt");
+  BOOST_CHECK(!missing.valid());
+  resp.renderer = missing;
+  oss.str("");
+  oss << resp;
+  BOOST_CHECK_EQUAL(oss.str(), "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n0\r\n\r\n");
+}
+
+BOOST_AUTO_TEST_CASE(test_response_conditional) {
+  YaHTTP::Request req;
+  YaHTTP::Response resp;
+  std::ostringstream oss;
+  req.method = "GET";
+
+  // validators
+  resp.status = 200;
+  resp.headers["etag"] = "\"v1\"";
+  resp.headers["last-modified"] = "Sun, 06 Nov 1994 08:49:37 GMT";
+  resp.body = "hello, world";
+  req.headers["if-none-match"] = "\"v0\", W/\"v1\"";
+  resp.applyConditional(req);
+  BOOST_CHECK_EQUAL(resp.status, 304);
+  oss << resp;
+  BOOST_CHECK_EQUAL(oss.str(), "HTTP/1.1 304 Not Modified\r\nEtag: \"v1\"\r\nLast-Modified: Sun, 06 Nov 1994 08:49:37 GMT\r\n\r\n");
+
+  req.headers.clear();
+  req.headers["if-modified-since"] = "Sun, 06 Nov 1994 08:49:37 GMT";
+  resp.status = 200;
+  resp.applyConditional(req);
+  BOOST_CHECK_EQUAL(resp.status, 304);
+  req.headers["if-modified-since"] = "Sun, 06 Nov 1994 09:00:00 GMT";
+  resp.status = 200;
+  resp.applyConditional(req);
+  BOOST_CHECK_EQUAL(resp.status, 304);
+  req.headers["if-modified-since"] = "Sat, 05 Nov 1994 08:49:37 GMT";
+  resp.status = 200;
+  resp.body = "hello, world";
+  resp.applyConditional(req);
+  BOOST_CHECK_EQUAL(resp.status, 200);
+  BOOST_CHECK_EQUAL(resp.body, "hello, world");
+
+  // single range from body
+  req.headers.clear();
+  req.headers["range"] = "bytes=-5";
+  resp.applyConditional(req);
+  BOOST_CHECK_EQUAL(resp.status, 206);
+  BOOST_CHECK_EQUAL(resp.headers["content-range"], "bytes 7-11/12");
+  oss.str("");
+  oss << resp;
+  BOOST_CHECK(oss.str().find("Content-Length: 5\r\n") != std::string::npos);
+  BOOST_CHECK_EQUAL(oss.str().substr(oss.str().size() - 9), "\r\n\r\nworld");
+
+  // several ranges, overlapping ones are coalesced
+  resp.initialize();
+  resp.status = 200;
+  resp.headers["content-type"] = "text/plain";
+  resp.body = "hello, world";
+  req.headers["range"] = "bytes=0-1, 1-3,7-";
+  resp.applyConditional(req);
+  BOOST_CHECK_EQUAL(resp.status, 206);
+  BOOST_CHECK(resp.headers["content-type"].find("multipart/byteranges; boundary=") == 0);
+  std::string boundary = resp.headers["content-type"].substr(31);
+  oss.str("");
+  oss << resp;
+  std::string expected = "--" + boundary + "\r\nContent-Type: text/plain\r\nContent-Range: bytes 0-3/12\r\n\r\nhell"
+    "\r\n--" + boundary + "\r\nContent-Type: text/plain\r\nContent-Range: bytes 7-11/12\r\n\r\nworld"
+    "\r\n--" + boundary + "--\r\n";
+  BOOST_CHECK_EQUAL(oss.str().substr(oss.str().size() - expected.size()), expected);
+  BOOST_CHECK(oss.str().find("Content-Length: " + std::to_string(expected.size()) + "\r\n") != std::string::npos);
+
+  // unsatisfiable, invalid and stale ranges
+  resp.initialize();
+  resp.status = 200;
+  resp.body = "hello, world";
+  req.headers["range"] = "bytes=12-";
+  resp.applyConditional(req);
+  BOOST_CHECK_EQUAL(resp.status, 416);
+  BOOST_CHECK_EQUAL(resp.headers["content-range"], "bytes */12");
+  resp.initialize();
+  resp.status = 200;
+  resp.body = "hello, world";
+  req.headers["range"] = "bytes=5-1";
+  resp.applyConditional(req);
+  BOOST_CHECK_EQUAL(resp.status, 200);
+  req.headers["range"] = "bytes=0-1";
+  req.headers["if-range"] = "\"v2\"";
+  resp.headers["etag"] = "\"v1\"";
+  resp.applyConditional(req);
+  BOOST_CHECK_EQUAL(resp.status, 200);
+  req.headers["if-range"] = "\"v1\"";
+  resp.applyConditional(req);
+  BOOST_CHECK_EQUAL(resp.status, 206);
+
+  // files are sliced, and get validators
+  std::ifstream ifs("response-binary.txt", std::ifstream::binary);
+  std::ostringstream content;
+  content << ifs.rdbuf();
+  req.headers.clear();
+  req.headers["range"] = "bytes=10-19";
+  resp.initialize();
+  resp.status = 200;
+  resp.renderer = YaHTTP::HTTPBase::ZeroCopyFileRender("response-binary.txt");
+  resp.applyConditional(req);
+  BOOST_CHECK_EQUAL(resp.status, 206);
+  BOOST_CHECK(resp.headers.find("etag") != resp.headers.end());
+  BOOST_CHECK_EQUAL(resp.headers["accept-ranges"], "bytes");
+  oss.str("");
+  oss << resp;
+  BOOST_CHECK_EQUAL(oss.str().substr(oss.str().size() - 14), "\r\n\r\n" + content.str().substr(10, 10));
+}
+
+BOOST_AUTO_TEST_CASE(test_response_file_cache) {
+  char path[] = "/tmp/yahttp-cache-XXXXXX.txt";
+  int fd = ::mkstemps(path, 4);
+  BOOST_REQUIRE(fd > -1);
+  BOOST_REQUIRE(::write(fd, "hello", 5) == 5);
+  ::close(fd);
+
+  YaHTTP::FileCache cache(1024*1024, 0); // compare with disk on every lookup
+  YaHTTP::Response resp;
+  std::ostringstream oss;
+  resp.status = 200;
+  BOOST_CHECK(cache.serve(path, resp));
+  BOOST_CHECK_EQUAL(resp.headers["content-type"], "text/plain; charset=utf-8");
+  BOOST_CHECK_EQUAL(resp.headers["content-length"], "5");
+  BOOST_CHECK_EQUAL(resp.headers["etag"], cache.get(path)->etag);
+  BOOST_CHECK_EQUAL(resp.headers["last-modified"].size(), 29);
+  oss << resp;
+  BOOST_CHECK(oss.str().find("\r\n\r\nhello") != std::string::npos);
+  BOOST_CHECK_EQUAL(cache.size(), 1);
+  BOOST_CHECK_EQUAL(cache.hits(), 1);
+
+  // same file object is returned until the file changes
+  std::shared_ptr<const YaHTTP::StaticFile> first = cache.get(path);
+  BOOST_CHECK(cache.get(path) == first);
+  std::ofstream ofs(path, std::ofstream::trunc);
+  ofs << "hello, world";
+  ofs.close();
+  std::shared_ptr<const YaHTTP::StaticFile> second = cache.get(path);
+  BOOST_REQUIRE(second);
+  BOOST_CHECK(second != first);
+  BOOST_CHECK_EQUAL(std::string(second->data, second->size), "hello, world");
+  BOOST_CHECK_EQUAL(std::string(first->data, first->size), "hello"); // earlier responses keep their copy
+
+  // larger files are sent from the open file, so truncating them only shortens responses already made
+  YaHTTP::FileCache large(1024*1024, 0, 4);
+  resp.initialize();
+  resp.status = 200;
+  BOOST_CHECK(large.serve(path, resp));
+  BOOST_CHECK(resp.renderer.target<YaHTTP::HTTPBase::ZeroCopyFileRender>() != NULL);
+  BOOST_CHECK(large.get(path)->data == NULL);
+  BOOST_CHECK_EQUAL(resp.headers["content-length"], "12");
+  BOOST_REQUIRE(::truncate(path, 5) == 0);
+  oss.str("");
+  oss << resp;
+  BOOST_CHECK(oss.str().find("\r\n\r\nhello") == oss.str().size() - 9);
+
+  // files kept open are cached even when they are larger than capacity / 16
+  YaHTTP::FileCache small(16*1024, 1000, 4);
+  BOOST_REQUIRE(::truncate(path, 64*1024) == 0);
+  std::shared_ptr<const YaHTTP::StaticFile> opened = small.get(path);
+  BOOST_REQUIRE(opened);
+  BOOST_CHECK(opened->data == NULL);
+  BOOST_CHECK(small.get(path) == opened);
+  BOOST_CHECK_EQUAL(small.hits(), 1);
+  BOOST_CHECK_EQUAL(small.size(), 1);
+
+  // request paths cannot climb out of directory they are appended to
+  BOOST_CHECK(!cache.serve("/tmp/../" + std::string(path), resp));
+  BOOST_CHECK(!cache.serve("/tmp/..", resp));
+  BOOST_CHECK(YaHTTP::FileCache::climbs("a/../b"));
+  BOOST_CHECK(!YaHTTP::FileCache::climbs("/a..b/..c/d.."));
+
+  ::unlink(path);
+  BOOST_CHECK(!cache.get(path));
+  BOOST_CHECK_EQUAL(cache.size(), 0);
+  BOOST_CHECK_EQUAL(YaHTTP::StaticFile::contentType("style.CSS"), "text/css; charset=utf-8");
+  BOOST_CHECK_EQUAL(YaHTTP::StaticFile::contentType("dir.d/README"), "application/octet-stream");
+}
+
 }
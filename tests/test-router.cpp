@@ -7,6 +7,8 @@
 #include <boost/foreach.hpp>
 #include "yahttp/yahttp.hpp"
 #include "yahttp/router.hpp"
+#include "yahttp/staticrouter.hpp"
+#include <thread>
 
 using namespace boost;
 
@@ -34,6 +36,24 @@ public:
 
 std::map<std::string, bool> RouteTargetHandler::routes;
 
+YAHTTP_STATIC_ROUTER(static_routes,
+  YAHTTP_STATIC_ROUTE("GET", "/obj/<id:int>", RouteTargetHandler::Handler, "static_obj_id"),
+  YAHTTP_STATIC_ROUTE("GET", "/obj/<name:slug>", RouteTargetHandler::Handler, "static_obj_name"),
+  YAHTTP_STATIC_ROUTE("", "/test/<object>/<attribute>.<format>", RouteTargetHandler::ObjectHandler, "static_object"),
+  YAHTTP_STATIC_ROUTE("GET", "/glob/<*everything>", RouteTargetHandler::GlobHandler, "static_glob")
+);
+
+static_assert(YaHTTP::StaticRouteMask::valid("/<a>/<b:int>.<*c>"), "valid mask");
+static_assert(!YaHTTP::StaticRouteMask::valid("/<a"), "unclosed parameter");
+static_assert(!YaHTTP::StaticRouteMask::valid("/<a<b>>"), "nested parameter");
+static_assert(!YaHTTP::StaticRouteMask::valid("/a>"), "stray >");
+static_assert(!YaHTTP::StaticRouteMask::valid("/<a:float>"), "unknown type");
+static_assert(!YaHTTP::StaticRouteMask::valid("/<*a:int>"), "typed glob");
+static_assert(!YaHTTP::StaticRouteMask::validMethod("get"), "lowercase method");
+static_assert(static_routes.head.segments[0].kind == YaHTTP::segment_literal && static_routes.head.segments[0].length == 5, "literal resolved at compile time");
+static_assert(static_routes.head.segments[1].type == YaHTTP::param_int && static_routes.head.segments[2].kind == YaHTTP::segment_end, "parameter resolved at compile time");
+static_assert(static_routes.tail.tail.head.segments[3].delim == '.', "delimiter resolved at compile time");
+
 struct RouterFixture {
   RouterFixture() { 
     BOOST_TEST_MESSAGE("Setup router");
@@ -142,6 +162,203 @@ BOOST_AUTO_TEST_CASE( test_router_missing_urlFor ) {
   BOOST_CHECK_THROW((void)YaHTTP::Router::URLFor("object_attribute_format", params), YaHTTP::Error);
 }
 
+BOOST_AUTO_TEST_CASE( test_router_typed ) {
+  YaHTTP::Request req;
+  YaHTTP::THandlerFunction func = rth.NonHandler;
+
+  YaHTTP::Router::Get("/obj/<id:int>", rth.Handler, "obj_id");
+  YaHTTP::Router::Get("/obj/<id:hex>.<format:slug>", rth.Handler, "obj_hex");
+  YaHTTP::Router::Get("/obj/<uuid:uuid>", rth.Handler, "obj_uuid");
+  YaHTTP::Router::Get("/obj/<name:slug>", rth.Handler, "obj_name");
+  YaHTTP::Router::Get("/obj/<name>", rth.Handler, "obj_other");
+
+  req.setup("get", "http://test.org/obj/-1234");
+  BOOST_CHECK(YaHTTP::Router::Route(&req, func));
+  BOOST_CHECK_EQUAL(req.routeName, "obj_id");
+  BOOST_CHECK_EQUAL(req.intParameter("id"), -1234);
+  BOOST_CHECK_EQUAL(req.parameters["id"], "-1234");
+
+  req.setup("get", "http://test.org/obj/ff.json");
+  BOOST_CHECK(YaHTTP::Router::Route(&req, func));
+  BOOST_CHECK_EQUAL(req.routeName, "obj_hex");
+  BOOST_CHECK_EQUAL(req.intParameter("id"), 255);
+  BOOST_CHECK_EQUAL(req.parameters["format"], "json");
+
+  req.setup("get", "http://test.org/obj/123e4567-e89b-12d3-a456-426614174000");
+  BOOST_CHECK(YaHTTP::Router::Route(&req, func));
+  BOOST_CHECK_EQUAL(req.routeName, "obj_uuid");
+  BOOST_CHECK_EQUAL(req.parameters["uuid"], "123e4567-e89b-12d3-a456-426614174000");
+  BOOST_CHECK_THROW(req.intParameter("uuid"), YaHTTP::Error);
+
+  req.setup("get", "http://test.org/obj/my-object_1");
+  BOOST_CHECK(YaHTTP::Router::Route(&req, func));
+  BOOST_CHECK_EQUAL(req.routeName, "obj_name");
+
+  // overflows are not integers
+  req.setup("get", "http://test.org/obj/99999999999999999999");
+  BOOST_CHECK(YaHTTP::Router::Route(&req, func));
+  BOOST_CHECK_EQUAL(req.routeName, "obj_name");
+
+  req.setup("get", "http://test.org/obj/hello%20world");
+  BOOST_CHECK(YaHTTP::Router::Route(&req, func));
+  BOOST_CHECK_EQUAL(req.routeName, "obj_other");
+  BOOST_CHECK_EQUAL(req.parameters["name"], "hello world");
+
+  std::pair<std::string, std::string> route;
+  YaHTTP::strstr_map_t params;
+  params["id"] = "10";
+  params["format"] = "xml";
+  route = YaHTTP::Router::URLFor("obj_hex", params);
+  BOOST_CHECK_EQUAL(route.second, "/obj/10.xml");
+}
+
+BOOST_AUTO_TEST_CASE( test_router_invalid_mask ) {
+  BOOST_CHECK_THROW(YaHTTP::Router::Get("/obj/<id:float>", rth.Handler), YaHTTP::Error);
+  BOOST_CHECK_THROW(YaHTTP::Router::Get("/obj/<*id:int>", rth.Handler), YaHTTP::Error);
+  BOOST_CHECK_THROW(YaHTTP::Router::Get("/obj/<id", rth.Handler), YaHTTP::Error);
+}
+
+BOOST_AUTO_TEST_CASE( test_router_cache ) {
+  YaHTTP::Request req;
+  YaHTTP::THandlerFunction func = rth.NonHandler;
+
+  YaHTTP::Router::EnableCache(16);
+  req.setup("get", "http://test.org/test/1234/name.json");
+  BOOST_CHECK(YaHTTP::Router::Route(&req, func));
+  BOOST_CHECK_EQUAL(YaHTTP::Router::CacheMisses(), 1);
+  BOOST_CHECK_EQUAL(YaHTTP::Router::CacheHits(), 0);
+
+  req.parameters.clear();
+  req.routeName = "";
+  BOOST_CHECK(YaHTTP::Router::Route(&req, func));
+  BOOST_CHECK_EQUAL(YaHTTP::Router::CacheHits(), 1);
+  BOOST_CHECK_EQUAL(req.routeName, "object_attribute_format_get");
+  BOOST_CHECK_EQUAL(req.parameters["object"], "1234");
+  BOOST_CHECK_EQUAL(req.parameters["format"], "json");
+
+  // adding routes invalidates cached results
+  YaHTTP::Router::Get("/test/<object>/name.json", rth.Handler, "shadowed");
+  BOOST_CHECK(YaHTTP::Router::Route(&req, func));
+  BOOST_CHECK_EQUAL(req.routeName, "object_attribute_format_get");
+  // stale entry is a miss, not a hit
+  BOOST_CHECK_EQUAL(YaHTTP::Router::CacheHits(), 1);
+  BOOST_CHECK_EQUAL(YaHTTP::Router::CacheMisses(), 2);
+
+  YaHTTP::Router::Clear();
+  YaHTTP::Router::Get("/test/<object>/name.json", rth.Handler, "only");
+  BOOST_CHECK(YaHTTP::Router::Route(&req, func));
+  BOOST_CHECK_EQUAL(req.routeName, "only");
+
+  // concurrent routing
+  std::vector<std::thread> threads;
+  for(int i = 0; i < 4; i++) {
+    threads.push_back(std::thread([i]() {
+      for(int j = 0; j < 1000; j++) {
+        YaHTTP::Request treq;
+        YaHTTP::THandlerFunction tfunc;
+        std::ostringstream oss;
+        oss << "http://test.org/test/" << (i * 1000 + j) % 40 << "/name.json";
+        treq.setup("get", oss.str());
+        if (!YaHTTP::Router::Route(&treq, tfunc) || treq.parameters["object"] != std::to_string((i * 1000 + j) % 40))
+          throw std::runtime_error("routing failed");
+      }
+    }));
+  }
+  for(std::vector<std::thread>::iterator i = threads.begin(); i != threads.end(); i++)
+    i->join();
+  BOOST_CHECK_EQUAL(YaHTTP::Router::CacheHits() + YaHTTP::Router::CacheMisses(), 4004);
+  YaHTTP::Router::DisableCache();
+}
+
+BOOST_AUTO_TEST_CASE( test_router_thread_cache ) {
+  YaHTTP::Request req;
+  YaHTTP::THandlerFunction func = rth.NonHandler;
+
+  YaHTTP::Router::EnableThreadCache(16);
+  req.setup("get", "http://test.org/test/1234/name.json");
+  BOOST_CHECK(YaHTTP::Router::Route(&req, func));
+  BOOST_CHECK(YaHTTP::Router::Route(&req, func));
+  BOOST_CHECK_EQUAL(req.routeName, "object_attribute_format_get");
+
+  // thread caches are invalidated too
+  YaHTTP::Router::Clear();
+  YaHTTP::Router::Get("/test/<object>/name.json", rth.Handler, "only");
+  BOOST_CHECK(YaHTTP::Router::Route(&req, func));
+  BOOST_CHECK_EQUAL(req.routeName, "only");
+
+  std::vector<std::thread> threads;
+  for(int i = 0; i < 4; i++) {
+    threads.push_back(std::thread([i]() {
+      for(int j = 0; j < 1000; j++) {
+        YaHTTP::Request treq;
+        YaHTTP::THandlerFunction tfunc;
+        std::ostringstream oss;
+        oss << "http://test.org/test/" << (i * 1000 + j) % 40 << "/name.json";
+        treq.setup("get", oss.str());
+        if (!YaHTTP::Router::Route(&treq, tfunc) || treq.parameters["object"] != std::to_string((i * 1000 + j) % 40))
+          throw std::runtime_error("routing failed");
+      }
+    }));
+  }
+  for(std::vector<std::thread>::iterator i = threads.begin(); i != threads.end(); i++)
+    i->join();
+  // counters of exited threads are kept
+  BOOST_CHECK_EQUAL(YaHTTP::Router::CacheHits() + YaHTTP::Router::CacheMisses(), 4003);
+  BOOST_CHECK(YaHTTP::Router::CacheHits() > 0);
+  YaHTTP::Router::DisableThreadCache();
+  BOOST_CHECK_EQUAL(YaHTTP::Router::CacheHits() + YaHTTP::Router::CacheMisses(), 0);
+}
+
+BOOST_AUTO_TEST_CASE( test_router_static ) {
+  YaHTTP::Request req;
+  YaHTTP::Response resp;
+  YaHTTP::TStaticHandler handler = NULL;
+
+  BOOST_CHECK_EQUAL(static_routes.size(), 4);
+
+  req.setup("get", "http://test.org/obj/42");
+  BOOST_CHECK(static_routes.route(&req, handler));
+  BOOST_CHECK(handler == &RouteTargetHandler::Handler);
+  BOOST_CHECK_EQUAL(req.routeName, "static_obj_id");
+  BOOST_CHECK_EQUAL(req.intParameter("id"), 42);
+
+  req.setup("get", "http://test.org/obj/answer");
+  BOOST_CHECK(static_routes.route(&req, &resp));
+  BOOST_CHECK(rth.routes["static_obj_name"]);
+
+  req.setup("patch", "http://test.org/test/1234/name.json");
+  BOOST_CHECK(static_routes.route(&req, &resp));
+  BOOST_CHECK(rth.routes["static_object"]);
+
+  req.setup("get", "http://test.org/glob/truly and really/everything/there/is.json");
+  BOOST_CHECK(static_routes.route(&req, &resp));
+  BOOST_CHECK(rth.routes["static_glob"]);
+
+  req.setup("post", "http://test.org/obj/42");
+  BOOST_CHECK(!static_routes.route(&req, &resp));
+
+  // parameters need at least one character, like with Router
+  req.setup("get", "http://test.org/glob/");
+  BOOST_CHECK(!static_routes.route(&req, handler));
+  req.setup("get", "http://test.org/obj/");
+  BOOST_CHECK(!static_routes.route(&req, handler));
+  req.setup("get", "http://test.org/test/a%20b/c.d");
+  BOOST_CHECK(static_routes.route(&req, handler));
+  BOOST_CHECK_EQUAL(req.routeName, "static_object");
+  BOOST_CHECK_EQUAL(req.parameters["object"], "a b");
+  BOOST_CHECK_EQUAL(req.parameters["attribute"], "c");
+  BOOST_CHECK_EQUAL(req.parameters["format"], "d");
+
+  std::ostringstream dest;
+  static_routes.printRoutes(dest);
+  std::string tmp = dest.str();
+  boost::erase_all(tmp, " ");
+  BOOST_CHECK_EQUAL(tmp, "GET/obj/<id:int>static_obj_id\n\
+GET/obj/<name:slug>static_obj_name\n\
+/test/<object>/<attribute>.<format>static_object\n\
+GET/glob/<*everything>static_glob\n");
+}
+
 BOOST_AUTO_TEST_CASE( test_router_print_routes ) {
   std::ostringstream dest;
   YaHTTP::Router::PrintRoutes(dest);
@@ -0,0 +1,486 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_NO_MAIN
+
+#include <boost/test/unit_test.hpp>
+#include "yahttp/yahttp.hpp"
+#include "yahttp/router.hpp"
+#include "yahttp/server.hpp"
+
+#ifdef HAVE_SYS_EPOLL_H
+#include <atomic>
+#include <thread>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace boost;
+
+static void helloHandler(YaHTTP::Request *req, YaHTTP::Response *resp) {
+  resp->headers["content-type"] = "text/plain";
+  resp->body = "hello " + req->getvars["name"];
+}
+
+static void echoHandler(YaHTTP::Request *req, YaHTTP::Response *resp) {
+  resp->body = req->body;
+}
+
+static void uploadHandler(YaHTTP::Request *req, YaHTTP::Response *resp) {
+  resp->body = req->POST()["title"];
+  for(size_t i = 0; i < req->uploads.size(); i++) {
+    std::ifstream ifs(req->uploads[i].path, std::ifstream::binary);
+    std::ostringstream content;
+    content << ifs.rdbuf();
+    resp->body += " " + req->uploads[i].filename + "=" + content.str();
+  }
+}
+
+static void failHandler(YaHTTP::Request *req, YaHTTP::Response *resp) {
+  throw std::runtime_error("failed");
+}
+
+static void oddFailHandler(YaHTTP::Request *req, YaHTTP::Response *resp) {
+  throw 42;
+}
+
+// sends data in given pieces and reads until server closes connection
+static std::string exchangeWith(int port, const std::vector<std::string>& pieces) {
+  struct sockaddr_in sa;
+  struct timeval tv = { 5, 0 };
+  std::string result;
+  char buf[4096];
+  ssize_t n;
+  int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+
+  ::memset(&sa, 0, sizeof(sa));
+  sa.sin_family = AF_INET;
+  sa.sin_port = htons(port);
+  sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  BOOST_REQUIRE(::connect(fd, reinterpret_cast<struct sockaddr*>(&sa), sizeof(sa)) == 0);
+  for(size_t i = 0; i < pieces.size(); i++) {
+    BOOST_REQUIRE(::write(fd, pieces[i].data(), pieces[i].size()) == static_cast<ssize_t>(pieces[i].size()));
+    if (i + 1 < pieces.size()) std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  }
+  while((n = ::read(fd, buf, sizeof(buf))) > 0) result.append(buf, n);
+  ::close(fd);
+  return result;
+}
+
+static void fileHandler(YaHTTP::Request *req, YaHTTP::Response *resp) {
+  resp->headers["content-type"] = "text/plain";
+  resp->renderer = YaHTTP::HTTPBase::ZeroCopyFileRender("response-binary.txt");
+}
+
+static YaHTTP::FileCache fileCache;
+
+static void cachedHandler(YaHTTP::Request *req, YaHTTP::Response *resp) {
+  if (!fileCache.serve("response-binary.txt", *resp)) resp->status = 404;
+}
+
+struct ServerFixture {
+  YaHTTP::Server server;
+  std::thread thread;
+
+  ServerFixture(YaHTTP::serverbackend_t backend = YaHTTP::backend_epoll, bool async_files = false) {
+    server.backend = backend;
+    server.async_files = async_files;
+    YaHTTP::Router::Get("/hello", helloHandler, "hello");
+    YaHTTP::Router::Post("/echo", echoHandler, "echo");
+    YaHTTP::Router::Post("/upload", uploadHandler, "upload");
+    YaHTTP::Router::Get("/fail", failHandler, "fail");
+    YaHTTP::Router::Get("/oddfail", oddFailHandler, "oddfail");
+    YaHTTP::Router::Map("HEAD", "/hello", helloHandler, "hello_head");
+    YaHTTP::Router::Any("/file", fileHandler, "file");
+    YaHTTP::Router::Any("/cached", cachedHandler, "cached");
+    server.listen("127.0.0.1", 0);
+    thread = std::thread([this]() { server.run(); });
+  }
+
+  ~ServerFixture() {
+    server.stop();
+    thread.join();
+    YaHTTP::Router::Clear();
+  }
+
+  std::string exchange(const std::vector<std::string>& pieces) {
+    return exchangeWith(server.localPort(), pieces);
+  }
+
+  std::string exchange(const std::string& data) {
+    return exchangeWith(server.localPort(), std::vector<std::string>(1, data));
+  }
+};
+
+static size_t count(const std::string& haystack, const std::string& needle) {
+  size_t n = 0;
+  for(size_t pos = haystack.find(needle); pos != std::string::npos; pos = haystack.find(needle, pos + 1)) n++;
+  return n;
+}
+
+struct UringServerFixture: public ServerFixture {
+  UringServerFixture(): ServerFixture(YaHTTP::backend_uring) {};
+};
+
+static void checkPipelined(ServerFixture& fixture) {
+  std::string result = fixture.exchange(
+    "GET /hello?name=one HTTP/1.1\r\nHost: localhost\r\n\r\n"
+    "POST /echo HTTP/1.1\r\nHost: localhost\r\nContent-Length: 4\r\n\r\nbody"
+    "GET /hello?name=two HTTP/1.1\r\nHost: localhost\r\n\r\n"
+    "GET /missing HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n");
+
+  BOOST_CHECK_EQUAL(count(result, "HTTP/1.1 200 OK"), 3);
+  BOOST_CHECK_EQUAL(count(result, "HTTP/1.1 404 Not Found"), 1);
+  BOOST_CHECK(result.find("Content-Length: 9\r\n") != std::string::npos);
+  BOOST_CHECK(result.find("\r\n\r\nhello one") != std::string::npos);
+  BOOST_CHECK(result.find("Content-Length: 4\r\n\r\nbody") != std::string::npos);
+  BOOST_CHECK(result.find("hello two") > result.find("hello one"));
+  BOOST_CHECK(result.find("Connection: close") > result.find("hello two"));
+}
+
+static void checkSplitReads(ServerFixture& fixture) {
+  std::vector<std::string> pieces;
+  pieces.push_back("GET /hello?name=split HT");
+  pieces.push_back("TP/1.1\r\nHost: localhost\r\n\r\nPOST /echo HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n3\r\nabc\r\n");
+  pieces.push_back("0\r\n\r\nGET /hello HTTP/1.1\r\nConnection: close\r\n\r\n");
+  std::string result = fixture.exchange(pieces);
+
+  BOOST_CHECK_EQUAL(count(result, "HTTP/1.1 200 OK"), 3);
+  BOOST_CHECK(result.find("hello split") != std::string::npos);
+  BOOST_CHECK(result.find("\r\n\r\nabc") != std::string::npos);
+}
+
+// responses larger than socket buffers need several sends
+static void checkLarge(ServerFixture& fixture) {
+  YaHTTP::Router::Post("/large", [](YaHTTP::Request *req, YaHTTP::Response *resp) { resp->body = std::string(4 * 1048576, 'x'); }, "large");
+  std::string result = fixture.exchange("POST /large HTTP/1.1\r\nContent-Length: 0\r\n\r\nGET /hello?name=after HTTP/1.1\r\nConnection: close\r\n\r\n");
+  BOOST_CHECK_EQUAL(count(result, "HTTP/1.1 200 OK"), 2);
+  BOOST_CHECK(result.find("\r\n\r\n" + std::string(4 * 1048576, 'x') + "HTTP/1.1 200 OK") != std::string::npos);
+  BOOST_CHECK(result.find("hello after") != std::string::npos);
+}
+
+// files rendered with ZeroCopyFileRender or from FileCache get Content-Length and are placed between pipelined responses
+static void checkFile(ServerFixture& fixture, const std::string& path = "/file") {
+  std::ostringstream expected;
+  std::ifstream ifs("response-binary.txt", std::ifstream::binary);
+  expected << ifs.rdbuf();
+  std::string length = "Content-Length: " + std::to_string(expected.str().size()) + "\r\n";
+
+  std::string result = fixture.exchange(
+    "GET " + path + " HTTP/1.1\r\n\r\n"
+    "HEAD " + path + " HTTP/1.1\r\n\r\n"
+    "GET " + path + " HTTP/1.0\r\nConnection: keep-alive\r\n\r\n"
+    "GET /hello?name=last HTTP/1.1\r\nConnection: close\r\n\r\n");
+  BOOST_CHECK_EQUAL(count(result, length), 3);
+  BOOST_CHECK_EQUAL(count(result, "\r\n\r\n" + expected.str() + "HTTP/1.1 200 OK"), 2);
+  BOOST_CHECK_EQUAL(count(result, "\r\n\r\nHTTP/1.0 200 OK"), 1);
+  BOOST_CHECK_EQUAL(count(result, "\r\n\r\n" + expected.str() + "HTTP/1.1 200 OK\r\nConnection: close"), 1);
+  BOOST_CHECK(result.find("hello last") != std::string::npos);
+}
+
+// ranges are sent as slices of file or cached memory, and validators answer with 304 without body
+static void checkRanges(ServerFixture& fixture, const std::string& path) {
+  std::ostringstream expected;
+  std::ifstream ifs("response-binary.txt", std::ifstream::binary);
+  expected << ifs.rdbuf();
+  std::string content = expected.str();
+  std::string size = std::to_string(content.size());
+
+  std::string result = fixture.exchange(
+    "GET " + path + " HTTP/1.1\r\nRange: bytes=1-3\r\n\r\n"
+    "GET " + path + " HTTP/1.1\r\nRange: bytes=0-0,-1\r\n\r\n"
+    "GET " + path + " HTTP/1.1\r\nIf-None-Match: *\r\n\r\n"
+    "GET " + path + " HTTP/1.1\r\nRange: bytes=" + size + "-\r\n\r\n"
+    "GET /hello?name=last HTTP/1.1\r\nConnection: close\r\n\r\n");
+  BOOST_CHECK_EQUAL(count(result, "HTTP/1.1 206 Partial Content\r\n"), 2);
+  BOOST_CHECK(result.find("Content-Range: bytes 1-3/" + size + "\r\n") != std::string::npos);
+  BOOST_CHECK(result.find("\r\n\r\n" + content.substr(1, 3) + "HTTP/1.1 206") != std::string::npos);
+  BOOST_CHECK(result.find("Content-Range: bytes 0-0/" + size + "\r\n\r\n" + content.substr(0, 1) + "\r\n--") != std::string::npos);
+  BOOST_CHECK(result.find("Content-Range: bytes " + std::to_string(content.size() - 1) + "-" + std::to_string(content.size() - 1) + "/" + size + "\r\n\r\n" + content.substr(content.size() - 1) + "\r\n--") != std::string::npos);
+  BOOST_CHECK(result.find("--\r\nHTTP/1.1 304 Not Modified\r\n") != std::string::npos);
+  BOOST_CHECK(result.find("\r\n\r\nHTTP/1.1 416 Range Not Satisfiable\r\n") != std::string::npos);
+  BOOST_CHECK(result.find("hello last") != std::string::npos);
+}
+
+static std::string bigFile;
+
+// files are read in chunks off the loop, several chunks ahead of pipelined responses, io_uring reads them without async_files too
+static void checkAsyncFiles(YaHTTP::serverbackend_t backend, bool async_files = true) {
+  char path[] = "/tmp/yahttp-async-XXXXXX";
+  int fd = ::mkstemp(path);
+  BOOST_REQUIRE(fd > -1);
+  std::string content;
+  for(size_t i = 0; content.size() < 300000; i++) content += std::to_string(i) + "\n";
+  BOOST_REQUIRE(::write(fd, content.data(), content.size()) == static_cast<ssize_t>(content.size()));
+  ::close(fd);
+  bigFile = path;
+
+  std::ostringstream expected;
+  std::ifstream ifs("response-binary.txt", std::ifstream::binary);
+  expected << ifs.rdbuf();
+  {
+    ServerFixture fixture(backend, async_files);
+    YaHTTP::Router::Get("/big", [](YaHTTP::Request *req, YaHTTP::Response *resp) { resp->renderer = YaHTTP::HTTPBase::ZeroCopyFileRender(bigFile); }, "big");
+    YaHTTP::Router::Get("/plain", [](YaHTTP::Request *req, YaHTTP::Response *resp) { resp->renderer = YaHTTP::HTTPBase::SendFileRender("response-binary.txt"); }, "plain");
+    checkFile(fixture);
+    checkRanges(fixture, "/file");
+    checkRanges(fixture, "/cached");
+
+    std::string result = fixture.exchange(
+      "GET /big HTTP/1.1\r\n\r\n"
+      "GET /plain HTTP/1.1\r\n\r\n"
+      "GET /big HTTP/1.1\r\nRange: bytes=70000-\r\n\r\n"
+      "GET /hello?name=last HTTP/1.1\r\nConnection: close\r\n\r\n");
+    BOOST_CHECK(result.find("Content-Length: " + std::to_string(content.size()) + "\r\n") != std::string::npos);
+    BOOST_CHECK(result.find("\r\n\r\n" + content + "HTTP/1.1 200 OK") != std::string::npos);
+    BOOST_CHECK(result.find("Content-Length: " + std::to_string(expected.str().size()) + "\r\n\r\n" + expected.str() + "HTTP/1.1 206") != std::string::npos);
+    BOOST_CHECK(result.find("\r\n\r\n" + content.substr(70000) + "HTTP/1.1 200 OK") != std::string::npos);
+    BOOST_CHECK(result.find("hello last") != std::string::npos);
+    BOOST_CHECK(result.find("Transfer-Encoding") == std::string::npos);
+  }
+  ::unlink(path);
+}
+
+// requests with body are decided about before body is read
+static void checkExpect(ServerFixture& fixture) {
+  std::vector<std::string> pieces;
+  pieces.push_back("POST /echo HTTP/1.1\r\nExpect: 100-continue\r\nContent-Length: 4\r\n\r\n");
+  pieces.push_back("bodyGET /hello?name=last HTTP/1.1\r\nConnection: close\r\n\r\n");
+  std::string result = fixture.exchange(pieces);
+  BOOST_CHECK(result.find("HTTP/1.1 100 Continue\r\n\r\nHTTP/1.1 200 OK\r\n") == 0);
+  BOOST_CHECK(result.find("\r\n\r\nbodyHTTP/1.1 200 OK") != std::string::npos);
+  BOOST_CHECK(result.find("hello last") != std::string::npos);
+
+  fixture.server.checkHeaders = [](YaHTTP::Request *req, YaHTTP::Response *resp) {
+    if (req->headers.find("x-deny") != req->headers.end()) resp->status = 403;
+  };
+  result = fixture.exchange("POST /echo HTTP/1.1\r\nExpect: 100-continue\r\nX-Deny: 1\r\nContent-Length: 4\r\n\r\n");
+  BOOST_CHECK(result.find("HTTP/1.1 403 Forbidden\r\n") == 0);
+  BOOST_CHECK(result.find("Connection: close\r\n") != std::string::npos);
+  result = fixture.exchange("POST /nowhere HTTP/1.1\r\nExpect: 100-continue\r\nContent-Length: 4\r\n\r\n");
+  BOOST_CHECK(result.find("HTTP/1.1 404 Not Found\r\n") == 0);
+  result = fixture.exchange("POST /echo HTTP/1.1\r\nContent-Length: 1000000000000\r\n\r\n");
+  BOOST_CHECK(result.find("HTTP/1.1 413 ") == 0);
+  result = fixture.exchange("POST /echo HTTP/1.1\r\nExpect: something\r\nContent-Length: 4\r\n\r\nbody");
+  BOOST_CHECK(result.find("HTTP/1.1 417 Expectation Failed\r\n") == 0);
+  // Expect of HTTP/1.0 is ignored
+  result = fixture.exchange("POST /echo HTTP/1.0\r\nExpect: 100-continue\r\nContent-Length: 4\r\n\r\nbody");
+  BOOST_CHECK(result.find("HTTP/1.0 200 OK\r\n") == 0);
+  BOOST_CHECK_EQUAL(count(result, "100 Continue"), 0);
+
+  // request is routed once, handler found by check is used for it
+  YaHTTP::Router::EnableCache(16);
+  result = fixture.exchange("POST /echo HTTP/1.1\r\nContent-Length: 4\r\nConnection: close\r\n\r\nbody");
+  BOOST_CHECK(result.find("\r\n\r\nbody") != std::string::npos);
+  BOOST_CHECK_EQUAL(YaHTTP::Router::CacheHits() + YaHTTP::Router::CacheMisses(), 1);
+  YaHTTP::Router::DisableCache();
+}
+
+// rejected requests are answered even when client sends body without waiting for 100 Continue
+static void checkLinger(ServerFixture& fixture) {
+  std::string body(8 * 1048576, 'x');
+  fixture.server.max_request_size = 65536;
+  std::string result = fixture.exchange("POST /echo HTTP/1.1\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body);
+  BOOST_CHECK(result.find("HTTP/1.1 413 ") == 0);
+
+  // chunked bodies are limited as they arrive
+  std::string chunked = "POST /echo HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n";
+  for(size_t i = 0; i < 64; i++) chunked += "8000\r\n" + body.substr(0, 32768) + "\r\n";
+  result = fixture.exchange(chunked + "0\r\n\r\n");
+  BOOST_CHECK(result.find("HTTP/1.1 413 ") == 0);
+  BOOST_CHECK(result.find("Connection: close\r\n") != std::string::npos);
+  result = fixture.exchange("POST /echo HTTP/1.1\r\nTransfer-Encoding: chunked\r\nConnection: close\r\n\r\n4\r\nbody\r\n0\r\n\r\n");
+  BOOST_CHECK(result.find("\r\n\r\nbody") != std::string::npos);
+}
+
+BOOST_FIXTURE_TEST_SUITE( test_server, ServerFixture )
+
+BOOST_AUTO_TEST_CASE( test_server_file ) {
+  checkFile(*this);
+}
+
+BOOST_AUTO_TEST_CASE( test_server_cached_file ) {
+  checkFile(*this, "/cached");
+  BOOST_CHECK(fileCache.hits() > 0);
+}
+
+BOOST_AUTO_TEST_CASE( test_server_ranges ) {
+  checkRanges(*this, "/file");
+  checkRanges(*this, "/cached");
+}
+
+BOOST_AUTO_TEST_CASE( test_server_pipelined ) {
+  checkPipelined(*this);
+}
+
+BOOST_AUTO_TEST_CASE( test_server_split_reads ) {
+  checkSplitReads(*this);
+}
+
+BOOST_AUTO_TEST_CASE( test_server_expect ) {
+  checkExpect(*this);
+}
+
+BOOST_AUTO_TEST_CASE( test_server_linger ) {
+  checkLinger(*this);
+}
+
+BOOST_AUTO_TEST_CASE( test_server_parse_getvars ) {
+  server.parse_getvars = false;
+  std::string result = exchange(
+    "GET /hello?name=one HTTP/1.1\r\n\r\n"
+    "GET /hello?name=two HTTP/1.1\r\nConnection: close\r\n\r\n");
+  BOOST_CHECK_EQUAL(count(result, "HTTP/1.1 200 OK"), 2);
+  BOOST_CHECK_EQUAL(count(result, "Content-Length: 6\r\n"), 2);
+  BOOST_CHECK(result.find("hello one") == std::string::npos);
+}
+
+BOOST_AUTO_TEST_CASE( test_server_multipart ) {
+  std::string body = "--b\r\nContent-Disposition: form-data; name=title\r\n\r\nhi\r\n"
+    "--b\r\nContent-Disposition: form-data; name=f; filename=a.txt\r\n\r\nfile data\r\n--b--\r\n";
+  std::string head = "POST /upload HTTP/1.1\r\nConnection: close\r\nContent-Type: multipart/form-data; boundary=b\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n";
+  std::vector<std::string> pieces;
+  pieces.push_back(head + body.substr(0, 60));
+  pieces.push_back(body.substr(60));
+  server.parse_multipart = true;
+  std::string result = exchange(pieces);
+  BOOST_CHECK(result.find("HTTP/1.1 200 OK") == 0);
+  BOOST_CHECK_EQUAL(result.substr(result.find("\r\n\r\n") + 4), "hi a.txt=file data");
+}
+
+BOOST_AUTO_TEST_CASE( test_server_large ) {
+  checkLarge(*this);
+  BOOST_CHECK(server.activeBackend() == YaHTTP::backend_epoll);
+}
+
+BOOST_AUTO_TEST_CASE( test_server_http10 ) {
+  std::string result = exchange(
+    "GET /hello?name=old HTTP/1.0\r\n\r\n"
+    "GET /hello?name=ignored HTTP/1.0\r\n\r\n");
+
+  BOOST_CHECK_EQUAL(count(result, "HTTP/1.0 200 OK"), 1);
+  BOOST_CHECK(result.find("Connection: close") != std::string::npos);
+  BOOST_CHECK(result.find("hello old") != std::string::npos);
+
+  result = exchange(
+    "GET /hello?name=old HTTP/1.0\r\nConnection: keep-alive\r\n\r\n"
+    "GET /hello?name=again HTTP/1.0\r\n\r\n");
+  BOOST_CHECK_EQUAL(count(result, "HTTP/1.0 200 OK"), 2);
+  BOOST_CHECK(result.find("Connection: keep-alive") != std::string::npos);
+}
+
+BOOST_AUTO_TEST_CASE( test_server_head ) {
+  std::string result = exchange("HEAD /hello?name=head HTTP/1.1\r\nConnection: close\r\n\r\n");
+  BOOST_CHECK(result.find("HTTP/1.1 200 OK") == 0);
+  BOOST_CHECK(result.find("Content-Length: 10\r\n") != std::string::npos);
+  BOOST_CHECK_EQUAL(result.substr(result.find("\r\n\r\n") + 4), "");
+}
+
+BOOST_AUTO_TEST_CASE( test_server_errors ) {
+  std::string result = exchange("GET /fail HTTP/1.1\r\nConnection: close\r\n\r\n");
+  BOOST_CHECK(result.find("HTTP/1.1 500 Internal Server Error") == 0);
+  // not derived from std::exception
+  result = exchange("GET /oddfail HTTP/1.1\r\n\r\nGET /hello?name=after HTTP/1.1\r\nConnection: close\r\n\r\n");
+  BOOST_CHECK(result.find("HTTP/1.1 500 Internal Server Error") == 0);
+  BOOST_CHECK(result.find("hello after") != std::string::npos);
+
+  result = exchange("GET /hello HTTP/1.1\r\nBad Header\r\n\r\n");
+  BOOST_CHECK(result.find("HTTP/1.1 400 Bad Request") == 0);
+
+  BOOST_CHECK_THROW(server.listen("127.0.0.1", 0), YaHTTP::Error);
+  YaHTTP::Server other;
+  BOOST_CHECK_THROW(other.listen("not an address", 0), YaHTTP::Error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_FIXTURE_TEST_SUITE( test_server_uring, UringServerFixture )
+
+BOOST_AUTO_TEST_CASE( test_server_uring_pipelined ) {
+  checkPipelined(*this);
+}
+
+BOOST_AUTO_TEST_CASE( test_server_uring_split_reads ) {
+  checkSplitReads(*this);
+}
+
+BOOST_AUTO_TEST_CASE( test_server_uring_expect ) {
+  checkExpect(*this);
+}
+
+BOOST_AUTO_TEST_CASE( test_server_uring_linger ) {
+  checkLinger(*this);
+}
+
+BOOST_AUTO_TEST_CASE( test_server_uring_file ) {
+  checkFile(*this);
+}
+
+BOOST_AUTO_TEST_CASE( test_server_uring_cached_file ) {
+  checkFile(*this, "/cached");
+}
+
+BOOST_AUTO_TEST_CASE( test_server_uring_ranges ) {
+  checkRanges(*this, "/file");
+  checkRanges(*this, "/cached");
+}
+
+BOOST_AUTO_TEST_CASE( test_server_uring_large ) {
+  checkLarge(*this);
+  BOOST_CHECK(server.activeBackend() == YaHTTP::backend_uring);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE( test_server_workers )
+
+BOOST_AUTO_TEST_CASE( test_server_pool ) {
+  YaHTTP::Router::Get("/hello", helloHandler, "hello");
+  YaHTTP::Router::EnableThreadCache(16);
+  {
+    YaHTTP::ServerPool pool(3);
+    BOOST_CHECK_EQUAL(pool.size(), 3);
+    for(size_t i = 0; i < pool.size(); i++) BOOST_CHECK(pool.worker(i).reuse_port);
+    pool.pin_cpus = true;
+    pool.listen("127.0.0.1", 0);
+    BOOST_CHECK(pool.localPort() > 0);
+    for(size_t i = 0; i < pool.size(); i++) BOOST_CHECK_EQUAL(pool.worker(i).localPort(), pool.localPort());
+    pool.start();
+    BOOST_CHECK_THROW(pool.start(), YaHTTP::Error);
+
+    std::vector<std::thread> clients;
+    std::atomic<int> ok(0);
+    int port = pool.localPort();
+    for(int i = 0; i < 8; i++) {
+      clients.push_back(std::thread([port, &ok]() {
+        std::string result = exchangeWith(port, std::vector<std::string>(1,
+          "GET /hello?name=pool HTTP/1.1\r\n\r\nGET /hello?name=pool HTTP/1.1\r\nConnection: close\r\n\r\n"));
+        if (count(result, "hello pool") == 2) ok++;
+      }));
+    }
+    for(size_t i = 0; i < clients.size(); i++) clients[i].join();
+    BOOST_CHECK_EQUAL(ok, 8);
+    // stopped and joined by destructor
+  }
+  YaHTTP::Router::DisableThreadCache();
+  YaHTTP::Router::Clear();
+}
+
+BOOST_AUTO_TEST_CASE( test_server_async_files ) {
+  checkAsyncFiles(YaHTTP::backend_epoll);
+}
+
+BOOST_AUTO_TEST_CASE( test_server_uring_async_files ) {
+  checkAsyncFiles(YaHTTP::backend_uring);
+  checkAsyncFiles(YaHTTP::backend_uring, false);
+}
+
+BOOST_AUTO_TEST_CASE( test_server_stop_before_run ) {
+  YaHTTP::Server server;
+  server.stop();
+  server.run(); // returns at once
+  BOOST_CHECK_EQUAL(server.connections(), 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+#endif
@@ -61,6 +61,99 @@ BOOST_AUTO_TEST_CASE(test_url_data) {
   BOOST_CHECK_EQUAL(url.parameters, "base64:9vdas9t64gadsf=");
 }
 
+BOOST_AUTO_TEST_CASE(test_url_userinfo) {
+  YaHTTP::URL url("http://test.org:8080/path@home");
+  BOOST_CHECK_EQUAL(url.username, "");
+  BOOST_CHECK_EQUAL(url.host, "test.org");
+  BOOST_CHECK_EQUAL(url.port, 8080);
+  BOOST_CHECK_EQUAL(url.path, "/path@home");
+  url.parse("http://shaun@test.org:8080/");
+  BOOST_CHECK_EQUAL(url.username, "shaun");
+  BOOST_CHECK_EQUAL(url.password, "");
+  BOOST_CHECK_EQUAL(url.host, "test.org");
+  BOOST_CHECK_EQUAL(url.port, 8080);
+}
+
+BOOST_AUTO_TEST_CASE(test_url_view) {
+  std::string buf("https://shaun:s%20heep@[2001:db8::1]:62362/something/%CA%CF.json?boo=baa&faa=fii#anchor1234");
+  YaHTTP::URLView view;
+  BOOST_CHECK(view.parse(buf));
+  BOOST_CHECK_EQUAL(view.protocol.str(), "https");
+  BOOST_CHECK_EQUAL(view.host.str(), "2001:db8::1");
+  BOOST_CHECK_EQUAL(view.port, 62362);
+  BOOST_CHECK_EQUAL(view.username.str(), "shaun");
+  BOOST_CHECK_EQUAL(view.password.str(), "s%20heep");
+  BOOST_CHECK_EQUAL(view.path.str(), "/something/%CA%CF.json");
+  BOOST_CHECK_EQUAL(view.parameters.str(), "boo=baa&faa=fii");
+  BOOST_CHECK_EQUAL(view.anchor.str(), "anchor1234");
+  // components point into the original buffer
+  BOOST_CHECK(view.path.data() == buf.data() + buf.find("/something"));
+
+  YaHTTP::URL url = view.toURL();
+  BOOST_CHECK_EQUAL(url.password, "s heep");
+  BOOST_CHECK_EQUAL(url.host, "2001:db8::1");
+  BOOST_CHECK_EQUAL(url.path, "/something/%CA%CF.json");
+  BOOST_CHECK_EQUAL(url.anchor, "anchor1234");
+
+  BOOST_CHECK(view.parse(YaHTTP::StringView("/hello/world?pass=foo&", 22)));
+  BOOST_CHECK_EQUAL(view.path.str(), "/hello/world");
+  BOOST_CHECK_EQUAL(view.parameters.str(), "pass=foo");
+  BOOST_CHECK(!view.parse(YaHTTP::StringView()));
+}
+
+BOOST_AUTO_TEST_CASE(test_url_normalize) {
+  BOOST_CHECK_EQUAL(YaHTTP::Utility::normalizePath("/a//b/./c/../d"), "/a/b/d");
+  BOOST_CHECK_EQUAL(YaHTTP::Utility::normalizePath("/../../etc/passwd"), "/etc/passwd");
+  BOOST_CHECK_EQUAL(YaHTTP::Utility::normalizePath("/a/b/.."), "/a/");
+  BOOST_CHECK_EQUAL(YaHTTP::Utility::normalizePath("/a/b/"), "/a/b/");
+  BOOST_CHECK_EQUAL(YaHTTP::Utility::normalizePath("/"), "/");
+  BOOST_CHECK_EQUAL(YaHTTP::Utility::normalizePath("/..."), "/...");
+  BOOST_CHECK_EQUAL(YaHTTP::Utility::normalizePath("/%7euser/%2e%2E/x%2fy%c3%a4"), "/x%2Fy%C3%A4");
+  BOOST_CHECK_EQUAL(YaHTTP::Utility::normalizePath("/100%/%zz"), "/100%/%zz");
+
+  YaHTTP::URL url("HTTP://Example.COM/a/./b//c");
+  url.normalize();
+  BOOST_CHECK_EQUAL(url.protocol, "http");
+  BOOST_CHECK_EQUAL(url.host, "example.com");
+  BOOST_CHECK_EQUAL(url.path, "/a/b/c");
+}
+
+BOOST_AUTO_TEST_CASE(test_url_cache) {
+  YaHTTP::URLCache cache(16);
+  YaHTTP::URL url;
+
+  BOOST_CHECK(cache.parse(std::string("/a/../b?x=1#top"), url));
+  BOOST_CHECK_EQUAL(url.path, "/b");
+  BOOST_CHECK_EQUAL(url.parameters, "x=1");
+  BOOST_CHECK_EQUAL(url.anchor, "top");
+  BOOST_CHECK(cache.parse(std::string("/a/../b?y=2"), url));
+  BOOST_CHECK_EQUAL(url.path, "/b");
+  BOOST_CHECK_EQUAL(url.parameters, "y=2");
+  BOOST_CHECK_EQUAL(url.anchor, "");
+  BOOST_CHECK_EQUAL(cache.size(), 1);
+  BOOST_CHECK_EQUAL(cache.hits(), 1);
+  BOOST_CHECK_EQUAL(cache.misses(), 1);
+
+  // same object is shared
+  BOOST_CHECK(cache.get(std::string("/a/../b?z")) == cache.get(std::string("/a/../b")));
+
+  // invalid and pathless targets are not cached
+  BOOST_CHECK(!cache.parse(std::string("nothing"), url));
+  BOOST_CHECK(cache.parse(std::string("data:text/plain,x"), url));
+  BOOST_CHECK_EQUAL(url.parameters, "text/plain,x");
+  BOOST_CHECK_EQUAL(cache.size(), 1);
+
+  YaHTTP::AsyncRequestLoader arl;
+  YaHTTP::Request req;
+  arl.urlcache = &cache;
+  arl.initialize(&req);
+  arl.feed("GET //x/./y?q=1 HTTP/1.1\r\nHost: example.com\r\n\r\n");
+  BOOST_CHECK(arl.ready());
+  arl.finalize();
+  BOOST_CHECK_EQUAL(req.url.path, "/x/y");
+  BOOST_CHECK_EQUAL(req.getvars["q"], "1");
+}
+
 BOOST_AUTO_TEST_CASE(test_url_invalid) {
   YaHTTP::URL url;
   BOOST_CHECK(!url.parse("http")); // missing : 
@@ -17,6 +17,23 @@ BOOST_AUTO_TEST_CASE(test_utility_datetime) {
   BOOST_CHECK_EQUAL(dt.cookie_str(), "04-May-2014 13:37:00 GMT");
 }
 
+BOOST_AUTO_TEST_CASE(test_utility_http_date) {
+  YaHTTP::DateTime dt, other;
+  dt.parseHttp("Sun, 06 Nov 1994 08:49:37 GMT");
+  BOOST_CHECK_EQUAL(dt.utctime(), 784111777);
+  BOOST_CHECK_EQUAL(dt.http_str(), "Sun, 06 Nov 1994 08:49:37 GMT");
+  other.parseHttp("Sunday, 06-Nov-94 08:49:37 GMT");
+  BOOST_CHECK_EQUAL(other.utctime(), 784111777);
+  other.parseHttp("Sun Nov  6 08:49:37 1994");
+  BOOST_CHECK_EQUAL(other.utctime(), 784111777);
+  other.fromGmtime(951782400); // leap day
+  BOOST_CHECK_EQUAL(other.http_str(), "Tue, 29 Feb 2000 00:00:00 GMT");
+  BOOST_CHECK_EQUAL(other.utctime(), 951782400);
+  BOOST_CHECK_THROW(dt.parseHttp("Sun, 06 Nov 1994 08:49:37 EET"), YaHTTP::ParseError);
+  BOOST_CHECK_THROW(dt.parseHttp("Sun, 06 Xyz 1994 08:49:37 GMT"), YaHTTP::ParseError);
+  BOOST_CHECK_THROW(dt.parseHttp("yesterday"), YaHTTP::ParseError);
+}
+
 BOOST_AUTO_TEST_CASE(test_utility_iequals) {
   BOOST_CHECK(YaHTTP::Utility::iequals("",""));
   BOOST_CHECK(YaHTTP::Utility::iequals("a","a"));
@@ -63,6 +80,39 @@ BOOST_AUTO_TEST_CASE(test_utility_decodeurl) {
   BOOST_CHECK_EQUAL(YaHTTP::Utility::decodeURL("https://test.org/(user)/k%c3%a4%c3%a4kk%c3%a4/status.jsonp?merge=true"), "https://test.org/(user)/kääkkä/status.jsonp?merge=true");
 }
 
+BOOST_AUTO_TEST_CASE(test_utility_decodeurl_escapes) {
+  BOOST_CHECK_EQUAL(YaHTTP::Utility::decodeURL("%"), "%");
+  BOOST_CHECK_EQUAL(YaHTTP::Utility::decodeURL("abc%4"), "abc%4");
+  BOOST_CHECK_EQUAL(YaHTTP::Utility::decodeURL("%zz%41"), "%zzA");
+  BOOST_CHECK_EQUAL(YaHTTP::Utility::decodeURL("%%41"), "%%41");
+  BOOST_CHECK_EQUAL(YaHTTP::Utility::decodeURL("%4A%4a"), "JJ");
+  // decoded percent signs are not decoded again
+  BOOST_CHECK_EQUAL(YaHTTP::Utility::decodeURL("%2541"), "%41");
+
+  std::string result = "prefix:";
+  YaHTTP::Utility::decodeURL("a%20b", 5, result);
+  BOOST_CHECK_EQUAL(result, "prefix:a b");
+
+  std::string big, encoded;
+  for(int i = 0; i < 100000; i++) big += static_cast<char>(i % 256);
+  YaHTTP::Utility::encodeURL(big.data(), big.size(), encoded, false);
+  BOOST_CHECK_EQUAL(YaHTTP::Utility::decodeURL(encoded), big);
+}
+
+BOOST_AUTO_TEST_CASE(test_utility_encodeurl_runs) {
+  // long runs take the fast path
+  BOOST_CHECK_EQUAL(YaHTTP::Utility::encodeURL("abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789 ", false),
+                    "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789%20");
+  BOOST_CHECK_EQUAL(YaHTTP::Utility::encodeURL("0123456789abcdef@[]`{}/:0123456789abcdef", false),
+                    "0123456789abcdef%40%5b%5d%60%7b%7d%2f%3a0123456789abcdef");
+  BOOST_CHECK_EQUAL(YaHTTP::Utility::encodeURL("0123456789abcdef@[]`{}/:0123456789abcdef", true),
+                    "0123456789abcdef@[]%60{}/:0123456789abcdef");
+  BOOST_CHECK_EQUAL(YaHTTP::Utility::encodeURL(L"a:b", true), "a%00%00%00%3a%00%00%00b%00%00%00");
+  std::string result = "prefix:";
+  YaHTTP::Utility::encodeURL("a b", 3, result);
+  BOOST_CHECK_EQUAL(result, "prefix:a%20b");
+}
+
 BOOST_AUTO_TEST_CASE(test_utility_parseurlparameters) {
   YaHTTP::strstr_map_t parameters;
   parameters = YaHTTP::Utility::parseUrlParameters("Hi=Moi&M=B%C3%A4%C3%A4&Bai=Kai&Li=Ann");
@@ -72,6 +122,41 @@ BOOST_AUTO_TEST_CASE(test_utility_parseurlparameters) {
   BOOST_CHECK_EQUAL(parameters["Li"], "Ann"); 
 }
 
+BOOST_AUTO_TEST_CASE(test_utility_parameterlist) {
+  YaHTTP::ParameterList params("tag=a&Tag=b%20c&&=skipped&flag&q=x%3dy&%6bey=v&tag=");
+  BOOST_CHECK_EQUAL(params.size(), 6);
+  BOOST_CHECK_EQUAL(params.rawKey(0).str(), "tag");
+  BOOST_CHECK_EQUAL(params.rawValue(1).str(), "b%20c");
+  BOOST_CHECK_EQUAL(params.value(1), "b c");
+  BOOST_CHECK_EQUAL(params.key(2), "flag");
+  BOOST_CHECK_EQUAL(params.value(2), "");
+  BOOST_CHECK_EQUAL(params.value(3), "x=y");
+
+  std::vector<std::string> tags = params.getAll("TAG");
+  BOOST_CHECK_EQUAL(tags.size(), 3);
+  BOOST_CHECK_EQUAL(tags[0], "a");
+  BOOST_CHECK_EQUAL(tags[1], "b c");
+  BOOST_CHECK_EQUAL(tags[2], "");
+
+  std::string value;
+  BOOST_CHECK(params.get("key", value));
+  BOOST_CHECK_EQUAL(value, "v");
+  BOOST_CHECK(params.has("flag"));
+  BOOST_CHECK(!params.has("missing"));
+  BOOST_CHECK(!params.get("missing", value));
+
+  YaHTTP::strstr_map_t map = params.toMap();
+  BOOST_CHECK_EQUAL(map["tag"], "");
+  BOOST_CHECK_EQUAL(map["q"], "x=y");
+
+  std::string many;
+  for(int i = 0; i < 200; i++) many += "k=v&";
+  params.parse(many);
+  BOOST_CHECK_EQUAL(params.size(), YAHTTP_MAX_REQUEST_FIELDS);
+  params.parse("");
+  BOOST_CHECK(params.empty());
+}
+
 BOOST_AUTO_TEST_CASE(test_utility_trimright) {
   std::string str = "";
   YaHTTP::Utility::trimRight(str);
@@ -108,4 +193,56 @@ BOOST_AUTO_TEST_CASE(test_strstr_map_t) {
   BOOST_CHECK_EQUAL(test["HeLlO"], "WORLD");
 }
 
+BOOST_AUTO_TEST_CASE(test_utility_classify) {
+  static_assert(YaHTTP::isdigit('7') && !YaHTTP::isdigit('a'), "isdigit must be constexpr");
+  static_assert(YaHTTP::asciiUpper('q') == 'Q', "asciiUpper must be constexpr");
+
+  // classifiers agree with C locale for ASCII and reject everything else
+  for(int c = 0; c < 256; c++) {
+    char ch = static_cast<char>(c);
+    bool ascii = c < 0x80;
+    BOOST_CHECK_EQUAL(YaHTTP::isspace(ch), ascii && std::isspace(c) != 0);
+    BOOST_CHECK_EQUAL(YaHTTP::isdigit(ch), ascii && std::isdigit(c) != 0);
+    BOOST_CHECK_EQUAL(YaHTTP::isxdigit(ch), ascii && std::isxdigit(c) != 0);
+    BOOST_CHECK_EQUAL(YaHTTP::isalpha(ch), ascii && std::isalpha(c) != 0);
+    BOOST_CHECK_EQUAL(YaHTTP::isalnum(ch), ascii && std::isalnum(c) != 0);
+    BOOST_CHECK_EQUAL(YaHTTP::asciiUpper(ch), ascii ? static_cast<char>(std::toupper(c)) : ch);
+    BOOST_CHECK_EQUAL(YaHTTP::asciiLower(ch), ascii ? static_cast<char>(std::tolower(c)) : ch);
+  }
+  BOOST_CHECK(YaHTTP::istoken('!') && YaHTTP::istoken('~') && YaHTTP::istoken('z'));
+  BOOST_CHECK(!YaHTTP::istoken(':') && !YaHTTP::istoken(' ') && !YaHTTP::istoken('"'));
+  BOOST_CHECK(YaHTTP::isurlsafe('/') && !YaHTTP::isurlsafe(' ') && !YaHTTP::isurlsafe('"'));
+}
+
+BOOST_AUTO_TEST_CASE(test_utility_ascii_case) {
+  std::string a("Content-Type: Application/X-WWW-Form-Urlencoded; Charset=UTF-8");
+  std::string b("content-type: application/x-www-form-urlencoded; charset=utf-8");
+  YaHTTP::ASCIICINullSafeComparator less;
+  YaHTTP::ASCIICIHash hash;
+  YaHTTP::ASCIICIEqual equal;
+
+  // every length crosses vector, word and byte paths
+  for(size_t n = 0; n <= a.size(); n++) {
+    BOOST_CHECK_EQUAL(YaHTTP::asciiCaseCompare(a.data(), b.data(), n), 0);
+    BOOST_CHECK_EQUAL(hash(a.substr(0, n)), hash(b.substr(0, n)));
+    BOOST_CHECK(equal(a.substr(0, n), b.substr(0, n)));
+  }
+  std::string c(b);
+  c[40] = 'X';
+  BOOST_CHECK(YaHTTP::asciiCaseCompare(b.data(), c.data(), c.size()) < 0);
+  BOOST_CHECK(less(b, c));
+  BOOST_CHECK(!less(c, b));
+  BOOST_CHECK(!equal(b, c));
+  BOOST_CHECK(less("abc", "ABCD"));
+  BOOST_CHECK(!less("ABCD", "abc"));
+  BOOST_CHECK(!less("ABC", "abc") && !less("abc", "ABC"));
+  // only ASCII letters are folded
+  BOOST_CHECK(!equal("[", "{"));
+  BOOST_CHECK(!equal("\xc4", "\xe4"));
+
+  BOOST_CHECK(YaHTTP::Utility::iequals(a, b));
+  BOOST_CHECK(YaHTTP::Utility::iequals("Application/X-WWW-Form-Urlencoded; charset", "application/x-www-form-urlencoded", 32));
+  BOOST_CHECK(!YaHTTP::Utility::iequals("text/plain", "text/plainer", 32));
+}
+
 }
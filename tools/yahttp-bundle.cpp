@@ -0,0 +1,30 @@
+#include "../yahttp/yahttp.hpp"
+
+#include <cstring>
+
+/** Packs a directory of static files into a bundle served with YaHTTP::Bundle */
+static int usage(const char* name) {
+  std::cerr << "Usage: " << name << " [-z] directory bundle" << std::endl;
+  std::cerr << "  -z  add gzip variants of compressible files that lack a .gz sibling" << std::endl;
+  return 1;
+}
+
+int main(int argc, char** argv) {
+  bool compress = false;
+  int arg = 1;
+
+  if (arg < argc && ::strcmp(argv[arg], "-z") == 0) {
+    compress = true;
+    arg++;
+  }
+  if (argc - arg != 2) return usage(argv[0]);
+
+  try {
+    size_t count = YaHTTP::Bundle::pack(argv[arg], argv[arg + 1], compress);
+    std::cout << "Packed " << count << " files into " << argv[arg + 1] << std::endl;
+  } catch (YaHTTP::Error& ex) {
+    std::cerr << ex.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,359 @@
+/* @file
+ * @brief Concrete implementation of Bundle
+ */
+#include "yahttp.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <map>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef HAVE_CPP_FUNC_PTR
+namespace YaHTTP {
+  static const uint32_t bundle_version = 1;
+  static const uint32_t bundle_empty_slot = 0xffffffff;
+  static const uint64_t bundle_page_size = 4096;
+
+  // 64-bit FNV-1a
+  static inline uint64_t hashPath(const char* s, size_t n) {
+    uint64_t h = 14695981039346656037ULL;
+    for(size_t i = 0; i < n; i++) {
+      h ^= static_cast<unsigned char>(s[i]);
+      h *= 1099511628211ULL;
+    }
+    return h;
+  }
+
+  // finalizer of MurmurHash3, spreads every input bit over the whole value
+  static inline uint64_t mix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+  }
+
+  static inline uint32_t slotOf(uint64_t h, uint32_t displacement, uint32_t slots) {
+    return static_cast<uint32_t>(mix(h ^ (displacement * 0x9e3779b97f4a7c15ULL)) % slots);
+  }
+
+  static inline uint64_t pageAlign(uint64_t pos) {
+    return (pos + bundle_page_size - 1) & ~(bundle_page_size - 1);
+  }
+
+  // checks that everything header and entries point to is inside the bundle
+  static bool validBundle(const char* data, size_t length) {
+    const Bundle::Header* h = reinterpret_cast<const Bundle::Header*>(data);
+    if (length < sizeof(*h) || ::memcmp(h->magic, "YAHTTPBN", 8) != 0 || h->version != bundle_version) return false;
+    if (h->size != length || h->count == bundle_empty_slot || h->buckets == 0 || h->slots <= h->count) return false;
+    if (h->displacements < sizeof(*h) + static_cast<uint64_t>(h->count) * sizeof(Bundle::Entry) || h->displacements % 4 != 0) return false;
+    if (h->table < h->displacements + static_cast<uint64_t>(h->buckets) * 4 || h->table % 4 != 0) return false;
+    if (h->strings < h->table + static_cast<uint64_t>(h->slots) * 4 || h->strings > length || h->strings_size > length - h->strings) return false;
+
+    const uint32_t* table = reinterpret_cast<const uint32_t*>(data + h->table);
+    for(uint32_t i = 0; i < h->slots; i++)
+      if (table[i] != bundle_empty_slot && table[i] >= h->count) return false;
+    const Bundle::Entry* entries = reinterpret_cast<const Bundle::Entry*>(data + sizeof(*h));
+    for(uint32_t i = 0; i < h->count; i++) {
+      const Bundle::Entry& e = entries[i];
+      const Bundle::Ref* refs[] = { &e.path, &e.content_type, &e.last_modified };
+      if ((e.variants & 1) == 0 || e.variants >= (1u << Bundle::coding_count)) return false;
+      for(size_t r = 0; r < sizeof(refs)/sizeof(refs[0]); r++)
+        if (refs[r]->offset > h->strings_size || refs[r]->length > h->strings_size - refs[r]->offset) return false;
+      for(size_t v = 0; v < Bundle::coding_count; v++) {
+        if ((e.variants & (1u << v)) == 0) continue;
+        const Bundle::Variant& var = e.variant[v];
+        if (var.offset > length || var.size > length - var.offset) return false;
+        if (var.etag.offset > h->strings_size || var.etag.length > h->strings_size - var.etag.offset) return false;
+        if (var.content_length.offset > h->strings_size || var.content_length.length > h->strings_size - var.content_length.offset) return false;
+      }
+    }
+    return true;
+  }
+
+  Bundle::Bundle(const std::string& path): file(path), data(NULL), length(0), header(NULL), entries(NULL), displacements(NULL), table(NULL) {
+    if (!file.valid()) throw Error("Cannot open bundle " + path + ": " + ::strerror(errno));
+    length = file.fileSize();
+    if (length < sizeof(Header)) throw Error(path + " is not a bundle");
+    void* addr = ::mmap(NULL, length, PROT_READ, MAP_SHARED, file.fd(), 0);
+    if (addr == MAP_FAILED) throw Error("Cannot map bundle " + path + ": " + ::strerror(errno));
+    data = static_cast<const char*>(addr);
+    if (!validBundle(data, length)) {
+      ::munmap(addr, length);
+      throw Error(path + " is not a valid bundle");
+    }
+    header = reinterpret_cast<const Header*>(data);
+    entries = reinterpret_cast<const Entry*>(data + sizeof(Header));
+    displacements = reinterpret_cast<const uint32_t*>(data + header->displacements);
+    table = reinterpret_cast<const uint32_t*>(data + header->table);
+  }
+
+  Bundle::~Bundle() {
+    ::munmap(const_cast<char*>(data), length);
+  }
+
+  const char* Bundle::coding(size_t index) {
+    static const char* const names[] = { "", "br", "zstd", "gzip" };
+    return (index < coding_count ? names[index] : "");
+  }
+
+  const Bundle::Entry* Bundle::find(const std::string& path) const {
+    if (header->count == 0) return NULL;
+    uint64_t h = hashPath(path.data(), path.size());
+    uint32_t index = table[slotOf(h, displacements[mix(h) % header->buckets], header->slots)];
+    if (index == bundle_empty_slot) return NULL;
+    // slot of a path not in bundle can hold any entry
+    const Entry& e = entries[index];
+    if (e.path.length != path.size() || ::memcmp(data + header->strings + e.path.offset, path.data(), path.size()) != 0) return NULL;
+    return &e;
+  }
+
+  void Bundle::apply(const Entry& e, size_t index, Response& resp) const {
+    const Variant& v = e.variant[index];
+    resp.headers["content-type"] = str(e.content_type);
+    resp.headers["etag"] = str(v.etag);
+    resp.headers["last-modified"] = str(e.last_modified);
+    resp.headers["content-length"] = str(v.content_length);
+    resp.body.clear();
+    resp.renderer = file.slice(v.offset, v.size);
+  }
+
+  bool Bundle::serve(const std::string& path, Response& resp) const {
+    const Entry* e = find(path);
+    if (e == NULL) return false;
+    apply(*e, coding_identity, resp);
+    return true;
+  }
+
+  bool Bundle::serve(const std::string& path, const Request& req, Response& resp) const {
+    const Entry* e = find(path);
+    if (e == NULL) return false;
+    size_t index = coding_identity;
+    strstr_map_t::const_iterator accept = req.headers.find("accept-encoding");
+    if (e->variants != 1 && accept != req.headers.end()) {
+      std::vector<std::string> codings;
+      for(size_t i = coding_br; i < coding_count; i++)
+        if (e->variants & (1u << i)) codings.push_back(coding(i));
+      std::string chosen = Compression::negotiate(accept->second, codings);
+      for(size_t i = coding_br; i < coding_count; i++)
+        if (chosen == coding(i)) index = i;
+    }
+    apply(*e, index, resp);
+    if (e->variants != 1) {
+      resp.headers["vary"] = "Accept-Encoding";
+      if (index != coding_identity) resp.headers["content-encoding"] = coding(index);
+    }
+    return true;
+  }
+
+  // appends paths of regular files under root + rel to files
+  static void walk(const std::string& root, const std::string& rel, std::vector<std::string>& files) {
+    std::vector<std::string> subdirs;
+    struct dirent* de;
+    struct stat st;
+    DIR* dir = ::opendir((root + rel).c_str());
+    if (dir == NULL) throw Error("Cannot read directory " + root + rel + ": " + ::strerror(errno));
+    while((de = ::readdir(dir)) != NULL) {
+      std::string name = de->d_name;
+      if (name == "." || name == "..") continue;
+      if (::stat((root + rel + "/" + name).c_str(), &st) < 0) continue;
+      if (S_ISDIR(st.st_mode)) subdirs.push_back(rel + "/" + name);
+      else if (S_ISREG(st.st_mode)) files.push_back(rel + "/" + name);
+    }
+    ::closedir(dir);
+    for(size_t i = 0; i < subdirs.size(); i++) walk(root, subdirs[i], files);
+  }
+
+  /*! File being packed */
+  struct PackedFile {
+    PackedFile(): variants(0) {};
+    std::string path; //<! path in bundle
+    std::string source[Bundle::coding_count]; //<! file each variant is read from, empty if generated
+    uint64_t size[Bundle::coding_count]; //<! size of each variant
+    std::string generated; //<! contents of gzip variant made while packing
+    uint32_t variants; //<! bit mask of present variants
+    Bundle::Entry entry; //<! entry being built
+  };
+
+  // string area which stores each distinct string once
+  class StringArea {
+  public:
+    Bundle::Ref add(const std::string& value) {
+      std::map<std::string, Bundle::Ref>::iterator i = seen.find(value);
+      if (i != seen.end()) return i->second;
+      Bundle::Ref ref;
+      ref.offset = static_cast<uint32_t>(data.size());
+      ref.length = static_cast<uint32_t>(value.size());
+      data.append(value);
+      seen[value] = ref;
+      return ref;
+    };
+    std::string data; //<! the area
+  private:
+    std::map<std::string, Bundle::Ref> seen; //<! strings already in area
+  };
+
+  size_t Bundle::pack(const std::string& directory, const std::string& output, bool compress) {
+    std::vector<std::string> all;
+    std::vector<PackedFile> files;
+    StringArea strings;
+    struct stat st;
+
+    walk(directory, "", all);
+    std::sort(all.begin(), all.end());
+    for(std::vector<std::string>::const_iterator i = all.begin(); i != all.end(); i++) {
+      // precompressed siblings become variants of their file
+      bool sibling = false;
+      for(size_t c = coding_br; c < coding_count; c++) {
+        std::string suffix = Compression::suffix(coding(c));
+        if (i->size() > suffix.size() && i->compare(i->size() - suffix.size(), suffix.size(), suffix) == 0 &&
+            std::binary_search(all.begin(), all.end(), i->substr(0, i->size() - suffix.size()))) sibling = true;
+      }
+      if (sibling) continue;
+      files.push_back(PackedFile());
+      PackedFile& f = files.back();
+      f.path = *i;
+      for(size_t c = coding_identity; c < coding_count; c++) {
+        std::string path = *i + Compression::suffix(coding(c));
+        if (c != coding_identity && !std::binary_search(all.begin(), all.end(), path)) continue;
+        f.source[c] = directory + path;
+        f.variants |= (1u << c);
+      }
+    }
+    if (files.size() >= bundle_empty_slot) throw Error("Too many files for bundle");
+
+    for(std::vector<PackedFile>::iterator f = files.begin(); f != files.end(); f++) {
+      time_t mtime = 0;
+      std::memset(&f->entry, 0, sizeof(f->entry));
+      std::string content_type = StaticFile::contentType(f->path);
+#ifdef HAVE_ZLIB
+      if (compress && (f->variants & (1u << coding_gzip)) == 0 && Compression::compressible(content_type)) {
+        std::ostringstream content;
+        std::ifstream ifs(f->source[coding_identity].c_str(), std::ifstream::binary);
+        content << ifs.rdbuf();
+        if (Compression::compress(content.str(), f->generated, "gzip", 9) && f->generated.size() < content.str().size())
+          f->variants |= (1u << coding_gzip);
+        else
+          f->generated.clear();
+      }
+#else
+      (void)compress;
+#endif
+      for(size_t c = coding_identity; c < coding_count; c++) {
+        if ((f->variants & (1u << c)) == 0) continue;
+        if (f->source[c].empty()) {
+          f->size[c] = f->generated.size();
+        } else {
+          if (::stat(f->source[c].c_str(), &st) < 0) throw Error("Cannot stat " + f->source[c] + ": " + ::strerror(errno));
+          f->size[c] = st.st_size;
+          if (c == coding_identity) mtime = st.st_mtime;
+        }
+        std::ostringstream len;
+        len << f->size[c];
+        f->entry.variant[c].size = f->size[c];
+        f->entry.variant[c].etag = strings.add(Utility::makeETag((f->source[c].empty() ? mtime : st.st_mtime), f->size[c]));
+        f->entry.variant[c].content_length = strings.add(len.str());
+      }
+      DateTime modified;
+      modified.fromGmtime(mtime);
+      f->entry.path = strings.add(f->path);
+      f->entry.content_type = strings.add(content_type);
+      f->entry.last_modified = strings.add(modified.http_str());
+      f->entry.variants = f->variants;
+    }
+
+    // hash and displace: largest buckets pick their displacement first, while the table is still empty
+    uint32_t count = static_cast<uint32_t>(files.size());
+    uint32_t buckets = count / 4 + 1;
+    uint32_t slots = count + count / 4 + 1;
+    std::vector<uint64_t> hashes(count);
+    std::vector<std::vector<uint32_t> > members(buckets);
+    std::vector<uint32_t> displacement(buckets, 0), table(slots, bundle_empty_slot), order(buckets), taken;
+    for(uint32_t i = 0; i < count; i++) {
+      hashes[i] = hashPath(files[i].path.data(), files[i].path.size());
+      members[mix(hashes[i]) % buckets].push_back(i);
+    }
+    std::vector<uint64_t> sorted(hashes);
+    std::sort(sorted.begin(), sorted.end());
+    if (std::adjacent_find(sorted.begin(), sorted.end()) != sorted.end()) throw Error("Paths in " + directory + " have colliding hashes");
+    for(uint32_t b = 0; b < buckets; b++) order[b] = b;
+    std::stable_sort(order.begin(), order.end(), [&members](uint32_t a, uint32_t b) { return members[a].size() > members[b].size(); });
+    for(uint32_t o = 0; o < buckets && members[order[o]].empty() == false; o++) {
+      const std::vector<uint32_t>& bucket = members[order[o]];
+      uint32_t d;
+      for(d = 0; d < 0x1000000; d++) {
+        taken.clear();
+        for(size_t k = 0; k < bucket.size(); k++) {
+          uint32_t s = slotOf(hashes[bucket[k]], d, slots);
+          if (table[s] != bundle_empty_slot || std::find(taken.begin(), taken.end(), s) != taken.end()) break;
+          taken.push_back(s);
+        }
+        if (taken.size() == bucket.size()) break;
+      }
+      if (taken.size() != bucket.size()) throw Error("Cannot build hash table for " + directory);
+      for(size_t k = 0; k < bucket.size(); k++) table[taken[k]] = bucket[k];
+      displacement[order[o]] = d;
+    }
+
+    Header h;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, "YAHTTPBN", 8);
+    h.version = bundle_version;
+    h.count = count;
+    h.buckets = buckets;
+    h.slots = slots;
+    h.displacements = sizeof(Header) + static_cast<uint64_t>(count) * sizeof(Entry);
+    h.table = h.displacements + static_cast<uint64_t>(buckets) * 4;
+    h.strings = h.table + static_cast<uint64_t>(slots) * 4;
+    h.strings_size = strings.data.size();
+    h.size = h.strings + h.strings_size;
+    for(std::vector<PackedFile>::iterator f = files.begin(); f != files.end(); f++) {
+      for(size_t c = coding_identity; c < coding_count; c++) {
+        if ((f->variants & (1u << c)) == 0) continue;
+        f->entry.variant[c].offset = pageAlign(h.size);
+        h.size = f->entry.variant[c].offset + f->size[c];
+      }
+    }
+
+    // written next to output and renamed over it, so that servers never map a partial bundle
+    std::string tmp = output + ".tmp";
+    std::ofstream os(tmp.c_str(), std::ofstream::binary | std::ofstream::trunc);
+    if (!os.good()) throw Error("Cannot write " + tmp + ": " + ::strerror(errno));
+    try {
+      os.write(reinterpret_cast<const char*>(&h), sizeof(h));
+      for(std::vector<PackedFile>::const_iterator f = files.begin(); f != files.end(); f++)
+        os.write(reinterpret_cast<const char*>(&f->entry), sizeof(f->entry));
+      os.write(reinterpret_cast<const char*>(displacement.data()), displacement.size() * 4);
+      os.write(reinterpret_cast<const char*>(table.data()), table.size() * 4);
+      os << strings.data;
+      for(std::vector<PackedFile>::const_iterator f = files.begin(); f != files.end(); f++) {
+        for(size_t c = coding_identity; c < coding_count; c++) {
+          if ((f->variants & (1u << c)) == 0) continue;
+          const Variant& v = f->entry.variant[c];
+          os << std::string(v.offset - static_cast<uint64_t>(os.tellp()), '\0');
+          if (f->source[c].empty()) {
+            os << f->generated;
+          } else if (v.size > 0) {
+            std::ifstream ifs(f->source[c].c_str(), std::ifstream::binary);
+            os << ifs.rdbuf();
+          }
+          if (static_cast<uint64_t>(os.tellp()) != v.offset + v.size) throw Error(f->source[c] + " changed while it was packed");
+        }
+      }
+      os.close();
+      if (os.fail()) throw Error("Cannot write " + tmp + ": " + ::strerror(errno));
+      if (::rename(tmp.c_str(), output.c_str()) < 0) throw Error("Cannot rename " + tmp + " to " + output + ": " + ::strerror(errno));
+    } catch (...) {
+      ::unlink(tmp.c_str());
+      throw;
+    }
+    return files.size();
+  }
+};
+#endif
@@ -0,0 +1,109 @@
+#pragma once
+/* @file
+ * @brief Defines packed static asset bundles
+ */
+#ifdef HAVE_CPP_FUNC_PTR
+#include <stdint.h>
+#include <string>
+
+namespace YaHTTP {
+  /*! Static files packed into one indexed file which is served from a single mapping.
+
+A bundle is made with pack() or the yahttp-bundle tool from a directory tree. Each regular file becomes an entry
+named by its path relative to the directory with a leading slash, precompressed siblings (file.br, file.zst and
+file.gz) become variants of the file instead of entries of their own. With compress, files worth compressing get a
+gzip variant made with zlib unless they have one already.
+
+Opening a bundle maps it once and keeps it open. Lookups hash the path and probe a perfect hash table built by pack,
+so finding a file costs one hash and one comparison regardless of how many files there are. Responses get
+Content-Type, ETag, Last-Modified and Content-Length precomputed by pack and a HTTPBase::ZeroCopyFileRender slice of
+the bundle, which Server sends with sendfile(2) without opening anything.
+
+Layout, in host byte order: Header, Entry array sorted by path, displacement per bucket, entry index per slot (or
+0xffffffff), string area, and file contents, each starting at a page boundary. An entry is found at
+slot = mix(hash ^ displacement[mix(hash) % buckets] * golden) % slots, where hash is 64-bit FNV-1a of the path.
+
+@code
+static YaHTTP::Bundle assets("assets.bundle");
+...
+if (!assets.serve(req->url.path, *req, *resp)) resp->status = 404;
+@endcode
+  */
+  class Bundle {
+  public:
+    enum {
+      coding_identity = 0,
+      coding_br,
+      coding_zstd,
+      coding_gzip,
+      coding_count
+    }; //<! variant indexes, codings in order of preference after identity
+
+    /*! Location of string in string area */
+    struct Ref {
+      uint32_t offset; //<! offset from start of string area
+      uint32_t length; //<! length of string
+    };
+
+    /*! Representation of file with one content coding */
+    struct Variant {
+      uint64_t offset; //<! offset of contents from start of bundle
+      uint64_t size; //<! size of contents
+      Ref etag; //<! value for ETag
+      Ref content_length; //<! value for Content-Length
+    };
+
+    /*! Packed file */
+    struct Entry {
+      Ref path; //<! path of file, starting with slash
+      Ref content_type; //<! value for Content-Type
+      Ref last_modified; //<! value for Last-Modified
+      uint32_t variants; //<! bit mask of present variants, identity is always present
+      uint32_t reserved; //<! zero
+      Variant variant[coding_count]; //<! variants indexed by coding_identity, coding_br, coding_zstd and coding_gzip
+    };
+
+    /*! Start of bundle */
+    struct Header {
+      char magic[8]; //<! "YAHTTPBN"
+      uint32_t version; //<! format version
+      uint32_t count; //<! number of entries
+      uint32_t buckets; //<! number of displacements
+      uint32_t slots; //<! number of hash table slots
+      uint64_t displacements; //<! offset of displacements
+      uint64_t table; //<! offset of hash table slots
+      uint64_t strings; //<! offset of string area
+      uint64_t strings_size; //<! size of string area
+      uint64_t size; //<! size of bundle
+    };
+
+    Bundle(const std::string& path); //<! opens and maps bundle, throws Error if it cannot be read or is not a valid bundle
+    ~Bundle(); //<! unmaps bundle, responses already made from it keep the file open
+
+    const Entry* find(const std::string& path) const; //<! entry for path, NULL if bundle does not have it
+    bool serve(const std::string& path, Response& resp) const; //<! fills response with file at path, returns false if bundle does not have it
+    bool serve(const std::string& path, const Request& req, Response& resp) const; //<! fills response with file at path or the variant req accepts, returns false if bundle does not have it
+
+    size_t size() const { return header->count; }; //<! number of files
+    const Entry& entry(size_t n) const { return entries[n]; }; //<! nth file in path order
+    std::string str(const Ref& ref) const { return std::string(data + header->strings + ref.offset, ref.length); }; //<! string from string area
+    static const char* coding(size_t index); //<! name of content coding of variant index, empty for identity
+
+    static size_t pack(const std::string& directory, const std::string& output, bool compress = false); //<! packs regular files under directory into bundle written to output, returns number of files, throws Error on failure
+
+  private:
+    Bundle(const Bundle&); //<! not copyable
+    Bundle& operator=(const Bundle&); //<! not copyable
+
+    void apply(const Entry& e, size_t index, Response& resp) const; //<! fills response with variant of entry
+
+    HTTPBase::ZeroCopyFileRender file; //<! the open bundle, sliced for responses
+    const char* data; //<! mapped bundle
+    size_t length; //<! size of mapping
+    const Header* header; //<! header at start of mapping
+    const Entry* entries; //<! entries in path order
+    const uint32_t* displacements; //<! displacement per bucket
+    const uint32_t* table; //<! entry index per slot
+  };
+};
+#endif
@@ -0,0 +1,137 @@
+#pragma once
+/* @file
+ * @brief Defines bounded cache used by router and other lookups
+ */
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace YaHTTP {
+  /*! Bounded, sharded LRU cache which is safe for concurrent use.
+
+Capacity is expressed in weight units, each entry weighs 1 unless told otherwise. Keys are hashed into shards,
+each shard has its own lock and evicts its least recently used entries when it runs out of room.
+  */
+  template <class V>
+  class BoundedCache {
+  private:
+    typedef std::list<std::pair<std::string, std::pair<V, size_t> > > TEntryList; //<! most recently used first
+
+    struct Shard {
+      Shard(): weight(0) {};
+      std::mutex lock; //<! protects this shard
+      TEntryList entries; //<! entries in LRU order
+      std::unordered_map<std::string, typename TEntryList::iterator> index; //<! lookup index
+      size_t weight; //<! sum of entry weights
+    };
+
+    Shard& shard(const std::string& key) {
+      return shards[std::hash<std::string>()(key) % shards.size()];
+    }; //<! shard for key
+
+    void evict(Shard& s, size_t room) {
+      while(s.entries.size() > 0 && s.weight + room > shard_capacity) {
+        s.weight -= s.entries.back().second.second;
+        s.index.erase(s.entries.back().first);
+        s.entries.pop_back();
+      }
+    }; //<! drop entries until room fits, caller holds lock
+
+    std::vector<Shard> shards; //<! shards
+    size_t shard_capacity; //<! capacity of single shard
+    std::atomic<unsigned long> hit_count; //<! number of hits
+    std::atomic<unsigned long> miss_count; //<! number of misses
+
+  public:
+    BoundedCache(size_t capacity, size_t nshards = 16): shards(nshards > 0 ? nshards : 1), hit_count(0), miss_count(0) {
+      shard_capacity = capacity / shards.size();
+      if (shard_capacity < 1) shard_capacity = 1;
+    }; //<! construct cache holding up to capacity weight units
+
+    bool get(const std::string& key, V& value) {
+      return get(key, value, [](const V&) { return true; });
+    }; //<! copies cached value for key, returns false on miss
+
+    template <class P>
+    bool get(const std::string& key, V& value, P valid) {
+      Shard& s = shard(key);
+      std::lock_guard<std::mutex> guard(s.lock);
+      typename std::unordered_map<std::string, typename TEntryList::iterator>::iterator i = s.index.find(key);
+      if (i == s.index.end()) {
+        miss_count++;
+        return false;
+      }
+      if (!valid(i->second->second.first)) {
+        s.weight -= i->second->second.second;
+        s.entries.erase(i->second);
+        s.index.erase(i);
+        miss_count++;
+        return false;
+      }
+      s.entries.splice(s.entries.begin(), s.entries, i->second);
+      value = i->second->second.first;
+      hit_count++;
+      return true;
+    }; //<! copies cached value for key if valid(value) holds, stale entries are dropped and counted as misses
+
+    void put(const std::string& key, const V& value, size_t weight = 1) {
+      Shard& s = shard(key);
+      if (weight > shard_capacity) return; // would never fit
+      std::lock_guard<std::mutex> guard(s.lock);
+      typename std::unordered_map<std::string, typename TEntryList::iterator>::iterator i = s.index.find(key);
+      if (i != s.index.end()) {
+        s.weight -= i->second->second.second;
+        s.entries.erase(i->second);
+        s.index.erase(i);
+      }
+      evict(s, weight);
+      s.entries.push_front(std::make_pair(key, std::make_pair(value, weight)));
+      s.index[key] = s.entries.begin();
+      s.weight += weight;
+    }; //<! stores value for key, evicting least recently used entries
+
+    void erase(const std::string& key) {
+      Shard& s = shard(key);
+      std::lock_guard<std::mutex> guard(s.lock);
+      typename std::unordered_map<std::string, typename TEntryList::iterator>::iterator i = s.index.find(key);
+      if (i == s.index.end()) return;
+      s.weight -= i->second->second.second;
+      s.entries.erase(i->second);
+      s.index.erase(i);
+    }; //<! removes key from cache
+
+    void clear() {
+      for(typename std::vector<Shard>::iterator i = shards.begin(); i != shards.end(); i++) {
+        std::lock_guard<std::mutex> guard(i->lock);
+        i->entries.clear();
+        i->index.clear();
+        i->weight = 0;
+      }
+    }; //<! removes all entries, counters are kept
+
+    size_t size() {
+      size_t n = 0;
+      for(typename std::vector<Shard>::iterator i = shards.begin(); i != shards.end(); i++) {
+        std::lock_guard<std::mutex> guard(i->lock);
+        n += i->entries.size();
+      }
+      return n;
+    }; //<! number of entries
+
+    size_t weight() {
+      size_t n = 0;
+      for(typename std::vector<Shard>::iterator i = shards.begin(); i != shards.end(); i++) {
+        std::lock_guard<std::mutex> guard(i->lock);
+        n += i->weight;
+      }
+      return n;
+    }; //<! sum of entry weights
+
+    unsigned long hits() const { return hit_count; }; //<! number of lookups that found an entry
+    unsigned long misses() const { return miss_count; }; //<! number of lookups that did not find an entry
+  };
+};
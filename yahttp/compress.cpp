@@ -0,0 +1,284 @@
+/* @file
+ * @brief Concrete implementation of Compression and CompressRender
+ */
+#include "yahttp.hpp"
+
+#include <cstdlib>
+#include <strings.h>
+#include <sys/stat.h>
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef HAVE_CPP_FUNC_PTR
+namespace YaHTTP {
+  // calls f(token, quality) for each element of Accept-Encoding value
+  template <class F>
+  static void eachCoding(const std::string& accept, F f) {
+    size_t pos = 0;
+    while(pos < accept.size()) {
+      size_t end = accept.find(',', pos);
+      if (end == std::string::npos) end = accept.size();
+      std::string element = accept.substr(pos, end - pos);
+      pos = end + 1;
+      size_t semi = element.find(';');
+      std::string token = element.substr(0, semi);
+      float q = 1;
+      token.erase(0, token.find_first_not_of(" \t"));
+      token.erase(token.find_last_not_of(" \t") + 1);
+      if (token.empty()) continue;
+      while(semi != std::string::npos) {
+        size_t next = element.find(';', semi + 1);
+        std::string param = element.substr(semi + 1, next == std::string::npos ? std::string::npos : next - semi - 1);
+        param.erase(0, param.find_first_not_of(" \t"));
+        if (param.size() > 2 && (param[0] == 'q' || param[0] == 'Q') && param[1] == '=')
+          q = static_cast<float>(std::strtod(param.c_str() + 2, NULL));
+        semi = next;
+      }
+      f(token, q);
+    }
+  }
+
+  float Compression::quality(const std::string& accept, const std::string& coding) {
+    float exact = -1, wildcard = -1;
+    eachCoding(accept, [&](const std::string& token, float q) {
+      if (::strcasecmp(token.c_str(), coding.c_str()) == 0) exact = q;
+      else if (token == "*") wildcard = q;
+    });
+    if (exact >= 0) return exact;
+    if (wildcard >= 0) return wildcard;
+    return (::strcasecmp(coding.c_str(), "identity") == 0 ? 1 : 0);
+  }
+
+  std::string Compression::negotiate(const std::string& accept, const std::vector<std::string>& codings) {
+    std::string best;
+    float bestq = 0;
+    for(std::vector<std::string>::const_iterator i = codings.begin(); i != codings.end(); i++) {
+      float q = quality(accept, *i);
+      if (q > bestq) {
+        best = *i;
+        bestq = q;
+      }
+    }
+    // compressed is preferred unless identity is asked for with higher quality
+    if (!best.empty() && quality(accept, "identity") > bestq) return "";
+    return best;
+  }
+
+  std::string Compression::suffix(const std::string& coding) {
+    if (coding == "br") return ".br";
+    if (coding == "zstd") return ".zst";
+    if (coding == "gzip") return ".gz";
+    return "";
+  }
+
+  std::string Compression::precompressed(const std::string& path, const std::string& accept, std::string& coding) {
+    static const char* const preference[] = { "br", "zstd", "gzip", NULL };
+    std::vector<std::string> available;
+    struct stat st;
+    for(size_t i = 0; preference[i] != NULL; i++) {
+      // only look for files client would take
+      if (quality(accept, preference[i]) <= 0) continue;
+      if (::stat((path + suffix(preference[i])).c_str(), &st) == 0 && S_ISREG(st.st_mode)) available.push_back(preference[i]);
+    }
+    coding = negotiate(accept, available);
+    return path + suffix(coding);
+  }
+
+  bool Compression::compressible(const std::string& content_type) {
+    std::string type = content_type.substr(0, content_type.find(';'));
+    type.erase(type.find_last_not_of(" \t") + 1);
+    if (::strncasecmp(type.c_str(), "text/", 5) == 0) return true;
+    if (type.size() > 5 && (::strcasecmp(type.c_str() + type.size() - 5, "+json") == 0 || ::strcasecmp(type.c_str() + type.size() - 4, "+xml") == 0)) return true;
+    return ::strcasecmp(type.c_str(), "application/json") == 0 ||
+           ::strcasecmp(type.c_str(), "application/javascript") == 0 ||
+           ::strcasecmp(type.c_str(), "application/xml") == 0 ||
+           ::strcasecmp(type.c_str(), "application/wasm") == 0 ||
+           ::strcasecmp(type.c_str(), "image/svg+xml") == 0;
+  }
+
+#ifdef HAVE_ZLIB
+  /*! deflate streams kept per thread, reset and reused instead of allocating new state for every response */
+  class DeflatePool {
+  public:
+    struct Stream {
+      z_stream zs; //<! zlib state
+      int wbits; //<! window bits, 31 for gzip and 15 for deflate
+      int level; //<! compression level
+    };
+
+    ~DeflatePool() {
+      for(std::vector<Stream*>::iterator i = streams.begin(); i != streams.end(); i++) {
+        ::deflateEnd(&(*i)->zs);
+        delete *i;
+      }
+    }
+
+    Stream* acquire(const std::string& coding, int level) {
+      int wbits = (coding == "gzip" ? 31 : 15);
+      for(std::vector<Stream*>::iterator i = streams.begin(); i != streams.end(); i++) {
+        if ((*i)->wbits == wbits && (*i)->level == level) {
+          Stream* s = *i;
+          streams.erase(i);
+          return s;
+        }
+      }
+      Stream* s = new Stream();
+      ::memset(&s->zs, 0, sizeof(s->zs));
+      s->wbits = wbits;
+      s->level = level;
+      if (::deflateInit2(&s->zs, level, Z_DEFLATED, wbits, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        delete s;
+        return NULL;
+      }
+      return s;
+    }
+
+    void release(Stream* s) {
+      if (streams.size() < 4 && ::deflateReset(&s->zs) == Z_OK) {
+        streams.push_back(s);
+        return;
+      }
+      ::deflateEnd(&s->zs);
+      delete s;
+    }
+  private:
+    std::vector<Stream*> streams; //<! idle streams
+  };
+
+  static thread_local DeflatePool deflatePool;
+
+  /*! Returns stream to pool when it goes out of scope */
+  class PooledDeflate {
+  public:
+    PooledDeflate(const std::string& coding, int level): stream(deflatePool.acquire(coding, level)) {
+      if (stream == NULL) throw Error("Cannot initialize " + coding + " compression");
+    };
+    ~PooledDeflate() { deflatePool.release(stream); };
+    z_stream* operator->() { return &stream->zs; };
+    z_stream* get() { return &stream->zs; };
+  private:
+    PooledDeflate(const PooledDeflate&);
+    PooledDeflate& operator=(const PooledDeflate&);
+    DeflatePool::Stream* stream;
+  };
+
+  /*! Stream buffer which deflates what is written to it and writes the result to another stream */
+  class DeflateBuffer: public std::streambuf {
+  public:
+    DeflateBuffer(z_stream* zs_, std::ostream& os_, bool chunked_): written(0), zs(zs_), os(os_), chunked(chunked_) {
+      setp(in, in + sizeof(in));
+    };
+
+    bool finish() { return pump(Z_FINISH); }; //<! flushes everything out
+
+    size_t written; //<! compressed bytes written
+  protected:
+    int_type overflow(int_type c) override {
+      if (!pump(Z_NO_FLUSH)) return traits_type::eof();
+      if (!traits_type::eq_int_type(c, traits_type::eof())) {
+        *pptr() = traits_type::to_char_type(c);
+        pbump(1);
+      }
+      return traits_type::not_eof(c);
+    };
+  private:
+    bool pump(int flush) {
+      int r;
+      zs->next_in = reinterpret_cast<Bytef*>(pbase());
+      zs->avail_in = pptr() - pbase();
+      do {
+        zs->next_out = out;
+        zs->avail_out = sizeof(out);
+        r = ::deflate(zs, flush);
+        if (r == Z_STREAM_ERROR) return false;
+        size_t n = sizeof(out) - zs->avail_out;
+        if (n > 0) {
+          if (chunked) os << std::hex << n << std::dec << "\r\n";
+          os.write(reinterpret_cast<const char*>(out), n);
+          if (chunked) os << "\r\n";
+          written += n;
+        } else if (r == Z_BUF_ERROR) {
+          break;
+        }
+      } while(zs->avail_out == 0 || (flush == Z_FINISH && r != Z_STREAM_END));
+      setp(in, in + sizeof(in));
+      return true;
+    };
+
+    z_stream* zs; //<! compressor
+    std::ostream& os; //<! where compressed data goes
+    bool chunked; //<! whether to write compressed data as chunks
+    char in[16384]; //<! uncompressed data
+    Bytef out[16384]; //<! compressed data
+  };
+
+  bool Compression::compress(const std::string& data, std::string& result, const std::string& coding, int level) {
+    PooledDeflate zs(coding, level);
+    result.resize(::deflateBound(zs.get(), data.size()));
+    zs->next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    zs->avail_in = data.size();
+    zs->next_out = reinterpret_cast<Bytef*>(&result[0]);
+    zs->avail_out = result.size();
+    if (::deflate(zs.get(), Z_FINISH) != Z_STREAM_END) return false;
+    result.resize(zs->total_out);
+    return true;
+  }
+
+  bool Compression::apply(const Request& req, Response& resp, int level, size_t min_size) {
+    static const std::vector<std::string> codings = { "gzip", "deflate" };
+    strstr_map_t::const_iterator i;
+    const HTTPBase::SendFileRender* file = resp.renderer.target<HTTPBase::SendFileRender>();
+    size_t size;
+    struct stat st;
+
+    if (!Utility::statusHasBody(resp.status) || resp.status == 206) return false;
+    if (resp.headers.find("content-encoding") != resp.headers.end()) return false;
+    if ((i = resp.headers.find("content-type")) == resp.headers.end() || !compressible(i->second)) return false;
+    if (resp.renderer.target<HTTPBase::SendBodyRender>() != NULL) size = resp.body.size();
+    else if (file != NULL && ::stat(file->path.c_str(), &st) == 0) size = st.st_size;
+    else return false;
+    if (size < min_size) return false;
+
+    // from here on response depends on Accept-Encoding
+    i = resp.headers.find("vary");
+    if (i == resp.headers.end()) resp.headers["vary"] = "Accept-Encoding";
+    else if (i->second.find("Accept-Encoding") == std::string::npos && i->second != "*") resp.headers["vary"] = i->second + ", Accept-Encoding";
+
+    if ((i = req.headers.find("accept-encoding")) == req.headers.end()) return false;
+    std::string coding = negotiate(i->second, codings);
+    if (coding.empty()) return false;
+
+    if (file == NULL) {
+      std::string result;
+      if (!compress(resp.body, result, coding, level) || result.size() >= resp.body.size()) return false;
+      resp.body.swap(result);
+      if (resp.headers.find("content-length") != resp.headers.end()) {
+        std::ostringstream len;
+        len << resp.body.size();
+        resp.headers["content-length"] = len.str();
+      }
+    } else {
+      resp.renderer = CompressRender(resp.renderer, coding, level);
+      resp.headers.erase("content-length");
+    }
+    resp.headers["content-encoding"] = coding;
+    // compressed bytes differ from the originals, so validator can only be weak
+    if ((i = resp.headers.find("etag")) != resp.headers.end() && i->second.compare(0, 2, "W/") != 0)
+      resp.headers["etag"] = "W/" + i->second;
+    return true;
+  }
+
+  size_t CompressRender::operator()(const HTTPBase *doc, std::ostream& os, bool chunked) const {
+    PooledDeflate zs(coding, level);
+    DeflateBuffer buffer(zs.get(), os, chunked);
+    std::ostream zos(&buffer);
+    inner(doc, zos, false);
+    zos.flush();
+    if (!buffer.finish()) throw Error("Compression failed");
+    if (chunked) os << 0 << "\r\n\r\n";
+    return buffer.written;
+  }
+#endif
+};
+#endif
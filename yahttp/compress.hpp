@@ -0,0 +1,50 @@
+#pragma once
+/* @file
+ * @brief Defines content coding negotiation and response compression
+ */
+#ifdef HAVE_CPP_FUNC_PTR
+#include <string>
+#include <vector>
+
+namespace YaHTTP {
+  /*! Content coding negotiation and compression of responses.
+
+Accept-Encoding is evaluated with quality values, so "gzip;q=0" refuses gzip and "*" stands for codings not listed.
+Precompressed files are found next to the original with .br, .zst or .gz appended. With zlib, response bodies can be
+compressed with gzip or deflate, either at once for bodies in memory or while rendering with CompressRender. deflate
+contexts are pooled per thread and reset between responses instead of being allocated for each one.
+  */
+  class Compression {
+  public:
+    static float quality(const std::string& accept, const std::string& coding); //<! quality value Accept-Encoding accept gives to coding, identity is acceptable unless refused
+    static std::string negotiate(const std::string& accept, const std::vector<std::string>& codings); //<! best coding from codings, which are in order of preference, or empty for identity
+    static std::string suffix(const std::string& coding); //<! file name suffix of precompressed files with coding, empty if there is none
+    static std::string precompressed(const std::string& path, const std::string& accept, std::string& coding); //<! path of best precompressed sibling of path client accepts and sets coding, or path and empty coding
+    static bool compressible(const std::string& content_type); //<! whether content type is worth compressing, text and structured text are
+#ifdef HAVE_ZLIB
+    static bool compress(const std::string& data, std::string& result, const std::string& coding, int level = 6); //<! compresses data with gzip or deflate into result
+    static bool apply(const Request& req, Response& resp, int level = 6, size_t min_size = 1024); //<! compresses response if client accepts gzip or deflate, returns whether it did
+#endif
+  };
+
+#ifdef HAVE_ZLIB
+  /*! Renderer which compresses the output of another renderer as it is produced.
+
+The wrapped renderer writes into a deflate stream and compressed data is passed on as it comes out, as chunks when
+the response is chunked. Content-Length is unknown in advance, so responses are chunked for HTTP/1.1 clients.
+  */
+  class CompressRender {
+  public:
+    typedef funcptr::function<size_t(const HTTPBase*,std::ostream&,bool)> TRenderer; //<! renderer type
+
+    CompressRender(const TRenderer& inner_, const std::string& coding_, int level_ = 6): inner(inner_), coding(coding_), level(level_) {}; //<! compress output of inner_ with gzip or deflate
+
+    size_t operator()(const HTTPBase *doc, std::ostream& os, bool chunked) const; //<! writes compressed output to ostream and returns its length
+
+    TRenderer inner; //<! renderer producing uncompressed data
+    std::string coding; //<! gzip or deflate
+    int level; //<! zlib compression level
+  };
+#endif
+};
+#endif
@@ -39,28 +39,143 @@ namespace YaHTTP {
      std::string name; /*!< Cookie name */
      std::string value; /*!< Cookie value */
 
-     std::string str() const {
-       std::ostringstream oss;
-       oss << YaHTTP::Utility::encodeURL(name) << "=" << YaHTTP::Utility::encodeURL(value);
+     void appendPair(std::string& result) const {
+       Utility::encodeCookie(name.data(), name.size(), result, true);
+       result += '=';
+       Utility::encodeCookie(value.data(), value.size(), result);
+     }; //!< Appends encoded name=value, as sent in Cookie header, to result
 
-       if (expires.isSet) 
-         oss << "; expires=" << expires.cookie_str();
+     void append(std::string& result) const {
+       appendPair(result);
+       if (expires.isSet)
+         result.append("; expires=").append(expires.cookie_str());
        if (domain.size()>0)
-         oss << "; domain=" << domain;
+         result.append("; domain=").append(domain);
        if (path.size()>0)
-         oss << "; path=" << path;
+         result.append("; path=").append(path);
        if (secure)
-         oss << "; secure";
+         result.append("; secure");
        if (httponly)
-         oss << "; httpOnly";
-       return oss.str();
+         result.append("; httpOnly");
+     }; //!< Appends the cookie, as sent in Set-Cookie header, to result
+
+     std::string pair() const {
+       std::string result;
+       appendPair(result);
+       return result;
+     }; //!< Encoded name=value, as sent in Cookie header
+
+     std::string str() const {
+       std::string result;
+       append(result);
+       return result;
      }; //!< Stringify the cookie
   };
 
+#ifdef YAHTTP_USE_UNORDERED_MAP
+  typedef std::unordered_map<std::string,Cookie,ASCIICIHash,ASCIICIEqual> strcookie_map_t; //<! String to Cookie map
+#else
+  typedef std::map<std::string,Cookie,ASCIICINullSafeComparator> strcookie_map_t; //<! String to Cookie map
+#endif
+
+  class CookieJar;
+
+  /*! Cookies of request Cookie header(s) as name and value slices.
+
+Keeps a copy of the headers and offsets of names and values, which are decoded only when asked for.
+Lookups by name are case-insensitive and later cookies replace earlier ones with same name, like in CookieJar.
+  */
+  class CookieList {
+  public:
+    void parse(const std::string& cookiestr) {
+      size_t pos, next, eq, last;
+      Entry entry;
+      if (raw.empty() == false) raw += "; ";
+      pos = raw.size();
+      raw.append(cookiestr);
+      while(pos < raw.size()) {
+        while(pos < raw.size() && YaHTTP::isspace(raw[pos])) pos++;
+        if ((next = raw.find(';', pos)) == std::string::npos) next = raw.size();
+        for(last = next; last > pos && YaHTTP::isspace(raw[last-1]); last--);
+        if (last > pos) { // skip empty cookies
+          if ((eq = raw.find('=', pos)) >= last) throw ParseError("Not a Key-Value pair (cookie)");
+          entry.name = pos;
+          for(entry.namelen = eq - pos; entry.namelen > 0 && YaHTTP::isspace(raw[pos + entry.namelen - 1]); entry.namelen--);
+          for(entry.value = eq + 1; entry.value < last && YaHTTP::isspace(raw[entry.value]); entry.value++);
+          entry.valuelen = last - entry.value;
+          entries.push_back(entry);
+        }
+        pos = next + 1;
+      }
+    }; //<! scan name=value pairs separated with ; from cookie header, can be called for each header
+
+    void clear() { raw.clear(); entries.clear(); }; //<! remove all cookies
+    size_t size() const { return entries.size(); }; //<! number of cookies
+    bool empty() const { return entries.empty(); }; //<! whether there are no cookies
+
+    StringView rawName(size_t i) const { return StringView(raw.data() + entries[i].name, entries[i].namelen); }; //<! undecoded name of cookie i
+    StringView rawValue(size_t i) const { return StringView(raw.data() + entries[i].value, entries[i].valuelen); }; //<! undecoded value of cookie i
+
+    std::string name(size_t i) const {
+      std::string result;
+      Utility::decodeURL(raw.data() + entries[i].name, entries[i].namelen, result);
+      return result;
+    }; //<! decoded name of cookie i
+
+    std::string value(size_t i) const {
+      std::string result;
+      Utility::decodeURL(raw.data() + entries[i].value, entries[i].valuelen, result);
+      return result;
+    }; //<! decoded value of cookie i
+
+    size_t find(const std::string& cookiename) const {
+      for(size_t i = entries.size(); i > 0; i--)
+        if (nameIs(i - 1, cookiename)) return i - 1;
+      return StringView::npos;
+    }; //<! index of last cookie named cookiename, StringView::npos if not found
+
+    bool has(const std::string& cookiename) const { return find(cookiename) != StringView::npos; }; //<! whether cookie exists
+
+    bool get(const std::string& cookiename, std::string& result) const {
+      size_t i = find(cookiename);
+      if (i == StringView::npos) return false;
+      result.clear();
+      Utility::decodeURL(raw.data() + entries[i].value, entries[i].valuelen, result);
+      return true;
+    }; //<! decodes value of cookie into result, returns false if not found
+
+    std::string get(const std::string& cookiename) const {
+      std::string result;
+      get(cookiename, result);
+      return result;
+    }; //<! decoded value of cookie, empty if not found
+
+    void load(CookieJar& jar, size_t from = 0) const; //<! adds cookies starting from index from into jar
+
+  private:
+    struct Entry {
+      size_t name; //<! offset of name
+      size_t namelen; //<! length of name
+      size_t value; //<! offset of value
+      size_t valuelen; //<! length of value
+    };
+
+    bool nameIs(size_t i, const std::string& cookiename) const {
+      const char *ptr = raw.data() + entries[i].name;
+      if (::memchr(ptr, '%', entries[i].namelen) != NULL)
+        return Utility::iequals(name(i), cookiename);
+      if (entries[i].namelen != cookiename.size()) return false;
+      return asciiCaseCompare(ptr, cookiename.data(), cookiename.size()) == 0;
+    }; //<! compare name of cookie i, decoding only when necessary
+
+    std::string raw; //<! cookie headers
+    std::vector<Entry> entries; //<! cookie offsets in order
+  };
+
   /*! Implements a Cookie jar for storing multiple cookies */
   class CookieJar {
     public:
-    std::map<std::string, Cookie, ASCIICINullSafeComparator> cookies;  //<! cookie container
+    strcookie_map_t cookies;  //<! cookie container
   
     CookieJar() {}; //<! constructs empty cookie jar
     CookieJar(const CookieJar & rhs) {
@@ -85,23 +200,10 @@ namespace YaHTTP {
     } //<! key value pair parser
   
     void parseCookieHeader(const std::string &cookiestr) {
-      size_t pos, npos;
-      std::list<Cookie> lcookies;
-      Cookie c;
-      pos = 0;
-      while(pos < cookiestr.size()) {
-        if ((npos = cookiestr.find("; ", pos)) == std::string::npos)
-          npos = cookiestr.size();
-        keyValuePair(cookiestr.substr(pos, npos-pos), c.name, c.value);
-        c.name = YaHTTP::Utility::decodeURL(c.name);
-        c.value = YaHTTP::Utility::decodeURL(c.value);
-        lcookies.push_back(c);
-        pos = npos+2;
-      }
-      for(std::list<Cookie>::iterator i = lcookies.begin(); i != lcookies.end(); i++) {
-        this->cookies[i->name] = *i;
-      }
-    }
+      CookieList list;
+      list.parse(cookiestr);
+      list.load(*this);
+    } //<! Parse cookies from Cookie header, see CookieList
 
     void parseSetCookieHeader(const std::string &cookiestr) {
       Cookie c;
@@ -145,4 +247,13 @@ namespace YaHTTP {
       this->cookies[c.name] = c;
     }; //<! Parse multiple cookies from header 
   };
+
+  inline void CookieList::load(CookieJar& jar, size_t from) const {
+    Cookie c;
+    for(size_t i = from; i < entries.size(); i++) {
+      c.name = name(i);
+      c.value = value(i);
+      jar.cookies[c.name] = c;
+    }
+  };
 };
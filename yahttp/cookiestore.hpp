@@ -0,0 +1,328 @@
+#pragma once
+/* @file
+ * @brief Defines client side cookie store
+ */
+#include <algorithm>
+#include <atomic>
+#include <ctime>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace YaHTTP {
+  /*! Client side cookie store, scoping cookies by domain and path like browsers do.
+
+Cookies are kept in a trie of reversed domain labels (com -> example -> www) and indexed by path
+within each domain, so finding the cookies for a URL looks only at the domains and path prefixes
+that can match. Expired cookies are dropped through a heap ordered by expiration time. Domains are
+sharded by their last two labels, each shard having its own lock, so the store can be shared between
+threads.
+
+@code
+YaHTTP::CookieStore store;
+store.store(req.url, resp.jar); // cookies received with response to req
+store.apply(next); // sets Cookie header of next request
+@endcode
+  */
+  class CookieStore {
+  private:
+    struct Stored {
+      Cookie cookie; //<! cookie, domain and path are normalized
+      bool hostOnly; //<! whether cookie is sent only to the exact host
+      time_t expires; //<! unixtime when cookie expires, 0 for session cookies
+      unsigned long serial; //<! creation order
+      unsigned long version; //<! changes whenever cookie is stored again with different expiration
+    };
+
+    typedef std::unordered_map<std::string, Stored> TNameMap; //<! cookies by name
+    typedef std::unordered_map<std::string, TNameMap> TPathMap; //<! cookies by path
+
+    struct Node {
+      std::unordered_map<std::string, std::unique_ptr<Node> > children; //<! subdomains by label
+      TPathMap paths; //<! cookies of this domain
+    };
+
+    struct Expiry {
+      time_t expires; //<! expiration time
+      unsigned long version; //<! version of cookie when scheduled
+      std::string domain; //<! domain of cookie
+      std::string path; //<! path of cookie
+      std::string name; //<! name of cookie
+      bool operator>(const Expiry& rhs) const { return expires > rhs.expires; };
+    };
+
+    struct Shard {
+      Shard(): count(0) {};
+      std::mutex lock; //<! protects this shard
+      Node root; //<! domain trie
+      std::priority_queue<Expiry, std::vector<Expiry>, std::greater<Expiry> > expiry; //<! earliest expiration first
+      size_t count; //<! number of cookies
+    };
+
+    static std::vector<std::string> labels(const std::string& domain) {
+      std::vector<std::string> result;
+      size_t pos = domain.size(), dot;
+      while(pos > 0) {
+        if ((dot = domain.rfind('.', pos - 1)) == std::string::npos) {
+          result.push_back(domain.substr(0, pos));
+          break;
+        }
+        result.push_back(domain.substr(dot + 1, pos - dot - 1));
+        pos = dot;
+      }
+      return result;
+    }; //<! domain labels, top level first
+
+    Shard& shard(const std::vector<std::string>& domain) {
+      std::string key;
+      if (domain.size() > 0) key = domain[0];
+      if (domain.size() > 1) key += "." + domain[1];
+      return shards[std::hash<std::string>()(key) % shards.size()];
+    }; //<! shard owning domain
+
+    static bool isAddress(const std::string& host) {
+      if (host.find(':') != std::string::npos) return true; // IPv6
+      for(std::string::const_iterator i = host.begin(); i != host.end(); i++)
+        if (!YaHTTP::isdigit(*i) && *i != '.') return false;
+      return true;
+    }; //<! whether host is IP address
+
+    static std::string defaultPath(const std::string& path) {
+      size_t pos;
+      if (path.empty() || path[0] != '/' || (pos = path.rfind('/')) == 0) return "/";
+      return path.substr(0, pos);
+    }; //<! default cookie path for request path (RFC 6265 5.1.4)
+
+    static time_t now() { return time((time_t*)NULL); }; //<! current time
+
+    Node* find(Node* node, const std::vector<std::string>& domain, bool create) {
+      for(std::vector<std::string>::const_iterator i = domain.begin(); i != domain.end(); i++) {
+        std::unordered_map<std::string, std::unique_ptr<Node> >::iterator child = node->children.find(*i);
+        if (child == node->children.end()) {
+          if (!create) return NULL;
+          child = node->children.insert(std::make_pair(*i, std::unique_ptr<Node>(new Node()))).first;
+        }
+        node = child->second.get();
+      }
+      return node;
+    }; //<! find node for domain, caller holds lock
+
+    bool remove(Shard& s, const std::vector<std::string>& domain, const std::string& path, const std::string& name, unsigned long version) {
+      std::vector<Node*> trail(1, &s.root);
+      for(std::vector<std::string>::const_iterator i = domain.begin(); i != domain.end(); i++) {
+        std::unordered_map<std::string, std::unique_ptr<Node> >::iterator child = trail.back()->children.find(*i);
+        if (child == trail.back()->children.end()) return false;
+        trail.push_back(child->second.get());
+      }
+      TPathMap::iterator p = trail.back()->paths.find(path);
+      if (p == trail.back()->paths.end()) return false;
+      TNameMap::iterator n = p->second.find(name);
+      if (n == p->second.end() || (version > 0 && n->second.version != version)) return false;
+      p->second.erase(n);
+      s.count--;
+      if (p->second.empty()) trail.back()->paths.erase(p);
+      // prune empty nodes
+      for(size_t i = trail.size() - 1; i > 0 && trail[i]->paths.empty() && trail[i]->children.empty(); i--)
+        trail[i-1]->children.erase(domain[i-1]);
+      return true;
+    }; //<! remove cookie, only if it has given version unless version is 0, caller holds lock
+
+    void purge(Shard& s, time_t when) {
+      while(s.expiry.size() > 0 && s.expiry.top().expires <= when) {
+        const Expiry& e = s.expiry.top();
+        remove(s, labels(e.domain), e.path, e.name, e.version);
+        s.expiry.pop();
+      }
+    }; //<! drop expired cookies, caller holds lock
+
+    void compact(Shard& s) {
+      std::vector<Expiry> live;
+      for(; s.expiry.size() > 0; s.expiry.pop()) {
+        const Expiry& e = s.expiry.top();
+        Node* node = find(&s.root, labels(e.domain), false);
+        if (node == NULL) continue;
+        TPathMap::const_iterator p = node->paths.find(e.path);
+        if (p == node->paths.end()) continue;
+        TNameMap::const_iterator n = p->second.find(e.name);
+        if (n != p->second.end() && n->second.version == e.version) live.push_back(e);
+      }
+      s.expiry = std::priority_queue<Expiry, std::vector<Expiry>, std::greater<Expiry> >(std::greater<Expiry>(), std::move(live));
+    }; //<! drop expirations of replaced and removed cookies, caller holds lock
+
+    static void collect(const Node* node, bool exact, const std::string& path, bool secure, time_t when, std::vector<const Stored*>& result) {
+      // candidate cookie paths are prefixes of path that end next to a slash, or the whole path
+      for(size_t len = 1; len <= path.size(); len++) {
+        if (len < path.size() && path[len] != '/' && path[len-1] != '/') continue;
+        TPathMap::const_iterator p = node->paths.find(path.substr(0, len));
+        if (p == node->paths.end()) continue;
+        for(TNameMap::const_iterator n = p->second.begin(); n != p->second.end(); n++) {
+          if (n->second.hostOnly && !exact) continue;
+          if (n->second.cookie.secure && !secure) continue;
+          if (n->second.expires > 0 && n->second.expires <= when) continue;
+          result.push_back(&n->second);
+        }
+      }
+    }; //<! add cookies of node matching path into result
+
+    static bool sendOrder(const Stored* a, const Stored* b) {
+      if (a->cookie.path.size() != b->cookie.path.size()) return a->cookie.path.size() > b->cookie.path.size();
+      return a->serial < b->serial;
+    }; //<! longer paths first, then older cookies first (RFC 6265 5.4)
+
+    std::vector<Shard> shards; //<! shards
+    std::atomic<unsigned long> serials; //<! creation counter
+
+  public:
+    CookieStore(size_t nshards = 16): shards(nshards > 0 ? nshards : 1), serials(0) {}; //<! construct empty store
+
+    bool store(const URL& url, const Cookie& cookie, time_t when = 0) {
+      Stored entry;
+      std::string host = url.host;
+      asciiToLower(host);
+      if (when == 0) when = now();
+      if (cookie.name.empty()) return false;
+
+      entry.cookie = cookie;
+      entry.hostOnly = cookie.domain.empty();
+      if (entry.hostOnly) {
+        entry.cookie.domain = host;
+      } else {
+        if (entry.cookie.domain[0] == '.') entry.cookie.domain.erase(0, 1);
+        asciiToLower(entry.cookie.domain);
+        if (entry.cookie.domain != host) {
+          // must be parent domain of host and not top level domain
+          if (isAddress(host) || entry.cookie.domain.find('.') == std::string::npos ||
+              host.size() <= entry.cookie.domain.size() ||
+              host.compare(host.size() - entry.cookie.domain.size(), std::string::npos, entry.cookie.domain) != 0 ||
+              host[host.size() - entry.cookie.domain.size() - 1] != '.') return false;
+        }
+      }
+      if (entry.cookie.domain.empty()) return false;
+      if (entry.cookie.path.empty() || entry.cookie.path[0] != '/') entry.cookie.path = defaultPath(url.path);
+      entry.expires = (cookie.expires.isSet ? cookie.expires.utctime() : 0);
+      entry.serial = entry.version = ++serials;
+
+      std::vector<std::string> domain = labels(entry.cookie.domain);
+      Shard& s = shard(domain);
+      std::lock_guard<std::mutex> guard(s.lock);
+      purge(s, when);
+
+      if (entry.expires > 0 && entry.expires <= when) {
+        // expired cookie removes existing one
+        remove(s, domain, entry.cookie.path, entry.cookie.name, 0);
+        return true;
+      }
+
+      TNameMap& names = find(&s.root, domain, true)->paths[entry.cookie.path];
+      TNameMap::iterator n = names.find(entry.cookie.name);
+      bool scheduled = false;
+      if (n == names.end()) {
+        s.count++;
+        names.insert(std::make_pair(entry.cookie.name, entry));
+      } else {
+        entry.serial = n->second.serial; // keeps position when replaced
+        scheduled = (entry.expires == n->second.expires); // same expiration is already in heap
+        if (scheduled) entry.version = n->second.version;
+        n->second = entry;
+      }
+      if (entry.expires > 0 && !scheduled) {
+        Expiry e;
+        e.expires = entry.expires;
+        e.version = entry.version;
+        e.domain = entry.cookie.domain;
+        e.path = entry.cookie.path;
+        e.name = entry.cookie.name;
+        s.expiry.push(e);
+        if (s.expiry.size() > 2 * s.count) compact(s);
+      }
+      return true;
+    }; //<! stores cookie received from url, returns false if cookie was rejected because of its name or domain
+
+    void store(const URL& url, const CookieJar& jar, time_t when = 0) {
+      for(strcookie_map_t::const_iterator i = jar.cookies.begin(); i != jar.cookies.end(); i++)
+        store(url, i->second, when);
+    }; //<! stores all cookies in jar, such as cookies from a response
+
+    void storeSetCookie(const URL& url, const std::string& setcookie, time_t when = 0) {
+      CookieJar jar;
+      jar.parseSetCookieHeader(setcookie);
+      store(url, jar, when);
+    }; //<! parses and stores Set-Cookie header value
+
+    void cookiesFor(const URL& url, std::vector<Cookie>& result, time_t when = 0) {
+      std::vector<const Stored*> found;
+      std::string host = url.host;
+      std::string path = (url.path.empty() ? "/" : url.path);
+      bool secure = (url.protocol == "https");
+      asciiToLower(host);
+      if (when == 0) when = now();
+
+      std::vector<std::string> domain = labels(host);
+      Shard& s = shard(domain);
+      std::lock_guard<std::mutex> guard(s.lock);
+      const Node* node = &s.root;
+      for(size_t i = 0; i < domain.size() && node != NULL; i++) {
+        std::unordered_map<std::string, std::unique_ptr<Node> >::const_iterator child = node->children.find(domain[i]);
+        if (child == node->children.end()) break;
+        node = child->second.get();
+        // only domains with two or more labels can set domain cookies
+        if (i > 0 || i + 1 == domain.size()) collect(node, i + 1 == domain.size(), path, secure, when, found);
+      }
+      std::sort(found.begin(), found.end(), sendOrder);
+      for(std::vector<const Stored*>::const_iterator i = found.begin(); i != found.end(); i++)
+        result.push_back((*i)->cookie);
+    }; //<! appends cookies to send to url into result, in send order
+
+    std::string cookieHeader(const URL& url, time_t when = 0) {
+      std::vector<Cookie> found;
+      std::string result;
+      cookiesFor(url, found, when);
+      for(std::vector<Cookie>::const_iterator i = found.begin(); i != found.end(); i++) {
+        if (result.empty() == false) result += "; ";
+        i->appendPair(result);
+      }
+      return result;
+    }; //<! value of Cookie header for request to url, empty if there are no cookies
+
+    void apply(Request& req, time_t when = 0) {
+      std::string value = cookieHeader(req.url, when);
+      if (value.empty()) req.headers.erase("cookie");
+      else req.headers["cookie"] = value;
+    }; //<! sets Cookie header of req from store
+
+    size_t expire(time_t when = 0) {
+      size_t n = 0;
+      if (when == 0) when = now();
+      for(std::vector<Shard>::iterator i = shards.begin(); i != shards.end(); i++) {
+        std::lock_guard<std::mutex> guard(i->lock);
+        size_t before = i->count;
+        purge(*i, when);
+        n += before - i->count;
+      }
+      return n;
+    }; //<! drops expired cookies, returns number of cookies dropped
+
+    void clear() {
+      for(std::vector<Shard>::iterator i = shards.begin(); i != shards.end(); i++) {
+        std::lock_guard<std::mutex> guard(i->lock);
+        i->root.children.clear();
+        i->root.paths.clear();
+        i->expiry = std::priority_queue<Expiry, std::vector<Expiry>, std::greater<Expiry> >();
+        i->count = 0;
+      }
+    }; //<! removes all cookies
+
+    size_t size() {
+      size_t n = 0;
+      for(std::vector<Shard>::iterator i = shards.begin(); i != shards.end(); i++) {
+        std::lock_guard<std::mutex> guard(i->lock);
+        n += i->count;
+      }
+      return n;
+    }; //<! number of stored cookies, including expired ones not yet dropped
+  };
+};
@@ -21,4 +21,10 @@ namespace YaHTTP {
     ParseError() {};
     ParseError(const std::string& reason_): Error(reason_) {};
   };
+  /*! Document, or part of it, is larger than allowed */
+  class SizeError: public YaHTTP::ParseError {
+  public:
+    SizeError() {};
+    SizeError(const std::string& reason_): ParseError(reason_) {};
+  };
 };
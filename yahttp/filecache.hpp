@@ -0,0 +1,256 @@
+#pragma once
+/* @file
+ * @brief Defines in-memory cache for static files
+ */
+#ifdef HAVE_CPP_FUNC_PTR
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <strings.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+#include "cache.hpp"
+#include "compress.hpp"
+
+namespace YaHTTP {
+  /*! Static file loaded into memory together with the headers it is served with.
+
+Small files are read into memory, larger ones are kept open and sent from the file with HTTPBase::ZeroCopyFileRender.
+They are not mapped, as a mapping faults with SIGBUS once the file is truncated under it, while a short sendfile only
+ends the response. Content-Type, ETag, Last-Modified and Content-Length are computed once when the file is loaded.
+Instances are immutable after load() apart from the revalidation timestamp, so they can be shared between threads
+and responses.
+  */
+  class StaticFile {
+  public:
+    StaticFile(): data(NULL), size(0), dev(0), ino(0), mtime(0), mtime_nsec(0), checked(0) {};
+
+    bool load(const std::string& path_, size_t preload_limit, long long now) {
+      struct stat st;
+      HTTPBase::ZeroCopyFileRender opened(path_);
+      if (!opened.valid() || ::fstat(opened.fd(), &st) < 0) return false;
+      size = st.st_size;
+      if (size > preload_limit) {
+        file = opened;
+      } else {
+        preloaded.resize(size);
+        size_t pos = 0;
+        while(pos < size) {
+          ssize_t n = ::pread(opened.fd(), &preloaded[pos], size - pos, pos);
+          if (n < 0 && errno == EINTR) continue;
+          if (n <= 0) break;
+          pos += n;
+        }
+        preloaded.resize(pos);
+        size = pos;
+        data = preloaded.data();
+      }
+
+      path = path_;
+      dev = st.st_dev;
+      ino = st.st_ino;
+      mtime = st.st_mtime;
+      mtime_nsec = st.st_mtim.tv_nsec;
+      checked = now;
+
+      etag = Utility::makeETag(mtime, size);
+      DateTime modified;
+      modified.fromGmtime(mtime);
+      last_modified = modified.http_str();
+      std::ostringstream len;
+      len << size;
+      content_length = len.str();
+      content_type = contentType(path);
+      return true;
+    }; //<! loads file at path_, preloading it when it is at most preload_limit bytes and keeping it open otherwise, returns false if it is not a readable regular file
+
+    bool same(const struct stat& st) const {
+      return S_ISREG(st.st_mode) && st.st_dev == dev && st.st_ino == ino &&
+             static_cast<size_t>(st.st_size) == size && st.st_mtime == mtime && st.st_mtim.tv_nsec == mtime_nsec;
+    }; //<! whether st describes the file as it was loaded
+
+    size_t weight() const {
+      return (file.valid() ? sizeof(StaticFile) : size + 1); // empty files weigh something too
+    }; //<! memory held by file, its size when preloaded and a nominal amount when kept open
+
+    static std::string contentType(const std::string& path) {
+      static const char* const TYPES[][2] = {
+        { "html", "text/html; charset=utf-8" },
+        { "htm", "text/html; charset=utf-8" },
+        { "css", "text/css; charset=utf-8" },
+        { "js", "application/javascript; charset=utf-8" },
+        { "json", "application/json" },
+        { "txt", "text/plain; charset=utf-8" },
+        { "xml", "application/xml" },
+        { "svg", "image/svg+xml" },
+        { "png", "image/png" },
+        { "jpg", "image/jpeg" },
+        { "jpeg", "image/jpeg" },
+        { "gif", "image/gif" },
+        { "webp", "image/webp" },
+        { "ico", "image/x-icon" },
+        { "pdf", "application/pdf" },
+        { "wasm", "application/wasm" },
+        { "woff", "font/woff" },
+        { "woff2", "font/woff2" },
+        { "mp4", "video/mp4" },
+        { NULL, NULL }
+      };
+      size_t dot = path.find_last_of("./");
+      if (dot == std::string::npos || path[dot] != '.') return "application/octet-stream";
+      for(size_t i = 0; TYPES[i][0] != NULL; i++)
+        if (strcasecmp(path.c_str() + dot + 1, TYPES[i][0]) == 0) return TYPES[i][1];
+      return "application/octet-stream";
+    }; //<! guesses content type from file extension
+
+    std::string path; //<! path file was loaded from
+    const char* data; //<! file contents, NULL when file is kept open instead
+    size_t size; //<! file size
+    HTTPBase::ZeroCopyFileRender file; //<! open file when it is larger than preload limit
+
+    dev_t dev; //<! device of file
+    ino_t ino; //<! inode of file
+    time_t mtime; //<! modification time of file
+    long mtime_nsec; //<! nanoseconds of modification time
+
+    std::string content_type; //<! value for Content-Type
+    std::string etag; //<! value for ETag
+    std::string last_modified; //<! value for Last-Modified
+    std::string content_length; //<! value for Content-Length
+
+    std::vector<std::pair<std::string, std::shared_ptr<const StaticFile> > > encodings; //<! precompressed siblings by content coding, in order of preference
+
+    mutable std::atomic<long long> checked; //<! milliseconds on steady clock when file was last compared with disk
+  private:
+    StaticFile(const StaticFile&);
+    StaticFile& operator=(const StaticFile&);
+
+    std::string preloaded; //<! contents of small files
+  };
+
+  /*! Cache of static files kept in memory and served without copying.
+
+Files are looked up by path and weighed by the memory they hold, least recently used files are dropped when capacity
+is exceeded. Preloaded files weigh their size, files kept open only a nominal amount, as their contents are not in the
+cache. Each cached file is compared with disk at most once every revalidate_ms milliseconds, and reloaded if its
+inode, size or modification time changed. Preloaded files larger than capacity / 16 are loaded but not kept.
+Responses get the precomputed headers and a HTTPBase::SharedBufferRender of preloaded files or a
+HTTPBase::ZeroCopyFileRender of the open file, so Server writes them straight from the cache. The cache can be shared
+between threads.
+
+Precompressed siblings of a file (file.br, file.zst and file.gz) are loaded with it and served instead of it to
+clients whose Accept-Encoding allows, when serve is given the request. Siblings are reloaded when the file itself
+changes, so they should be written before it.
+
+serve refuses paths with .. segments, so that request paths appended to a directory cannot reach outside it.
+
+@code
+static YaHTTP::FileCache files;
+...
+if (!files.serve("htdocs" + YaHTTP::Utility::normalizePath(req->url.path), *resp)) resp->status = 404;
+@endcode
+  */
+  class FileCache {
+  public:
+    FileCache(size_t capacity = 64*1024*1024, long revalidate_ms_ = 1000, size_t preload_limit_ = 65536):
+      revalidate_ms(revalidate_ms_), preload_limit(preload_limit_), precompressed(true), files(capacity) {};
+
+    std::shared_ptr<const StaticFile> get(const std::string& path) {
+      long long now = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+      std::shared_ptr<const StaticFile> file;
+      if (files.get(path, file)) {
+        if (now - file->checked < revalidate_ms) return file;
+        struct stat st;
+        if (::stat(path.c_str(), &st) == 0 && file->same(st)) {
+          file->checked = now;
+          return file;
+        }
+      }
+      std::shared_ptr<StaticFile> loaded(new StaticFile());
+      if (!loaded->load(path, preload_limit, now)) {
+        files.erase(path);
+        return std::shared_ptr<const StaticFile>();
+      }
+      static const char* const codings[] = { "br", "zstd", "gzip" }; // in order of preference
+      size_t weight = loaded->weight();
+      for(size_t i = 0; precompressed && i < sizeof(codings)/sizeof(codings[0]); i++) {
+        std::shared_ptr<StaticFile> sibling(new StaticFile());
+        if (!sibling->load(path + Compression::suffix(codings[i]), preload_limit, now)) continue;
+        loaded->encodings.push_back(std::make_pair(std::string(codings[i]), sibling));
+        weight += sibling->weight();
+      }
+      files.put(path, loaded, weight);
+      return loaded;
+    }; //<! returns cached file for path, loading it when needed, or NULL if it cannot be read
+
+    bool serve(const std::string& path, Response& resp) {
+      if (climbs(path)) return false;
+      std::shared_ptr<const StaticFile> file = get(path);
+      if (!file) return false;
+      apply(file, resp);
+      return true;
+    }; //<! fills response with file at path, returns false if it cannot be read or path has .. segments
+
+    bool serve(const std::string& path, const Request& req, Response& resp) {
+      if (climbs(path)) return false;
+      std::shared_ptr<const StaticFile> file = get(path);
+      if (!file) return false;
+      std::shared_ptr<const StaticFile> variant = file;
+      std::string coding;
+      strstr_map_t::const_iterator accept = req.headers.find("accept-encoding");
+      if (file->encodings.size() > 0 && accept != req.headers.end()) {
+        std::vector<std::string> codings;
+        for(size_t i = 0; i < file->encodings.size(); i++) codings.push_back(file->encodings[i].first);
+        coding = Compression::negotiate(accept->second, codings);
+        for(size_t i = 0; i < file->encodings.size(); i++)
+          if (file->encodings[i].first == coding) variant = file->encodings[i].second;
+      }
+      apply(variant, resp);
+      if (file->encodings.size() > 0) {
+        resp.headers["content-type"] = file->content_type;
+        resp.headers["vary"] = "Accept-Encoding";
+        if (!coding.empty()) resp.headers["content-encoding"] = coding;
+      }
+      return true;
+    }; //<! fills response with file at path or its precompressed sibling req accepts, returns false if it cannot be read or path has .. segments
+
+    static void apply(const std::shared_ptr<const StaticFile>& file, Response& resp) {
+      resp.headers["content-type"] = file->content_type;
+      resp.headers["etag"] = file->etag;
+      resp.headers["last-modified"] = file->last_modified;
+      resp.headers["content-length"] = file->content_length;
+      resp.body.clear();
+      if (file->file.valid()) resp.renderer = file->file;
+      else resp.renderer = HTTPBase::SharedBufferRender(file, file->data, file->size);
+    }; //<! fills response with cached file
+
+    static bool climbs(const std::string& path) {
+      for(size_t pos = 0; pos < path.size(); pos++) {
+        if (path.compare(pos, 2, "..") == 0 && (pos + 2 == path.size() || path[pos + 2] == '/')) return true;
+        pos = path.find('/', pos);
+        if (pos == std::string::npos) break;
+      }
+      return false;
+    }; //<! whether path has .. segments
+
+    void clear() { files.clear(); }; //<! drops all files
+    size_t size() { return files.size(); }; //<! number of cached files
+    size_t weight() { return files.weight(); }; //<! memory held by cached files, see StaticFile::weight
+    unsigned long hits() const { return files.hits(); }; //<! number of lookups served from cache
+    unsigned long misses() const { return files.misses(); }; //<! number of lookups that had to load the file
+
+    long revalidate_ms; //<! how often a cached file is compared with disk, in milliseconds
+    size_t preload_limit; //<! files up to this size are read into memory, larger ones are kept open and sent from file
+    bool precompressed; //<! whether to load precompressed siblings of files
+  private:
+    BoundedCache<std::shared_ptr<const StaticFile> > files; //<! cached files by path
+  };
+};
+#endif
@@ -0,0 +1,174 @@
+/* @file
+ * @brief Concrete implementation of MultipartParser
+ */
+#include "yahttp.hpp"
+
+#include <cstring>
+
+#ifdef HAVE_CPP_FUNC_PTR
+namespace YaHTTP {
+  MultipartParser::MultipartParser(const std::string& boundary): max_header_size(8192), delimiter("\r\n--" + boundary), carry("\r\n"), state(state_preamble), header_size(0) {
+    // CRLF in carry lets the first delimiter match at the very start of body
+    size_t last = delimiter.size() - 1;
+    for(size_t i = 0; i < 256; i++) skip[i] = delimiter.size();
+    for(size_t i = 0; i < last; i++) skip[static_cast<unsigned char>(delimiter[i])] = last - i;
+  }
+
+  std::string MultipartParser::boundary(const std::string& content_type) {
+    std::string result;
+    if (!parameter(content_type, "boundary", result) || result.empty() || result.size() > 70) return "";
+    return result;
+  }
+
+  bool MultipartParser::parameter(const std::string& value, const std::string& name, std::string& result) {
+    size_t pos = value.find(';');
+    while(pos < value.size()) {
+      pos = value.find_first_not_of("; \t", pos);
+      if (pos == std::string::npos) break;
+      size_t end = value.find_first_of("=;", pos);
+      if (end == std::string::npos) end = value.size();
+      std::string key = value.substr(pos, end - pos);
+      Utility::trimRight(key);
+      std::string val;
+      pos = end;
+      if (pos < value.size() && value[pos] == '=') {
+        pos = value.find_first_not_of(" \t", pos + 1);
+        if (pos == std::string::npos) pos = value.size();
+        if (pos < value.size() && value[pos] == '"') {
+          for(pos++; pos < value.size() && value[pos] != '"'; pos++) {
+            if (value[pos] == '\\' && pos + 1 < value.size()) pos++;
+            val += value[pos];
+          }
+          pos = value.find(';', pos);
+        } else {
+          end = value.find(';', pos);
+          val = value.substr(pos, end == std::string::npos ? std::string::npos : end - pos);
+          Utility::trimRight(val);
+          pos = end;
+        }
+      }
+      if (Utility::iequals(key, name)) {
+        result = val;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void MultipartParser::feed(const char* data, size_t len) {
+    if (state == state_done) return; // epilogue
+    if (carry.empty()) {
+      size_t n = parse(data, len);
+      carry.assign(data + n, len - n);
+    } else {
+      carry.append(data, len);
+      size_t n = parse(carry.data(), carry.size());
+      carry.erase(0, n);
+    }
+    if (state == state_headers && carry.size() > max_header_size) throw ParseError("Max multipart header size exceeded");
+  }
+
+  size_t MultipartParser::parse(const char* data, size_t len) {
+    size_t pos = 0, n;
+    while(pos < len) {
+      switch(state) {
+      case state_preamble:
+        if ((n = search(data + pos, len - pos)) == std::string::npos) return pos + holdback(data + pos, len - pos);
+        pos += n + delimiter.size();
+        state = state_delimiter;
+        break;
+      case state_delimiter:
+        // transport padding may follow the boundary
+        if (data[pos] == ' ' || data[pos] == '\t') {
+          pos++;
+          break;
+        }
+        if (len - pos < 2) return pos;
+        if (data[pos] == '-' && data[pos + 1] == '-') {
+          state = state_done;
+          return len;
+        }
+        if (data[pos] != '\r' || data[pos + 1] != '\n') throw ParseError("Malformed multipart delimiter");
+        pos += 2;
+        part = MultipartPart();
+        header_size = 0;
+        state = state_headers;
+        break;
+      case state_headers: {
+        const char* eol = static_cast<const char*>(::memchr(data + pos, '\n', len - pos));
+        if (eol == NULL) return pos;
+        n = eol - (data + pos);
+        if ((header_size += n + 1) > max_header_size) throw ParseError("Max multipart header size exceeded");
+        if (n > 0 && data[pos + n - 1] == '\r') n--;
+        if (n == 0) {
+          strstr_map_t::const_iterator disposition = part.headers.find("content-disposition");
+          if (disposition == part.headers.end() || !parameter(disposition->second, "name", part.name))
+            throw ParseError("Multipart part without form field name");
+          part.file = parameter(disposition->second, "filename", part.filename);
+          strstr_map_t::const_iterator type = part.headers.find("content-type");
+          part.content_type = (type == part.headers.end() ? "text/plain" : type->second);
+          if (on_begin) on_begin(part);
+          state = state_data;
+        } else {
+          header(data + pos, n);
+        }
+        pos = eol - data + 1;
+        break;
+      }
+      case state_data:
+        if ((n = search(data + pos, len - pos)) == std::string::npos) {
+          n = holdback(data + pos, len - pos);
+          emit(data + pos, n);
+          return pos + n;
+        }
+        emit(data + pos, n);
+        if (on_end) on_end(part);
+        pos += n + delimiter.size();
+        state = state_delimiter;
+        break;
+      default:
+        return len;
+      }
+    }
+    return pos;
+  }
+
+  size_t MultipartParser::search(const char* data, size_t len) const {
+    const size_t dlen = delimiter.size(), last = dlen - 1;
+    const char* d = delimiter.data();
+    for(size_t i = 0; i + dlen <= len; i += skip[static_cast<unsigned char>(data[i + last])]) {
+      if (data[i + last] == d[last] && ::memcmp(data + i, d, last) == 0) return i;
+    }
+    return std::string::npos;
+  }
+
+  size_t MultipartParser::holdback(const char* data, size_t len) const {
+    // only a proper prefix of the delimiter can end data it was not found in
+    size_t i = (len >= delimiter.size() ? len - delimiter.size() + 1 : 0);
+    const char* cr;
+    while(i < len && (cr = static_cast<const char*>(::memchr(data + i, '\r', len - i))) != NULL) {
+      i = cr - data;
+      if (::memcmp(cr, delimiter.data(), len - i) == 0) return i;
+      i++;
+    }
+    return len;
+  }
+
+  void MultipartParser::header(const char* line, size_t len) {
+    const char* colon = static_cast<const char*>(::memchr(line, ':', len));
+    if (colon == NULL || colon == line) throw ParseError("Malformed multipart header line");
+    std::string key(line, colon - line), value(colon + 1, line + len - colon - 1);
+    for(std::string::const_iterator it = key.begin(); it != key.end(); it++)
+      if (!YaHTTP::istoken(*it)) throw ParseError("Malformed multipart header line");
+    Utility::trim(value);
+    asciiToLower(key);
+    part.headers[key] = value;
+  }
+
+  void MultipartParser::emit(const char* data, size_t len) {
+    if (len == 0) return;
+    part.size += len;
+    if (on_data) on_data(part, data, len);
+  }
+};
+#endif
@@ -0,0 +1,71 @@
+#pragma once
+/* @file
+ * @brief Defines streaming multipart/form-data parser
+ */
+#ifdef HAVE_CPP_FUNC_PTR
+#include <string>
+
+namespace YaHTTP {
+  /*! Part of multipart/form-data body, passed to MultipartParser callbacks */
+  struct MultipartPart {
+    MultipartPart(): file(false), size(0) {};
+
+    strstr_map_t headers; //<! headers of part
+    std::string name; //<! name parameter of Content-Disposition
+    std::string filename; //<! filename parameter of Content-Disposition
+    bool file; //<! whether Content-Disposition had filename parameter, even an empty one
+    std::string content_type; //<! Content-Type of part, text/plain if it has none
+    size_t size; //<! data bytes passed so far
+  };
+
+  /*! Incremental multipart/form-data parser.
+
+Data is fed in pieces of any size as it is received. The parser calls on_begin when headers of a part are complete,
+on_data with part contents as they arrive and on_end when the delimiter after the part is seen, so part contents are
+never buffered. Only the last delimiter length - 1 bytes of data are held back, in case they are the start of a
+delimiter that continues in the next piece, and part headers are limited to max_header_size bytes, so memory use
+does not depend on body size.
+
+Delimiters are found with Boyer-Moore-Horspool search, which skips up to delimiter length bytes at a time.
+Preamble and epilogue are ignored.
+  */
+  class MultipartParser {
+  public:
+    MultipartParser(const std::string& boundary); //<! constructs parser for boundary parameter of Content-Type
+
+    void feed(const char* data, size_t len); //<! parses next piece of body, throws ParseError on malformed body
+    void feed(const std::string& data) { feed(data.data(), data.size()); }; //<! parses next piece of body
+    bool done() const { return state == state_done; }; //<! whether closing delimiter has been seen
+
+    static std::string boundary(const std::string& content_type); //<! boundary parameter of Content-Type value, empty if it has no valid one
+    static bool parameter(const std::string& value, const std::string& name, std::string& result); //<! finds name=value or name="quoted value" parameter of header value
+
+    funcptr::function<void(const MultipartPart&)> on_begin; //<! called when headers of part are parsed
+    funcptr::function<void(const MultipartPart&, const char*, size_t)> on_data; //<! called with contents of part as they arrive
+    funcptr::function<void(const MultipartPart&)> on_end; //<! called when part is complete
+    size_t max_header_size; //<! maximum size of headers of one part
+
+  private:
+    enum {
+      state_preamble = 0,
+      state_delimiter,
+      state_headers,
+      state_data,
+      state_done
+    }; //<! parser states
+
+    size_t parse(const char* data, size_t len); //<! parses data, returns number of bytes consumed
+    size_t search(const char* data, size_t len) const; //<! position of delimiter in data, std::string::npos if not found
+    size_t holdback(const char* data, size_t len) const; //<! position from which data may be start of delimiter, len if none
+    void header(const char* line, size_t len); //<! adds header line to part
+    void emit(const char* data, size_t len); //<! passes part contents to on_data
+
+    std::string delimiter; //<! CRLF, two dashes and boundary
+    size_t skip[256]; //<! Horspool shift for last byte of window
+    std::string carry; //<! bytes not yet consumed from earlier pieces
+    int state; //<! parser state
+    size_t header_size; //<! header bytes of current part
+    MultipartPart part; //<! current part
+  };
+};
+#endif
@@ -1,47 +1,253 @@
 #include "yahttp.hpp"
 
+#include <atomic>
 #include <limits>
+#include <cerrno>
+#include <cstdlib>
+#include <ctime>
+#include <fcntl.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#ifdef HAVE_SYS_SENDFILE_H
+#include <sys/sendfile.h>
+#endif
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
 
 namespace YaHTTP {
 
+#ifdef HAVE_ZLIB
+  /*! Streaming inflater for gzip and zlib encoded bodies, reset and reused between documents */
+  class BodyInflater {
+  public:
+    BodyInflater(): done(false), total(0) {
+      ::memset(&zs, 0, sizeof(zs));
+      if (::inflateInit2(&zs, 47) != Z_OK) throw Error("Cannot initialize inflate"); // gzip or zlib header
+    };
+    ~BodyInflater() { ::inflateEnd(&zs); };
+
+    void reset() {
+      ::inflateReset(&zs);
+      done = false;
+      total = 0;
+    }; //<! prepares for next body
+
+    void inflate(const char* data, size_t len, std::ostream& os, size_t limit) {
+      Bytef out[16384];
+      zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+      zs.avail_in = len;
+      while(zs.avail_in > 0 && !done) {
+        zs.next_out = out;
+        zs.avail_out = sizeof(out);
+        int r = ::inflate(&zs, Z_NO_FLUSH);
+        size_t n = sizeof(out) - zs.avail_out;
+        if ((total += n) > limit) throw SizeError("Max inflated body size exceeded");
+        os.write(reinterpret_cast<const char*>(out), n);
+        if (r == Z_STREAM_END) done = true;
+        else if (r != Z_OK) throw ParseError("Invalid compressed body");
+      }
+    }; //<! inflates data into os, throws ParseError when inflated size exceeds limit or data is invalid
+
+    bool done; //<! whether end of compressed stream has been seen
+    size_t total; //<! inflated bytes so far
+  private:
+    BodyInflater(const BodyInflater&);
+    BodyInflater& operator=(const BodyInflater&);
+    z_stream zs; //<! zlib state
+  };
+#else
+  class BodyInflater {};
+#endif
+
+#ifdef HAVE_CPP_FUNC_PTR
+  /*! Loads multipart/form-data body into postvars and uploads as it arrives, and is also a stream buffer so that bodies can be inflated into it */
+  class FormDataLoader: public std::streambuf {
+  public:
+    typedef funcptr::function<void(const MultipartPart&, const char*, size_t)> upload_t; //<! receiver of file contents
+
+    FormDataLoader(const std::string& boundary, strstr_map_t& postvars_, std::vector<UploadedFile>& uploads_, size_t max_field_size_, const std::string& upload_dir_, const upload_t& upload_): parser(boundary), postvars(postvars_), uploads(uploads_), max_field_size(max_field_size_), upload_dir(upload_dir_), upload(upload_), fd(-1), os(this) {
+      parser.on_begin = [this](const MultipartPart& part) { begin(part); };
+      parser.on_data = [this](const MultipartPart& part, const char* data, size_t len) { append(part, data, len); };
+      parser.on_end = [this](const MultipartPart& part) { end(part); };
+      os.exceptions(std::ostream::badbit); // errors from parser reach the caller
+    };
+    ~FormDataLoader() { if (fd >= 0) ::close(fd); };
+
+    void feed(const char* data, size_t len) { parser.feed(data, len); }; //<! parses next piece of body
+    bool done() const { return parser.done(); }; //<! whether whole body has been parsed
+    std::ostream& stream() { return os; }; //<! stream writing to feed
+
+  protected:
+    std::streamsize xsputn(const char* data, std::streamsize len) override {
+      feed(data, len);
+      return len;
+    };
+    int_type overflow(int_type c) override {
+      if (!traits_type::eq_int_type(c, traits_type::eof())) {
+        char ch = traits_type::to_char_type(c);
+        feed(&ch, 1);
+      }
+      return traits_type::not_eof(c);
+    };
+
+  private:
+    FormDataLoader(const FormDataLoader&);
+    FormDataLoader& operator=(const FormDataLoader&);
+
+    void begin(const MultipartPart& part) {
+      field.clear();
+      if (!part.file || upload) return;
+      std::string path = upload_dir + "/yahttp-upload-XXXXXX";
+      std::vector<char> name(path.begin(), path.end());
+      name.push_back(0);
+      if ((fd = ::mkstemp(&name[0])) < 0) throw Error("Cannot create " + path + ": " + ::strerror(errno));
+      file = UploadedFile();
+      file.name = part.name;
+      file.filename = part.filename;
+      file.content_type = part.content_type;
+      file.path = &name[0];
+      file.keeper.reset(new std::string(file.path), [](std::string* p) {
+        if (!p->empty()) ::unlink(p->c_str());
+        delete p;
+      });
+    };
+
+    void append(const MultipartPart& part, const char* data, size_t len) {
+      if (!part.file) {
+        if (field.size() + len > max_field_size) throw SizeError("Max form field size exceeded");
+        field.append(data, len);
+      } else if (upload) {
+        upload(part, data, len);
+      } else {
+        while(len > 0) {
+          ssize_t n = ::write(fd, data, len);
+          if (n < 0 && errno == EINTR) continue;
+          if (n < 0) throw Error("Cannot write " + file.path + ": " + ::strerror(errno));
+          data += n;
+          len -= n;
+        }
+      }
+    };
+
+    void end(const MultipartPart& part) {
+      if (!part.file) {
+        postvars[part.name] = field;
+      } else if (upload) {
+        upload(part, NULL, 0);
+      } else {
+        ::close(fd);
+        fd = -1;
+        file.size = part.size;
+        uploads.push_back(file);
+        file = UploadedFile();
+      }
+    };
+
+    MultipartParser parser; //<! parser of body
+    strstr_map_t& postvars; //<! where fields go
+    std::vector<UploadedFile>& uploads; //<! where stored files go
+    size_t max_field_size; //<! maximum size of field
+    std::string upload_dir; //<! directory for temporary files
+    upload_t upload; //<! receiver of file contents instead of temporary files
+    std::string field; //<! contents of current field
+    UploadedFile file; //<! current stored file, removed unless it is completed
+    int fd; //<! temporary file of current stored file
+    std::ostream os; //<! stream writing to this
+  };
+
+  // only requests have uploads
+  static std::vector<UploadedFile>* uploadsOf(Request* req) { return &req->uploads; }
+  static std::vector<UploadedFile>* uploadsOf(Response*) { return NULL; }
+#else
+  class FormDataLoader {};
+#endif
+
   template class AsyncLoader<Request>;
   template class AsyncLoader<Response>;
 
-  bool isspace(char c) {
-    return std::isspace(c) != 0;
-  }
-
   bool isspace(char c, const std::locale& loc) {
     return std::isspace(c, loc);
   }
 
-  bool isxdigit(char c) {
-    return std::isxdigit(c) != 0;
-  }
-
   bool isxdigit(char c, const std::locale& loc) {
     return std::isxdigit(c, loc);
   }
 
-  bool isdigit(char c) {
-    return std::isdigit(c) != 0;
-  }
-
   bool isdigit(char c, const std::locale& loc) {
     return std::isdigit(c, loc);
   }
 
-  bool isalnum(char c) {
-    return std::isalnum(c) != 0;
-  }
-
   bool isalnum(char c, const std::locale& loc) {
     return std::isalnum(c, loc);
   }
 
+  // returns next whitespace separated token from line
+  static StringView nextToken(const std::string& line, size_t& pos) {
+    size_t start;
+    while(pos < line.size() && YaHTTP::isspace(line[pos])) pos++;
+    start = pos;
+    while(pos < line.size() && !YaHTTP::isspace(line[pos])) pos++;
+    return StringView(line.data() + start, pos - start);
+  }
+
+  template <class T>
+  void AsyncLoader<T>::startBody() {
+#ifdef HAVE_CPP_FUNC_PTR
+    std::vector<UploadedFile>* uploads = uploadsOf(target);
+    strstr_map_t::const_iterator type = target->headers.find("content-type");
+    if (parse_multipart && uploads != NULL && type != target->headers.end() && ::strncasecmp(type->second.c_str(), "multipart/form-data", 19) == 0) {
+      std::string boundary = MultipartParser::boundary(type->second);
+      FormDataLoader::upload_t handler;
+      if (boundary.empty()) throw ParseError("Missing multipart boundary");
+      if (upload) {
+        T* doc = target;
+        funcptr::function<void(T*, const MultipartPart&, const char*, size_t)> receiver = upload;
+        handler = [doc, receiver](const MultipartPart& part, const char* data, size_t len) { receiver(doc, part, data, len); };
+      }
+      formdata.reset(new FormDataLoader(boundary, target->postvars, *uploads, max_field_size, upload_dir, handler));
+    }
+#endif
+#ifdef HAVE_ZLIB
+    strstr_map_t::const_iterator encoding = target->headers.find("content-encoding");
+    if (!inflate || encoding == target->headers.end()) return;
+    if (Utility::iequals(encoding->second, "gzip") || Utility::iequals(encoding->second, "x-gzip") || Utility::iequals(encoding->second, "deflate")) {
+      if (!inflater) inflater.reset(new BodyInflater());
+      inflater->reset();
+      inflating = true;
+    }
+#endif
+  }
+
+  template <class T>
+  void AsyncLoader<T>::appendBody(const char* data, size_t len) {
+    received += len;
+#ifdef HAVE_ZLIB
+    if (inflating) {
+#ifdef HAVE_CPP_FUNC_PTR
+      if (formdata) {
+        inflater->inflate(data, len, formdata->stream(), max_inflated_size);
+        return;
+      }
+#endif
+      inflater->inflate(data, len, bodybuf, max_inflated_size);
+      return;
+    }
+#endif
+#ifdef HAVE_CPP_FUNC_PTR
+    if (formdata) {
+      formdata->feed(data, len);
+      return;
+    }
+#endif
+    bodybuf.write(data, len);
+  }
+
   template <class T>
-  bool AsyncLoader<T>::feed(const std::string& somedata) {
-    buffer.append(somedata);
+  bool AsyncLoader<T>::feed(const char* somedata, size_t len) {
+    if (stopped) return false; // rest of document is not wanted
+    buffer.append(somedata, len);
     while(state < 2) {
       int cr=0;
       pos = buffer.find_first_of("\n");
@@ -52,26 +258,37 @@ namespace YaHTTP {
       std::string line(buffer.begin(), buffer.begin()+pos-cr); // exclude CRLF
       buffer.erase(buffer.begin(), buffer.begin()+pos+1); // remove line from buffer including CRLF
 
+      if (state == 0 && line.empty()) continue; // ignore empty lines before startup line, such as after previous chunked message
       if (state == 0) { // startup line
         if (target->kind == YAHTTP_TYPE_REQUEST) {
-          std::string ver;
-          std::string tmpurl;
-          std::istringstream iss(line);
-          iss >> target->method >> tmpurl >> ver;
+          size_t lpos = 0;
+          StringView method = nextToken(line, lpos);
+          StringView tmpurl = nextToken(line, lpos);
+          StringView ver = nextToken(line, lpos).substr(0, 8);
+          URLView urlview;
           if (ver.size() == 0)
             target->version = 9;
-          else if (ver.find("HTTP/0.9") == 0)
+          else if (ver == StringView("HTTP/0.9", 8))
             target->version = 9;
-          else if (ver.find("HTTP/1.0") == 0)
+          else if (ver == StringView("HTTP/1.0", 8))
             target->version = 10;
-          else if (ver.find("HTTP/1.1") == 0)
+          else if (ver == StringView("HTTP/1.1", 8))
             target->version = 11;
           else
             throw ParseError("HTTP version not supported");
+          method.assignTo(target->method);
           // uppercase the target method
-          std::transform(target->method.begin(), target->method.end(), target->method.begin(), ::toupper);
-          target->url.parse(tmpurl);
-          target->getvars = Utility::parseUrlParameters(target->url.parameters);
+          asciiToUpper(target->method);
+          // components are copied straight from the line
+          if (urlcache != NULL) {
+            urlcache->parse(tmpurl, target->url);
+          } else {
+            urlview.parse(tmpurl);
+            urlview.toURL(target->url);
+          }
+          target->query.parse(target->url.parameters);
+          if (parse_getvars)
+            target->getvars = target->query.toMap();
           state = 1;
         } else if(target->kind == YAHTTP_TYPE_RESPONSE) {
           std::string ver;
@@ -103,6 +320,13 @@ namespace YaHTTP {
         if (line.empty()) {
           chunked = (target->headers.find("transfer-encoding") != target->headers.end() && target->headers["transfer-encoding"] == "chunked");
           state = 2;
+          startBody();
+#ifdef HAVE_CPP_FUNC_PTR
+          if (headers_complete && headers_complete(target) == false) {
+            stopped = true;
+            return false;
+          }
+#endif
           break;
         }
         // split headers
@@ -112,17 +336,18 @@ namespace YaHTTP {
         key = line.substr(0, pos1);
         value = line.substr(pos1 + 1);
         for(std::string::iterator it=key.begin(); it != key.end(); it++)
-          if (YaHTTP::isspace(*it))
-            throw ParseError("Header key contains whitespace which is not allowed by RFC");
+          if (!YaHTTP::istoken(*it))
+            throw ParseError("Header key contains characters which are not allowed by RFC");
 
         Utility::trim(value);
-        std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+        asciiToLower(key);
         // is it already defined
 
         if (key == "set-cookie" && target->kind == YAHTTP_TYPE_RESPONSE) {
           target->jar.parseSetCookieHeader(value);
         } else if (key == "cookie" && target->kind == YAHTTP_TYPE_REQUEST) {
-          target->jar.parseCookieHeader(value);
+          target->cookies.parse(value);
+          if (parse_cookies) target->COOKIES();
         } else {
           if (key == "host" && target->kind == YAHTTP_TYPE_REQUEST) {
             // maybe it contains port?
@@ -155,8 +380,8 @@ namespace YaHTTP {
         maxbody = minbody;
       }
       if (minbody < 1) return true; // guess there isn't anything left.
-      if (target->kind == YAHTTP_TYPE_REQUEST && static_cast<ssize_t>(minbody) > target->max_request_size) throw ParseError("Max request body size exceeded");
-      else if (target->kind == YAHTTP_TYPE_RESPONSE && static_cast<ssize_t>(minbody) > target->max_response_size) throw ParseError("Max response body size exceeded");
+      if (target->kind == YAHTTP_TYPE_REQUEST && static_cast<ssize_t>(minbody) > target->max_request_size) throw SizeError("Max request body size exceeded");
+      else if (target->kind == YAHTTP_TYPE_RESPONSE && static_cast<ssize_t>(minbody) > target->max_response_size) throw SizeError("Max response body size exceeded");
     }
 
     if (maxbody == 0) hasBody = false;
@@ -166,7 +391,16 @@ namespace YaHTTP {
 
     while(buffer.size() > 0) {
       if (chunked) {
-        if (chunk_size == 0) {
+        if (chunk_end) {
+          // line end after chunk data
+          if (buffer.at(0) == '\r') {
+            if (buffer.size() < 2 || buffer.at(1) != '\n') return false; // expect newline after carriage return
+            buffer.erase(0, 2);
+          } else if (buffer.at(0) == '\n') {
+            buffer.erase(0, 1);
+          } else return false;
+          chunk_end = false;
+        } else if (chunk_size == 0) {
           char buf[100];
           // read chunk length
           if ((pos = buffer.find('\n')) == std::string::npos) return false;
@@ -182,30 +416,36 @@ namespace YaHTTP {
           if (chunk_size > (std::numeric_limits<decltype(chunk_size)>::max() - 2)) {
             throw ParseError("Chunk is too large");
           }
+          // checked before chunk is read, as chunks can be of any size
+          if (static_cast<size_t>(chunk_size) > maxbody - received) {
+            if (target->kind == YAHTTP_TYPE_RESPONSE) throw SizeError("Max response body size exceeded");
+            throw SizeError("Max request body size exceeded");
+          }
         } else {
-          int crlf=1;
-          if (buffer.size() < static_cast<size_t>(chunk_size+1)) return false; // expect newline
-          if (buffer.at(chunk_size) == '\r') {
-            if (buffer.size() < static_cast<size_t>(chunk_size+2) || buffer.at(chunk_size+1) != '\n') return false; // expect newline after carriage return
-            crlf=2;
-          } else if (buffer.at(chunk_size) != '\n') return false;
-          std::string tmp = buffer.substr(0, chunk_size);
-          buffer.erase(buffer.begin(), buffer.begin()+chunk_size+crlf);
-          bodybuf << tmp;
-          chunk_size = 0;
-          if (buffer.size() == 0) break; // just in case
+          // pass on as much of chunk as has arrived
+          size_t n = std::min(buffer.size(), static_cast<size_t>(chunk_size));
+          appendBody(buffer.data(), n);
+          buffer.erase(0, n);
+          chunk_size -= n;
+          if (chunk_size == 0) chunk_end = true;
         }
       } else {
-        if (bodybuf.str().length() + buffer.length() > maxbody)
-          bodybuf << buffer.substr(0, maxbody - bodybuf.str().length());
-        else
-          bodybuf << buffer;
-        buffer = "";
+        // data after body belongs to next document
+        size_t n = std::min(buffer.length(), maxbody > received ? maxbody - received : 0);
+        appendBody(buffer.data(), n);
+        buffer.erase(0, n);
+        break;
       }
     }
 
-    if (chunk_size!=0) return false; // need more data
+    if (chunk_size != 0 || chunk_end) return false; // need more data
 
+#ifdef HAVE_ZLIB
+    if (inflating && inflater->done == false && ready()) throw ParseError("Compressed body ended prematurely");
+#endif
+#ifdef HAVE_CPP_FUNC_PTR
+    if (formdata && formdata->done() == false && ready()) throw ParseError("Multipart body ended prematurely");
+#endif
     return ready();
   };
 
@@ -235,9 +475,30 @@ namespace YaHTTP {
 
     bool cookieSent = false;
     bool sendChunked = false;
+    size_t bodyLength = 0;
+    bool hasBodyLength = false;
+    bool bodyless = (kind == YAHTTP_TYPE_RESPONSE && !Utility::statusHasBody(status));
+
+#ifdef HAVE_CPP_FUNC_PTR
+    if (headers.find("content-length") == headers.end() && !bodyless) {
+      const ZeroCopyFileRender* file = renderer.target<ZeroCopyFileRender>();
+      const SharedBufferRender* buffer = renderer.target<SharedBufferRender>();
+      const MultiRangeRender* ranges = renderer.target<MultiRangeRender>();
+      if (file != NULL && file->valid()) {
+        bodyLength = file->size();
+        hasBodyLength = true;
+      } else if (buffer != NULL) {
+        bodyLength = buffer->size;
+        hasBodyLength = true;
+      } else if (ranges != NULL) {
+        bodyLength = ranges->size();
+        hasBodyLength = true;
+      }
+    }
+#endif
 
     if (this->version > 10) { // 1.1 or better
-      if (headers.find("content-length") == headers.end() && !this->is_multipart) {
+      if (headers.find("content-length") == headers.end() && !this->is_multipart && !hasBodyLength && !bodyless) {
         // must use chunked on response
         sendChunked = (kind == YAHTTP_TYPE_RESPONSE);
         if ((headers.find("transfer-encoding") != headers.end() && headers.find("transfer-encoding")->second != "chunked")) {
@@ -251,6 +512,7 @@ namespace YaHTTP {
 	sendChunked = false;
       }
     }
+    if (hasBodyLength && version > 9) os << "Content-Length: " << bodyLength << "\r\n";
 
     // write headers
     strstr_map_t::const_iterator iter = headers.begin();
@@ -263,24 +525,26 @@ namespace YaHTTP {
       iter++;
     }
     if (version > 9 && !cookieSent && jar.cookies.size() > 0) { // write cookies
+     std::string line;
      if (kind == YAHTTP_TYPE_REQUEST) {
-        bool first = true;
-        os << "Cookie: ";
+        line = "Cookie: ";
         for(strcookie_map_t::const_iterator i = jar.cookies.begin(); i != jar.cookies.end(); i++) {
-          if (first)
-            first = false;
-          else
-            os << "; ";
-          os << Utility::encodeURL(i->second.name) << "=" << Utility::encodeURL(i->second.value);
+          if (i != jar.cookies.begin()) line.append("; ", 2);
+          i->second.appendPair(line);
         }
+        line.append("\r\n", 2);
+        os.write(line.data(), line.size());
      } else if (kind == YAHTTP_TYPE_RESPONSE) {
         for(strcookie_map_t::const_iterator i = jar.cookies.begin(); i != jar.cookies.end(); i++) {
-          os << "Set-Cookie: ";
-          os << i->second.str() << "\r\n";
+          line = "Set-Cookie: ";
+          i->second.append(line);
+          line.append("\r\n", 2);
+          os.write(line.data(), line.size());
         }
       }
     }
     os << "\r\n";
+    if (bodyless) return; // 1xx, 204 and 304 end at headers
 #ifdef HAVE_CPP_FUNC_PTR
     this->renderer(this, os, sendChunked);
 #else
@@ -289,6 +553,289 @@ namespace YaHTTP {
 #endif
   };
 
+#ifdef HAVE_CPP_FUNC_PTR
+  HTTPBase::ZeroCopyFileRender::File::~File() {
+    if (fd > -1) ::close(fd);
+  }
+
+  HTTPBase::ZeroCopyFileRender::ZeroCopyFileRender(const std::string& path_): path(path_), file(new File()), first(0), length(std::string::npos) {
+    struct stat st;
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return;
+    if (::fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+      ::close(fd);
+      return;
+    }
+    file->fd = fd;
+    file->size = st.st_size;
+    file->mtime = st.st_mtime;
+  }
+
+  size_t HTTPBase::ZeroCopyFileRender::operator()(const HTTPBase *doc __attribute__((unused)), std::ostream& os, bool chunked) const {
+    char buf[65536];
+    size_t n = 0;
+    ssize_t k;
+
+    while(valid() && n < size() && (k = ::pread(file->fd, buf, std::min(sizeof(buf), size() - n), first + n)) > 0) {
+      if (chunked) os << std::hex << k << std::dec << "\r\n";
+      os.write(buf, k);
+      if (chunked) os << "\r\n";
+      n += k;
+    }
+    if (chunked) os << 0 << "\r\n\r\n";
+    return n;
+  }
+
+  ssize_t HTTPBase::ZeroCopyFileRender::sendTo(int sock, size_t& offset, size_t count) const {
+    ssize_t n;
+    if (!valid()) {
+      errno = EBADF;
+      return -1;
+    }
+    if (offset < first || offset >= first + size()) return 0;
+    count = std::min(count, first + size() - offset);
+#ifdef HAVE_SYS_SENDFILE_H
+    off_t off = offset;
+    // sendfile sends at most about 2GB in one call
+    n = ::sendfile(sock, file->fd, &off, std::min(count, static_cast<size_t>(0x7ffff000)));
+#else
+    char buf[65536];
+    if ((n = ::pread(file->fd, buf, std::min(count, sizeof(buf)), offset)) > 0)
+      n = ::send(sock, buf, n, 0);
+#endif
+    if (n > 0) offset += n;
+    return n;
+  }
+
+  size_t HTTPBase::MultiRangeRender::operator()(const HTTPBase *doc, std::ostream& os, bool chunked) const {
+    size_t n = 0;
+    for(std::vector<Part>::const_iterator i = parts.begin(); i != parts.end(); i++) {
+      size_t length = i->text.size() + (i->file.valid() ? i->file.size() : i->buffer.size);
+      if (length == 0) continue;
+      // every part is a chunk of its own as its length is known
+      if (chunked) os << std::hex << length << std::dec << "\r\n";
+      os.write(i->text.data(), i->text.size());
+      if (i->file.valid()) i->file(doc, os, false);
+      else i->buffer(doc, os, false);
+      if (chunked) os << "\r\n";
+      n += length;
+    }
+    if (chunked) os << 0 << "\r\n\r\n";
+    return n;
+  }
+
+  // whether comma separated list of entity tags matches etag, weak comparison ignores W/ prefixes
+  static bool matchETag(const std::string& list, const std::string& etag, bool weak) {
+    size_t pos = 0;
+    while(pos < list.size()) {
+      size_t end = list.find(',', pos);
+      if (end == std::string::npos) end = list.size();
+      size_t first = list.find_first_not_of(" \t", pos);
+      size_t last = list.find_last_not_of(" \t", end - 1);
+      pos = end + 1;
+      if (first >= end || last == std::string::npos || last < first) continue;
+      std::string tag = list.substr(first, last - first + 1);
+      if (tag == "*") return weak;
+      if (etag.empty()) continue;
+      if (weak) {
+        size_t a = (tag.compare(0, 2, "W/") == 0 ? 2 : 0);
+        size_t b = (etag.compare(0, 2, "W/") == 0 ? 2 : 0);
+        if (tag.compare(a, std::string::npos, etag, b, std::string::npos) == 0) return true;
+      } else if (tag == etag && tag.compare(0, 2, "W/") != 0) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // whether Last-Modified value is later than If-Modified-Since value, unparseable dates count as modified
+  static bool modifiedSince(const std::string& since, const std::string& modified) {
+    if (since == modified) return false; // clients usually echo Last-Modified back as is
+    try {
+      DateTime a, b;
+      a.parseHttp(since);
+      b.parseHttp(modified);
+      return b.utctime() > a.utctime();
+    } catch (ParseError &) {
+      return true;
+    }
+  }
+
+  // parses decimal number at ptr, saturating at largest size_t, returns false if there are no digits
+  static bool parseRangeNumber(const char*& ptr, const char* end, size_t& value) {
+    const char* start = ptr;
+    value = 0;
+    for(; ptr < end && *ptr >= '0' && *ptr <= '9'; ptr++) {
+      size_t digit = *ptr - '0';
+      value = (value > (std::numeric_limits<size_t>::max() - digit) / 10 ? std::numeric_limits<size_t>::max() : value * 10 + digit);
+    }
+    return ptr > start;
+  }
+
+  // parses Range header into satisfiable ranges of body with size bytes, sorted and coalesced as inclusive first and last bytes.
+  // returns false if header is not a valid byte range set, or has too many ranges, and should be ignored
+  static bool parseRanges(const std::string& header, size_t size, std::vector<std::pair<size_t, size_t> >& ranges) {
+    const char* ptr = header.c_str();
+    const char* end = ptr + header.size();
+    size_t specs = 0;
+
+    if (header.size() < 6 || ::strncasecmp(ptr, "bytes=", 6) != 0) return false;
+    ptr += 6;
+    while(ptr < end) {
+      size_t first, last = std::numeric_limits<size_t>::max();
+      while(ptr < end && (*ptr == ' ' || *ptr == '\t')) ptr++;
+      if (ptr < end && *ptr == ',') {
+        ptr++;
+        continue;
+      }
+      if (ptr == end) break;
+      if (*ptr == '-') {
+        ptr++;
+        if (!parseRangeNumber(ptr, end, last)) return false;
+        // last bytes of body
+        if (last > 0 && size > 0) ranges.push_back(std::make_pair(size - std::min(last, size), size - 1));
+      } else {
+        if (!parseRangeNumber(ptr, end, first) || ptr == end || *ptr != '-') return false;
+        ptr++;
+        if (ptr < end && *ptr >= '0' && *ptr <= '9') {
+          parseRangeNumber(ptr, end, last);
+          if (last < first) return false;
+        }
+        if (first < size) ranges.push_back(std::make_pair(first, std::min(last, size - 1)));
+      }
+      if (++specs > YAHTTP_MAX_RANGES) return false;
+      while(ptr < end && (*ptr == ' ' || *ptr == '\t')) ptr++;
+      if (ptr < end && *ptr != ',') return false;
+    }
+    if (specs == 0) return false;
+
+    std::sort(ranges.begin(), ranges.end());
+    size_t n = 0;
+    for(size_t i = 1; i < ranges.size(); i++) {
+      if (ranges[i].first <= ranges[n].second + 1) ranges[n].second = std::max(ranges[n].second, ranges[i].second);
+      else ranges[++n] = ranges[i];
+    }
+    if (ranges.size() > 0) ranges.resize(n + 1);
+    return true;
+  }
+
+  void Response::applyConditional(const Request& req) {
+    static std::atomic<unsigned long> boundaries(0);
+    strstr_map_t::const_iterator cond;
+    bool notModified = false;
+
+    if (status != 200 || (req.method != "GET" && req.method != "HEAD")) return;
+    const ZeroCopyFileRender* file = renderer.target<ZeroCopyFileRender>();
+    const SharedBufferRender* buffer = renderer.target<SharedBufferRender>();
+    if (file != NULL && file->valid() == false) file = NULL;
+    if (file != NULL && file->offset() == 0 && file->size() == file->fileSize()) {
+      if (headers.find("etag") == headers.end()) headers["etag"] = Utility::makeETag(file->mtime(), file->size());
+      if (headers.find("last-modified") == headers.end()) {
+        DateTime modified;
+        modified.fromGmtime(file->mtime());
+        headers["last-modified"] = modified.http_str();
+      }
+    }
+    strstr_map_t::const_iterator etag = headers.find("etag");
+    strstr_map_t::const_iterator modified = headers.find("last-modified");
+
+    // If-None-Match overrides If-Modified-Since
+    if ((cond = req.headers.find("if-none-match")) != req.headers.end())
+      notModified = matchETag(cond->second, (etag != headers.end() ? etag->second : ""), true);
+    else if (modified != headers.end() && (cond = req.headers.find("if-modified-since")) != req.headers.end())
+      notModified = !modifiedSince(cond->second, modified->second);
+    if (notModified) {
+      status = 304;
+      headers.erase("content-length");
+      headers.erase("content-type");
+      body.clear();
+      renderer = SendBodyRender();
+      return;
+    }
+
+    if (file == NULL && buffer == NULL && renderer.target<SendBodyRender>() == NULL) return;
+    if (file != NULL || buffer != NULL) headers["accept-ranges"] = "bytes";
+    if (req.method != "GET" || (cond = req.headers.find("range")) == req.headers.end()) return;
+    strstr_map_t::const_iterator ifRange = req.headers.find("if-range");
+    if (ifRange != req.headers.end()) {
+      // ranges are only for the representation client already has part of
+      const std::string& validator = ifRange->second;
+      if (validator.compare(0, 1, "\"") == 0 || validator.compare(0, 2, "W/") == 0) {
+        if (etag == headers.end() || !matchETag(validator, etag->second, false)) return;
+      } else if (modified == headers.end() || validator != modified->second) {
+        return;
+      }
+    }
+
+    size_t size = (file != NULL ? file->size() : (buffer != NULL ? buffer->size : body.size()));
+    std::vector<std::pair<size_t, size_t> > ranges;
+    if (!parseRanges(cond->second, size, ranges)) return;
+
+    std::ostringstream tmp;
+    if (ranges.empty()) {
+      status = 416;
+      tmp << "bytes */" << size;
+      headers["content-range"] = tmp.str();
+      headers["content-length"] = "0";
+      headers.erase("content-type");
+      body.clear();
+      renderer = SendBodyRender();
+      return;
+    }
+
+    ZeroCopyFileRender wholeFile;
+    SharedBufferRender whole;
+    if (file != NULL) {
+      wholeFile = *file;
+    } else if (buffer != NULL) {
+      whole = *buffer;
+    } else {
+      // body becomes shared so that slices need no copies
+      std::shared_ptr<std::string> shared(new std::string());
+      shared->swap(body);
+      whole = SharedBufferRender(shared, shared->data(), shared->size());
+    }
+
+    status = 206;
+    if (ranges.size() == 1) {
+      size_t length = ranges[0].second - ranges[0].first + 1;
+      tmp << "bytes " << ranges[0].first << "-" << ranges[0].second << "/" << size;
+      headers["content-range"] = tmp.str();
+      if (wholeFile.valid()) renderer = wholeFile.slice(ranges[0].first, length);
+      else renderer = whole.slice(ranges[0].first, length);
+      tmp.str("");
+      tmp << length;
+    } else {
+      MultiRangeRender multi;
+      strstr_map_t::const_iterator type = headers.find("content-type");
+      tmp << "YAHTTP-" << std::hex << ::time(NULL) << "-" << boundaries++ << std::dec;
+      std::string boundary = tmp.str();
+      for(size_t i = 0; i < ranges.size(); i++) {
+        MultiRangeRender::Part part;
+        size_t length = ranges[i].second - ranges[i].first + 1;
+        tmp.str("");
+        tmp << (i > 0 ? "\r\n" : "") << "--" << boundary << "\r\n";
+        if (type != headers.end()) tmp << "Content-Type: " << type->second << "\r\n";
+        tmp << "Content-Range: bytes " << ranges[i].first << "-" << ranges[i].second << "/" << size << "\r\n\r\n";
+        part.text = tmp.str();
+        if (wholeFile.valid()) part.file = wholeFile.slice(ranges[i].first, length);
+        else part.buffer = whole.slice(ranges[i].first, length);
+        multi.parts.push_back(part);
+      }
+      MultiRangeRender::Part last;
+      last.text = "\r\n--" + boundary + "--\r\n";
+      multi.parts.push_back(last);
+      headers["content-type"] = "multipart/byteranges; boundary=" + boundary;
+      headers.erase("content-range");
+      tmp.str("");
+      tmp << multi.size();
+      renderer = multi;
+    }
+    headers["content-length"] = tmp.str();
+    body.clear();
+  }
+#endif
+
   std::ostream& operator<<(std::ostream& os, const Response &resp) {
     resp.write(os);
     return os;
@@ -1,5 +1,6 @@
 #if __cplusplus >= 201103L
 #include <functional>
+#include <memory>
 #define HAVE_CPP_FUNC_PTR
 namespace funcptr = std;
 #else
@@ -28,17 +29,27 @@ namespace funcptr = boost;
 #define YAHTTP_MAX_RESPONSE_SIZE 2097152
 #endif
 
+#ifndef YAHTTP_MAX_RANGES
+#define YAHTTP_MAX_RANGES 32
+#endif
+
 #define YAHTTP_TYPE_REQUEST 1
 #define YAHTTP_TYPE_RESPONSE 2
 
 namespace YaHTTP {
-  typedef std::map<std::string,Cookie,ASCIICINullSafeComparator> strcookie_map_t; //<! String to Cookie map
+#ifdef YAHTTP_USE_UNORDERED_MAP
+  typedef std::unordered_map<std::string,long long,ASCIICIHash,ASCIICIEqual> strint_map_t; //<! String to integer map
+#else
+  typedef std::map<std::string,long long,ASCIICINullSafeComparator> strint_map_t; //<! String to integer map
+#endif
 
   typedef enum {
     urlencoded,
     multipart
   } postformat_t; //<! Enumeration of possible post encodings, url encoding or multipart
 
+  class Request;
+
   /*! Base class for request and response */
   class HTTPBase {
   public:
@@ -94,6 +105,101 @@ namespace YaHTTP {
 
       std::string path; //<! File to send
     };
+#ifdef HAVE_CPP_FUNC_PTR
+    /*! File renderer which lets the kernel copy the file into a socket.
+
+The file is opened and measured when the renderer is constructed, check valid() before using it. HTTPBase::write sends
+Content-Length from the file size instead of chunking. Server sends the file with sendfile(2) right after the headers,
+other streams get the file contents through pread. slice() gives renderers for parts of the same open file. */
+    class ZeroCopyFileRender {
+    public:
+      ZeroCopyFileRender(): first(0), length(std::string::npos) {}; //<! construct renderer without file
+      ZeroCopyFileRender(const std::string& path_); //<! opens file at path_
+
+      size_t operator()(const HTTPBase *doc, std::ostream& os, bool chunked) const; //<! writes file to ostream and returns length
+      ssize_t sendTo(int sock, size_t& offset, size_t count) const; //<! sends at most count bytes from file offset to socket and advances offset, returns -1 and sets errno on error
+
+      ZeroCopyFileRender slice(size_t offset_, size_t length_) const {
+        ZeroCopyFileRender part(*this);
+        offset_ = std::min(offset_, size());
+        part.first = first + offset_;
+        part.length = std::min(length_, size() - offset_);
+        return part;
+      }; //<! renderer for length_ bytes starting offset_ bytes into this one
+
+      bool valid() const { return file && file->fd > -1; }; //<! whether the file could be opened
+      int fd() const { return (file ? file->fd : -1); }; //<! open file descriptor
+      size_t offset() const { return first; }; //<! file offset of first byte to send
+      size_t size() const { return (file ? (length == std::string::npos ? file->size : length) : 0); }; //<! number of bytes to send, whole file when not sliced
+      size_t fileSize() const { return (file ? file->size : 0); }; //<! size of file when it was opened
+      time_t mtime() const { return (file ? file->mtime : 0); }; //<! modification time of file when it was opened
+
+      std::string path; //<! File to send
+    private:
+      /*! Open file shared between copies of the renderer */
+      struct File {
+        File(): fd(-1), size(0), mtime(0) {};
+        ~File();
+        int fd; //<! file descriptor, -1 if file could not be opened
+        size_t size; //<! file size
+        time_t mtime; //<! modification time
+      };
+      std::shared_ptr<File> file; //<! the open file
+      size_t first; //<! file offset of first byte to send
+      size_t length; //<! number of bytes to send, npos for whole file
+    };
+
+    /*! Renderer for immutable memory shared between responses, such as cached files.
+
+The memory is kept alive by owner for as long as any copy of the renderer exists. HTTPBase::write sends Content-Length
+from size and Server sends the memory to the socket without copying it. */
+    class SharedBufferRender {
+    public:
+      SharedBufferRender(): data(NULL), size(0) {}; //<! construct empty renderer
+      SharedBufferRender(const std::shared_ptr<const void>& owner_, const char* data_, size_t size_): owner(owner_), data(data_), size(size_) {};
+
+      size_t operator()(const HTTPBase *doc __attribute__((unused)), std::ostream& os, bool chunked) const {
+        if (chunked && size > 0) os << std::hex << size << std::dec << "\r\n";
+        os.write(data, size);
+        if (chunked) os << (size > 0 ? "\r\n" : "") << 0 << "\r\n\r\n";
+        return size;
+      }; //<! writes buffer to ostream and returns length
+
+      SharedBufferRender slice(size_t offset_, size_t length_) const {
+        offset_ = std::min(offset_, size);
+        return SharedBufferRender(owner, data + offset_, std::min(length_, size - offset_));
+      }; //<! renderer for length_ bytes starting offset_ bytes into this one
+
+      std::shared_ptr<const void> owner; //<! keeps data alive
+      const char* data; //<! first byte to send
+      size_t size; //<! number of bytes to send
+    };
+
+    /*! Renderer for multipart/byteranges bodies built from slices of a file or shared memory.
+
+Each part is its text followed by its slice, the slice is file if it is valid and buffer otherwise. Server sends the
+texts from memory and the slices without copying them, so ranges of large files cost no more than the whole file. */
+    class MultiRangeRender {
+    public:
+      /*! Text followed by slice of body */
+      struct Part {
+        std::string text; //<! part delimiter and headers
+        ZeroCopyFileRender file; //<! slice of file
+        SharedBufferRender buffer; //<! slice of memory, used if file is not valid
+      };
+
+      size_t operator()(const HTTPBase *doc, std::ostream& os, bool chunked) const; //<! writes parts to ostream and returns length
+
+      size_t size() const {
+        size_t n = 0;
+        for(std::vector<Part>::const_iterator i = parts.begin(); i != parts.end(); i++)
+          n += i->text.size() + (i->file.valid() ? i->file.size() : i->buffer.size);
+        return n;
+      }; //<! length of body
+
+      std::vector<Part> parts; //<! parts in order
+    };
+#endif
 
     HTTPBase() {
       HTTPBase::initialize();
@@ -111,9 +217,13 @@ namespace YaHTTP {
       method = "";
       statusText = "";
       jar.clear();
+      cookies.clear();
+      cookies_loaded = 0;
       headers.clear();
       parameters.clear();
+      intParameters.clear();
       getvars.clear();
+      query.clear();
       postvars.clear();
       body = "";
       routeName = "";
@@ -127,6 +237,9 @@ protected:
       this->method = rhs.method; this->headers = rhs.headers;
       this->jar = rhs.jar; this->postvars = rhs.postvars;
       this->parameters = rhs.parameters; this->getvars = rhs.getvars;
+      this->intParameters = rhs.intParameters;
+      this->query = rhs.query;
+      this->cookies = rhs.cookies; this->cookies_loaded = rhs.cookies_loaded;
       this->body = rhs.body; this->max_request_size = rhs.max_request_size;
       this->max_response_size = rhs.max_response_size; this->version = rhs.version;
 #ifdef HAVE_CPP_FUNC_PTR
@@ -140,6 +253,9 @@ protected:
       this->method = rhs.method; this->headers = rhs.headers;
       this->jar = rhs.jar; this->postvars = rhs.postvars;
       this->parameters = rhs.parameters; this->getvars = rhs.getvars;
+      this->intParameters = rhs.intParameters;
+      this->query = rhs.query;
+      this->cookies = rhs.cookies; this->cookies_loaded = rhs.cookies_loaded;
       this->body = rhs.body; this->max_request_size = rhs.max_request_size;
       this->max_response_size = rhs.max_response_size; this->version = rhs.version;
 #ifdef HAVE_CPP_FUNC_PTR
@@ -157,10 +273,14 @@ public:
     std::string method; //<! http verb
     strstr_map_t headers; //<! map of header(s)
     CookieJar jar; //<! cookies 
+    CookieList cookies; //<! request cookies as received, decodes on demand
+    size_t cookies_loaded; //<! number of cookies already added into jar
     strstr_map_t postvars; //<! map of POST variables (from POST body)
     strstr_map_t getvars; //<! map of GET variables (from URL)
+    ParameterList query; //<! GET variables in URL order, keeps repeated keys and decodes on demand
 // these two are for Router
     strstr_map_t parameters; //<! map of route parameters (only if you use YaHTTP::Router)
+    strint_map_t intParameters; //<! map of converted int and hex route parameters (only if you use YaHTTP::Router)
     std::string routeName; //<! name of the current route (only if you use YaHTTP::Router)
 
     std::string body; //<! the actual content
@@ -175,7 +295,19 @@ public:
 
     strstr_map_t& GET() { return getvars; }; //<! acccessor for getvars
     strstr_map_t& POST() { return postvars; }; //<! accessor for postvars
-    strcookie_map_t& COOKIES() { return jar.cookies; }; //<! accessor for cookies
+    strcookie_map_t& COOKIES() {
+      if (cookies_loaded < cookies.size()) {
+        cookies.load(jar, cookies_loaded);
+        cookies_loaded = cookies.size();
+      }
+      return jar.cookies;
+    }; //<! accessor for cookies, adds cookies not yet in jar
+
+    long long intParameter(const std::string& name) const {
+      strint_map_t::const_iterator i = intParameters.find(name);
+      if (i == intParameters.end()) throw YaHTTP::Error("No such integer parameter: " + name);
+      return i->second;
+    }; //<! accessor for typed int and hex route parameters
 
     std::string versionStr(int version_) const {
       switch(version_) {
@@ -216,12 +348,48 @@ public:
       this->url = rhs.url;
       this->method = rhs.method;
       this->jar = rhs.jar;
+      rhs.cookies.load(this->jar, rhs.cookies_loaded);
       this->version = rhs.version;
     }
+#ifdef HAVE_CPP_FUNC_PTR
+    /*! Evaluates conditional and range headers of req against this response.
+
+Only 200 responses to GET and HEAD are considered. If-None-Match is compared with ETag and If-Modified-Since with
+Last-Modified, a match turns the response into 304 without rendering the body. Range is honoured for GET when If-Range,
+if any, still matches. Bodies of ZeroCopyFileRender, SharedBufferRender and body turn into 206 with a single slice or
+with multipart/byteranges of slices, or into 416 when no range can be satisfied. Files get ETag and Last-Modified
+unless they are already set. */
+    void applyConditional(const Request& req);
+#endif
     friend std::ostream& operator<<(std::ostream& os, const Response &resp);
     friend std::istream& operator>>(std::istream& is, Response &resp);
   };
 
+  /*! File part of multipart/form-data request body stored in a temporary file by AsyncLoader.
+
+The temporary file is removed when the last copy of it is destroyed, which is usually when the request is initialized
+for the next one. Call keep to move it where it should stay, or release to leave it at path. */
+  struct UploadedFile {
+    UploadedFile(): size(0) {};
+
+    bool keep(const std::string& dest) {
+      if (!keeper || keeper->empty() || ::rename(keeper->c_str(), dest.c_str()) < 0) return false;
+      keeper->clear();
+      path = dest;
+      return true;
+    }; //<! renames temporary file to dest, which must be on the same filesystem as upload_dir, and stops it from being removed, returns false and sets errno if it cannot be renamed
+    void release() {
+      if (keeper) keeper->clear();
+    }; //<! stops temporary file from being removed, so that it stays at path
+
+    std::string name; //<! form field name
+    std::string filename; //<! file name given by client, do not use it as a path as is
+    std::string content_type; //<! Content-Type given by client
+    std::string path; //<! file with contents, temporary until keep or release is called
+    size_t size; //<! size of contents
+    std::shared_ptr<std::string> keeper; //<! temporary file removed when last copy is destroyed, empty once it has been kept or released
+  };
+
   /* Request class, represents a HTTP Request document */
   class Request: public HTTPBase {
   public:
@@ -237,21 +405,24 @@ public:
     void initialize() override {
       HTTPBase::initialize();
       this->kind = YAHTTP_TYPE_REQUEST;
+      uploads.clear();
     }
     void initialize(const HTTPBase& rhs) {
       HTTPBase::initialize();
       this->kind = YAHTTP_TYPE_REQUEST;
+      uploads.clear();
       // copy SOME attributes
       this->url = rhs.url;
       this->method = rhs.method;
       this->jar = rhs.jar;
+      rhs.cookies.load(this->jar, rhs.cookies_loaded);
       this->version = rhs.version;
     }
     void setup(const std::string& method_, const std::string& url_) {
       this->url.parse(url_);
       this->headers["host"] = this->url.host.find(":") == std::string::npos ? this->url.host : "[" + this->url.host + "]";
       this->method = method_;
-      std::transform(this->method.begin(), this->method.end(), this->method.begin(), ::toupper);
+      asciiToUpper(this->method);
       this->headers["user-agent"] = "YaHTTP v1.0";
     }; //<! Set some initial things for a request
 
@@ -286,11 +457,29 @@ public:
         headers["content-length"] = postbuf.str();
     }; //<! convert all postvars into string and stuff it into body
 
+    std::vector<UploadedFile> uploads; //<! files of multipart/form-data body, filled by AsyncLoader with parse_multipart
+
     friend std::ostream& operator<<(std::ostream& os, const Request &resp);
     friend std::istream& operator>>(std::istream& is, Request &resp);
   };
 
-  /*! Asynchronous HTTP document loader */
+  class BodyInflater;
+  class FormDataLoader;
+  struct MultipartPart;
+
+  /*! Asynchronous HTTP document loader.
+
+Data can be fed in pieces of any size. Chunks of chunked bodies are passed on as their data arrives, so a large
+chunk is not buffered whole. With inflate set, bodies with gzip or deflate Content-Encoding are inflated
+as they arrive, also when they are chunked, so the compressed body is never kept whole. The inflated body may be at
+most max_inflated_size bytes, ParseError is thrown when it grows larger or when it is not valid compressed data.
+Content-Encoding is removed from inflated documents and Content-Length updated to the inflated size.
+
+With parse_multipart set, multipart/form-data request bodies are parsed with MultipartParser as they arrive instead
+of being collected into body. Fields without filename go to postvars and may be at most max_field_size bytes. File
+parts are passed to upload when it is set, otherwise they are written to temporary files in upload_dir and listed
+in Request::uploads. Only the part being parsed is in memory, so the size of uploads is limited by max_request_size
+alone. */
   template <class T>
   class AsyncLoader {
   public:
@@ -300,31 +489,67 @@ public:
     
     std::string buffer; //<! read buffer 
     bool chunked; //<! whether we are parsing chunked data
-    int chunk_size; //<! expected size of next chunk
+    int chunk_size; //<! bytes of current chunk not yet read
+    bool chunk_end; //<! whether current chunk was read and line end after it is expected
     std::ostringstream bodybuf; //<! buffer for body
     size_t maxbody; //<! maximum size of body
     size_t minbody; //<! minimum size of body
     bool hasBody; //<! are we expecting body
+    size_t received; //<! body bytes received, before inflating
+    URLCache* urlcache; //<! optional cache for request targets, not owned and kept over initialize
+    bool inflate; //<! whether to inflate gzip and deflate encoded bodies, kept over initialize
+    bool parse_cookies; //<! whether to populate jar while parsing, if false it is populated on first COOKIES() call, kept over initialize
+    bool parse_getvars; //<! whether to populate getvars while parsing, set false if query is enough, kept over initialize
+    size_t max_inflated_size; //<! maximum size of inflated body, kept over initialize
+    bool inflating; //<! whether current body is being inflated
+    std::shared_ptr<BodyInflater> inflater; //<! decompressor, kept over initialize for reuse
+    bool stopped; //<! headers_complete returned false, nothing more is loaded
+    bool parse_multipart; //<! whether to parse multipart/form-data request bodies into postvars and uploads, kept over initialize
+    size_t max_field_size; //<! maximum size of multipart/form-data field without filename, kept over initialize
+    std::string upload_dir; //<! directory for temporary files of uploads, kept over initialize
+    std::shared_ptr<FormDataLoader> formdata; //<! multipart/form-data state of current body
+#ifdef HAVE_CPP_FUNC_PTR
+    funcptr::function<bool(T*)> headers_complete; //<! called once headers are parsed and before body is loaded, returning false stops loading, kept over initialize
+    funcptr::function<void(T*, const MultipartPart&, const char*, size_t)> upload; //<! receives contents of file parts instead of temporary files, NULL data ends part, kept over initialize
+#endif
+
+    AsyncLoader(): urlcache(NULL), inflate(false), parse_cookies(true), parse_getvars(true), max_inflated_size(YAHTTP_MAX_REQUEST_SIZE), stopped(false), parse_multipart(false), max_field_size(65536), upload_dir("/tmp") {}; //<! construct loader without url cache
 
     void keyValuePair(const std::string &keyvalue, std::string &key, std::string &value); //<! key value pair parser helper
 
     void initialize(T* target_) {
-      chunked = false; chunk_size = 0;
+      chunked = false; chunk_size = 0; chunk_end = false;
       bodybuf.str(""); minbody = 0; maxbody = 0;
       pos = 0; state = 0; this->target = target_;
       hasBody = false;
+      received = 0;
+      inflating = false;
+      stopped = false;
+      formdata.reset();
       buffer = "";
       this->target->initialize();
     }; //<! Initialize the parser for target and clear state
-    bool feed(const std::string& somedata); //<! Feed data to the parser
+    void initializeNext(T* target_) {
+      std::string rest;
+      rest.swap(buffer);
+      initialize(target_);
+      buffer.swap(rest);
+    }; //<! Initialize the parser for next document on the same stream, keeping data that was fed but not yet parsed
+    bool pending() const { return buffer.empty() == false; }; //<! whether there is unparsed data, such as a pipelined request
+    bool headersReady() const { return state > 1; }; //<! whether all headers have been parsed, body may still be coming
+    bool feed(const char* somedata, size_t len); //<! Feed data to the parser
+    bool feed(const std::string& somedata) { return feed(somedata.data(), somedata.size()); }; //<! Feed data to the parser
+    void startBody(); //<! prepares for body once headers are parsed
+    void appendBody(const char* data, size_t len); //<! adds received body data, inflating it if needed
     bool ready() {
-     return (chunked == true && state == 3) || // if it's chunked we get end of data indication
+     return stopped == false && (
+             (chunked == true && state == 3) || // if it's chunked we get end of data indication
              (chunked == false && state > 1 &&  
                (!hasBody || 
-                 (bodybuf.str().size() <= maxbody && 
-                  bodybuf.str().size() >= minbody)
+                 (received <= maxbody && 
+                  received >= minbody)
                )
-             ); 
+             )); 
     }; //<! whether we have received enough data
     void finalize() {
       bodybuf.flush();
@@ -334,8 +559,17 @@ public:
           target->postvars = Utility::parseUrlParameters(bodybuf.str());
         }
         target->body = bodybuf.str();
+        if (inflating) {
+          target->headers.erase("content-encoding");
+          if (target->headers.find("content-length") != target->headers.end()) {
+            std::ostringstream len;
+            len << target->body.size();
+            target->headers["content-length"] = len.str();
+          }
+        }
       }
       bodybuf.str("");
+      formdata.reset();
       this->target = NULL;
     }; //<! finalize and release target
   };
@@ -4,95 +4,258 @@
 #include "yahttp.hpp"
 #include "router.hpp"
 
-namespace YaHTTP {
-  typedef funcptr::tuple<int,int> TDelim;
+#include <limits>
 
+namespace YaHTTP {
   // router is defined here.
   YaHTTP::Router Router::router;
 
+  // splits parameter specification name:type into name and type
+  static bool parseParameterSpec(const std::string& spec, std::string& name, paramtype_t& type) {
+    std::string::size_type colon = spec.find(':');
+    type = param_string;
+    if (colon == std::string::npos) {
+      name = spec;
+      return true;
+    }
+    name = spec.substr(0, colon);
+    std::string tname = spec.substr(colon+1);
+    if (tname == "int") type = param_int;
+    else if (tname == "hex") type = param_hex;
+    else if (tname == "uuid") type = param_uuid;
+    else if (tname == "slug") type = param_slug;
+    else if (tname != "string") return false;
+    return true;
+  }
+
+  static int hexValue(char c) {
+    unsigned char v = HEXVALUE[static_cast<unsigned char>(c)];
+    return v == 0xff ? -1 : v;
+  }
+
+  bool Router::matchParameter(paramtype_t type, const std::string& path, size_t& k2, char delim, long long& number) {
+    const unsigned long long limit = static_cast<unsigned long long>(std::numeric_limits<long long>::max());
+    unsigned long long value = 0;
+    size_t start;
+    bool negative = false;
+    int d;
+
+    switch(type) {
+    case param_int:
+      if (k2 < path.size() && path[k2] == '-') { negative = true; k2++; }
+      start = k2;
+      for(; k2 < path.size() && YaHTTP::isdigit(path[k2]); k2++) {
+        d = path[k2] - '0';
+        if (value > (limit + (negative ? 1 : 0) - d) / 10) return false; // overflow
+        value = value * 10 + d;
+      }
+      if (k2 == start) return false;
+      number = negative ? static_cast<long long>(0 - value) : static_cast<long long>(value);
+      return true;
+    case param_hex:
+      start = k2;
+      for(; k2 < path.size() && (d = hexValue(path[k2])) > -1; k2++) {
+        if (value > (limit - d) / 16) return false; // overflow
+        value = value * 16 + d;
+      }
+      if (k2 == start) return false;
+      number = static_cast<long long>(value);
+      return true;
+    case param_uuid:
+      if (path.size() - k2 < 36) return false;
+      for(start = k2; k2 < start + 36; k2++) {
+        if (k2 - start == 8 || k2 - start == 13 || k2 - start == 18 || k2 - start == 23) {
+          if (path[k2] != '-') return false;
+        } else if (hexValue(path[k2]) < 0) return false;
+      }
+      return true;
+    case param_slug:
+      start = k2;
+      while(k2 < path.size() && path[k2] != delim &&
+            (YaHTTP::isalnum(path[k2]) || path[k2] == '-' || path[k2] == '_')) k2++;
+      return k2 > start;
+    default:
+      return false;
+    }
+  }
+
   void Router::map(const std::string& method, const std::string& url, THandlerFunction handler, const std::string& name) {
     std::string method2 = method;
+    std::string::const_iterator open;
     bool isopen=false;
     // add into vector
     for(std::string::const_iterator i = url.begin(); i != url.end(); i++) {
        if (*i == '<' && isopen) throw Error("Invalid URL mask, cannot have < after <");
-       if (*i == '<') isopen = true;
+       if (*i == '<') { isopen = true; open = i; }
        if (*i == '>' && !isopen) throw Error("Invalid URL mask, cannot have > without < first");
-       if (*i == '>') isopen = false;
+       if (*i == '>') {
+         std::string pname;
+         paramtype_t ptype;
+         isopen = false;
+         if (parseParameterSpec(std::string(open+1, i), pname, ptype) == false)
+           throw Error("Invalid URL mask, unknown parameter type");
+         if (ptype != param_string && pname.size() > 0 && pname[0] == '*')
+           throw Error("Invalid URL mask, glob parameter cannot have type");
+       }
     }
-    std::transform(method2.begin(), method2.end(), method2.begin(), ::toupper); 
+    if (isopen) throw Error("Invalid URL mask, missing > after <");
+    asciiToUpper(method2);
     routes.push_back(funcptr::make_tuple(method2, url, handler, name));
+    generation++;
   };
 
-  bool Router::route(Request *req, THandlerFunction& handler) {
-    std::map<std::string, TDelim> params;
-    int pos1,pos2;
-    bool matched = false;
-    std::string rname;
-
-    // iterate routes
-    for(TRouteList::iterator i = routes.begin(); !matched && i != routes.end(); i++) {
-      int k1,k2,k3;
-      std::string pname;
-      std::string method, url;
-      funcptr::tie(method, url, handler, rname) = *i;
-    
-      if (method.empty() == false && req->method != method) continue; // no match on method
-      // see if we can't match the url
-      params.clear();
-      // simple matcher func
-      for(k1=0, k2=0; k1 < static_cast<int>(url.size()) && k2 < static_cast<int>(req->url.path.size()); ) {
-        if (url[k1] == '<') {
-          pos1 = k2;
-          k3 = k1+1;
-          // start of parameter
-          while(k1 < static_cast<int>(url.size()) && url[k1] != '>') k1++;
-          pname = std::string(url.begin()+k3, url.begin()+k1);
-          // then we also look it on the url
-          if (pname[0]=='*') {
-            pname = pname.substr(1);
-            // this matches whatever comes after it, basically end of string
-            pos2 = req->url.path.size();
-            matched = true;
-            if (pname != "") 
-              params[pname] = funcptr::tie(pos1,pos2);
-            k1 = url.size();
-            k2 = req->url.path.size();
-            break;
-          } else { 
-            // match until url[k1]
-            while(k2 < static_cast<int>(req->url.path.size()) && req->url.path[k2] != url[k1+1]) k2++;
-            pos2 = k2;
-            params[pname] = funcptr::tie(pos1,pos2);
-          }
-          k2--;
-        }
-        else if (url[k1] != req->url.path[k2]) {
+  bool Router::match(const char* mask, size_t masklen, const std::string& path, TRouteParameterList& params) {
+    size_t k1,k2,k3;
+    TRouteParameter param;
+
+    params.clear();
+    // simple matcher func
+    for(k1=0, k2=0; k1 < masklen && k2 < path.size(); ) {
+      if (mask[k1] == '<') {
+        k3 = k1+1;
+        // start of parameter
+        while(k1 < masklen && mask[k1] != '>') k1++;
+        param.pos = k2;
+        param.number = 0;
+        // then we also look it on the url
+        if (k3 < masklen && mask[k3]=='*') {
+          // this matches whatever comes after it, basically end of string
+          param.name = std::string(mask + k3 + 1, k1 - k3 - 1);
+          param.type = param_string;
+          param.len = path.size() - k2;
+          if (param.name != "")
+            params.push_back(param);
+          k1 = masklen;
+          k2 = path.size();
           break;
         }
-
+        parseParameterSpec(std::string(mask + k3, k1 - k3), param.name, param.type);
+        // delimiter is whatever follows the parameter in mask
+        char delim = (k1+1 < masklen ? mask[k1+1] : '\0');
+        if (param.type == param_string) {
+          // match until delimiter
+          while(k2 < path.size() && path[k2] != delim) k2++;
+        } else if (matchParameter(param.type, path, k2, delim, param.number) == false) {
+          return false;
+        }
+        param.len = k2 - param.pos;
+        params.push_back(param);
+        k1++;
+      }
+      else if (mask[k1] != path[k2]) {
+        return false;
+      } else {
         k1++; k2++;
       }
+    }
+
+    // ensure we consumed both
+    return k1 == masklen && k2 == path.size();
+  };
+
+  void Router::setParameters(Request *req, const TRouteParameterList& params) {
+    req->parameters.clear();
+    req->intParameters.clear();
+
+    for(TRouteParameterList::const_iterator p = params.begin(); p != params.end(); p++) {
+      std::string value(req->url.path, p->pos, p->len);
+      if (p->type == param_string)
+        value = Utility::decodeURL(value);
+      req->parameters[p->name] = value;
+      if (p->type == param_int || p->type == param_hex)
+        req->intParameters[p->name] = p->number;
+    }
+  };
+
+  /*! Route cache of routing thread, its counters are handed to router when thread exits */
+  struct Router::ThreadCache {
+    ThreadCache(): owner(NULL), epoch(0) {};
+    ~ThreadCache() {
+      if (!cache) return;
+      std::lock_guard<std::mutex> guard(owner->thread_caches_lock);
+      if (epoch != owner->thread_cache_epoch) return; // counters were reset since
+      owner->thread_cache_hits += cache->hits();
+      owner->thread_cache_misses += cache->misses();
+      owner->thread_caches.erase(std::find(owner->thread_caches.begin(), owner->thread_caches.end(), cache));
+    };
+
+    Router* owner; //<! router cache was made for
+    std::shared_ptr<TRouteCache> cache; //<! the cache, also listed in thread_caches of owner
+    unsigned long epoch; //<! thread_cache_epoch of owner when cache was made
+  };
 
-      // ensure.
-      if (url[k1] != req->url.path[k2]) 
-        matched = false;
-      else
-        matched = true;
+  TRouteCache* Router::threadCache(size_t capacity) {
+    static thread_local ThreadCache local;
+    if (!local.cache || local.owner != this || local.epoch != thread_cache_epoch) {
+      // single shard, only this thread uses it
+      std::lock_guard<std::mutex> guard(thread_caches_lock);
+      size_t current = thread_cache_capacity; // may have changed since caller read it
+      std::shared_ptr<TRouteCache> cache(new TRouteCache(current > 0 ? current : capacity, 1));
+      thread_caches.push_back(cache);
+      local.owner = this;
+      local.cache = cache;
+      local.epoch = thread_cache_epoch;
     }
+    return local.cache.get();
+  }
 
-    if (!matched) { return false; } // no route
-    req->parameters.clear();    
+  void Router::enableThreadCache(size_t capacity) {
+    std::lock_guard<std::mutex> guard(thread_caches_lock);
+    thread_caches.clear();
+    thread_cache_hits = 0;
+    thread_cache_misses = 0;
+    thread_cache_epoch++;
+    thread_cache_capacity = capacity;
+  }
 
-    for(std::map<std::string, TDelim>::iterator i = params.begin(); i != params.end(); i++) {
-      int p1,p2;
-      funcptr::tie(p1,p2) = i->second;
-      std::string value(req->url.path.begin() + p1, req->url.path.begin() + p2);
-      value = Utility::decodeURL(value);
-      req->parameters[i->first] = value;
+  unsigned long Router::cacheHits() {
+    unsigned long n = (cache ? cache->hits() : 0);
+    std::lock_guard<std::mutex> guard(thread_caches_lock);
+    n += thread_cache_hits;
+    for(size_t i = 0; i < thread_caches.size(); i++) n += thread_caches[i]->hits();
+    return n;
+  }
+
+  unsigned long Router::cacheMisses() {
+    unsigned long n = (cache ? cache->misses() : 0);
+    std::lock_guard<std::mutex> guard(thread_caches_lock);
+    n += thread_cache_misses;
+    for(size_t i = 0; i < thread_caches.size(); i++) n += thread_caches[i]->misses();
+    return n;
+  }
+
+  bool Router::route(Request *req, THandlerFunction& handler) {
+    TRouteCacheEntry entry;
+    std::string key;
+    bool found = false;
+    TRouteCache* cache = this->cache.get();
+    size_t capacity = thread_cache_capacity;
+
+    if (capacity > 0) cache = threadCache(capacity);
+
+    if (cache) {
+      key = req->method + " " + req->url.path;
+      found = cache->get(key, entry, [this](const TRouteCacheEntry& e) { return e.generation == generation && e.route < routes.size(); });
+    }
+
+    if (!found) {
+      TRouteList::const_iterator i;
+      entry.generation = generation;
+      // iterate routes
+      for(i = routes.begin(); i != routes.end(); i++) {
+        const std::string& method = funcptr::get<0>(*i);
+        if (method.empty() == false && req->method != method) continue; // no match on method
+        // see if we can't match the url
+        if (match(funcptr::get<1>(*i), req->url.path, entry.params)) break;
+      }
+      if (i == routes.end()) { return false; } // no route
+      entry.route = i - routes.begin();
+      if (cache) cache->put(key, entry);
     }
 
-    req->routeName = rname;
+    setParameters(req, entry.params);
+    handler = funcptr::get<2>(routes[entry.route]);
+    req->routeName = funcptr::get<3>(routes[entry.route]);
 
     return true;
   };
@@ -144,6 +307,8 @@ namespace YaHTTP {
           pname = std::string(mask.begin() + k2 + 2, mask.begin() + k1);
         else 
           pname = std::string(mask.begin() + k2 + 1, mask.begin() + k1);
+        if (pname.find(':') != std::string::npos)
+          pname.resize(pname.find(':')); // strip type
         if ((pptr = arguments.find(pname)) != arguments.end()) 
           path << Utility::encodeURL(pptr->second);
         k3 = k1+1;
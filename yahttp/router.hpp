@@ -23,12 +23,41 @@ namespace funcptr = boost;
 #ifdef HAVE_CPP_FUNC_PTR
 #include <vector>
 #include <utility>
+#include <memory>
+
+#include "cache.hpp"
 
 namespace YaHTTP {
   typedef funcptr::function <void(Request* req, Response* resp)> THandlerFunction; //!< Handler function pointer 
   typedef funcptr::tuple<std::string, std::string, THandlerFunction, std::string> TRoute; //!< Route tuple (method, urlmask, handler, name)
   typedef std::vector<TRoute> TRouteList; //!< List of routes in order of evaluation
 
+  typedef enum {
+    param_string, //<! anything up to the next delimiter, URL decoded (default)
+    param_int, //<! signed decimal integer
+    param_hex, //<! hexadecimal integer
+    param_uuid, //<! UUID in 8-4-4-4-12 hex format
+    param_slug //<! letters, digits, dash and underscore
+  } paramtype_t; //<! Type of a route parameter, declared in URL mask as &lt;name:type&gt;
+
+  /*! Route parameter located by the matcher */
+  struct TRouteParameter {
+    std::string name; //<! parameter name
+    paramtype_t type; //<! parameter type
+    size_t pos; //<! offset into path
+    size_t len; //<! length in path
+    long long number; //<! converted value for param_int and param_hex
+  };
+  typedef std::vector<TRouteParameter> TRouteParameterList; //!< Parameters of a matched route
+
+  /*! Cached routing result for (method, path) */
+  struct TRouteCacheEntry {
+    size_t route; //<! index into route list
+    unsigned long generation; //<! route list generation this entry was made for
+    TRouteParameterList params; //<! parameters located by matcher
+  };
+  typedef BoundedCache<TRouteCacheEntry> TRouteCache; //!< Route match cache
+
   /*! Implements simple router.
 
 This class implements a router for masked urls. The URL mask syntax is as of follows
@@ -37,15 +66,46 @@ This class implements a router for masked urls. The URL mask syntax is as of fol
 
 You can use &lt;*param&gt; to denote that everything will be matched and consumed into the parameter, including slash (/). Use &lt;*&gt; to denote that URL 
 is consumed but not stored. Note that only path is matched, scheme, host and url parameters are ignored. 
+
+Optionally, routing results can be cached with EnableCache. The cache is invalidated whenever routes are added with map or removed with Clear,
+do not modify routes directly when cache is enabled. Enable or disable the cache before routing from multiple threads.
+
+With EnableThreadCache every thread gets its own route cache instead, so threads serving requests do not share cache locks.
+The thread cache is used in place of the shared one when both are enabled. CacheHits and CacheMisses count lookups in the
+shared cache and in the caches of all threads, also of threads that have exited, since thread caches were last enabled
+or disabled.
+
+Parameters can be typed with &lt;param:type&gt;, where type is one of int, hex, uuid or slug. Typed parameters are validated while matching, 
+so /obj/&lt;id:int&gt; and /obj/&lt;name&gt; can be told apart, and int and hex values are converted into Request::intParameters.
    */
   class Router {
   private:
-    Router() {}; 
+    Router(): generation(0), thread_cache_capacity(0), thread_cache_epoch(0), thread_cache_hits(0), thread_cache_misses(0) {}; 
     static Router router; //<! Singleton instance of Router
+    std::unique_ptr<TRouteCache> cache; //<! route match cache, if enabled
+    std::atomic<unsigned long> generation; //<! incremented whenever routes change
+    std::atomic<size_t> thread_cache_capacity; //<! capacity of per-thread route caches, 0 if disabled
+    struct ThreadCache; //<! route cache of routing thread, defined in router.cpp
+    TRouteCache* threadCache(size_t capacity); //<! route cache of calling thread
+    std::mutex thread_caches_lock; //<! protects thread_caches, thread_cache_epoch and counters of exited threads
+    std::vector<std::shared_ptr<TRouteCache> > thread_caches; //<! route caches of threads, kept for their counters
+    std::atomic<unsigned long> thread_cache_epoch; //<! incremented whenever thread caches are enabled or disabled, older thread caches are replaced
+    unsigned long thread_cache_hits; //<! hits of caches of threads that have exited
+    unsigned long thread_cache_misses; //<! misses of caches of threads that have exited
   public:
     void map(const std::string& method, const std::string& url, THandlerFunction handler, const std::string& name); //<! Instance method for mapping urls
     bool route(Request *req, THandlerFunction& handler); //<! Instance method for performing routing
+    void clear() { routes.clear(); generation++; } //<! Instance method for clearing routes
+    void enableCache(size_t capacity) { cache.reset(new TRouteCache(capacity)); } //<! Instance method for enabling route cache
+    void disableCache() { cache.reset(); } //<! Instance method for disabling route cache
+    void enableThreadCache(size_t capacity); //<! Instance method for enabling per-thread route caches, 0 disables them, resets their counters
+    unsigned long cacheHits(); //<! Instance method for counting hits of shared and thread caches
+    unsigned long cacheMisses(); //<! Instance method for counting misses of shared and thread caches
     void printRoutes(std::ostream &os); //<! Instance method for printing routes
+    static bool match(const char* mask, size_t masklen, const std::string& path, TRouteParameterList& params); //<! Matches path against mask, collecting parameters
+    static bool match(const std::string& mask, const std::string& path, TRouteParameterList& params) { return match(mask.data(), mask.size(), path, params); } //<! Matches path against mask, collecting parameters
+    static bool matchParameter(paramtype_t type, const std::string& path, size_t& pos, char delim, long long& number); //<! Consumes typed parameter from path at pos, stopping at delim, and converts int and hex
+    static void setParameters(Request *req, const TRouteParameterList& params); //<! Stores matched parameters into request
     std::pair<std::string, std::string> urlFor(const std::string &name, const strstr_map_t& arguments); //<! Instance method for generating paths
 
 /*! Map an URL.
@@ -64,7 +124,14 @@ If method is left empty, it will match any method. Name is also optional, but ne
 
     static std::pair<std::string, std::string> URLFor(const std::string &name, const strstr_map_t& arguments) { return router.urlFor(name,arguments); }; //<! Generates url from named route and arguments. Missing arguments are assumed empty
     static const TRouteList& GetRoutes() { return router.routes; } //<! Reference to route list 
-    static void Clear() { router.routes.clear(); } //<! Clear all routes
+    static void Clear() { router.clear(); } //<! Clear all routes
+
+    static void EnableCache(size_t capacity = 1024) { router.enableCache(capacity); } //<! Cache up to capacity routing results keyed by method and path
+    static void DisableCache() { router.disableCache(); } //<! Disable and drop route cache
+    static void EnableThreadCache(size_t capacity = 1024) { router.enableThreadCache(capacity); } //<! Cache up to capacity routing results in each routing thread
+    static void DisableThreadCache() { router.enableThreadCache(0); } //<! Stop using per-thread route caches
+    static unsigned long CacheHits() { return router.cacheHits(); } //<! Number of routing cache hits, in shared and thread caches
+    static unsigned long CacheMisses() { return router.cacheMisses(); } //<! Number of routing cache misses, in shared and thread caches
 
     TRouteList routes; //<! Instance variable for routes
   };
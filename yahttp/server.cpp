@@ -0,0 +1,1212 @@
+/* @file
+ * @brief Concrete implementation of Server
+ */
+#include "yahttp.hpp"
+#include "router.hpp"
+#include "server.hpp"
+
+#if defined(HAVE_CPP_FUNC_PTR) && defined(HAVE_SYS_EPOLL_H)
+#include <cerrno>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <strings.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#ifdef HAVE_LINUX_IO_URING_H
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#ifdef IORING_ACCEPT_MULTISHOT
+#define HAVE_IO_URING
+#endif
+#endif
+
+namespace YaHTTP {
+  static std::string systemError(const std::string& what) {
+    return what + ": " + ::strerror(errno);
+  }
+
+  // whether connection can be kept open after responding to req
+  static bool keepAlive(const Request& req) {
+    strstr_map_t::const_iterator i = req.headers.find("connection");
+    std::string value;
+    if (i != req.headers.end()) {
+      value = i->second;
+      asciiToLower(value);
+    }
+    if (req.version > 10) return value.find("close") == std::string::npos;
+    if (req.version == 10) return value.find("keep-alive") != std::string::npos;
+    return false;
+  }
+
+  static const size_t file_chunk_size = 65536; // size of single read of async_files
+
+  /*! Threads reading chunks of files, completed reads are picked up by Server after it is woken through wfd */
+  struct Server::Readers {
+    /*! Read on behalf of connection */
+    struct Job {
+      int fd; //<! socket of connection
+      unsigned int generation; //<! generation of connection
+      HTTPBase::ZeroCopyFileRender file; //<! keeps file open while it is read
+      size_t offset; //<! file offset to read from
+      std::string data; //<! buffer, sized to the amount to read
+      ssize_t res; //<! result of pread
+    };
+
+    Readers(int wfd_, size_t count): wfd(wfd_), stopping(false) {
+      for(size_t i = 0; i < std::max(count, static_cast<size_t>(1)); i++)
+        threads.push_back(std::thread(&Readers::run, this));
+    };
+
+    ~Readers() {
+      {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+      }
+      wanted.notify_all();
+      for(size_t i = 0; i < threads.size(); i++) threads[i].join();
+    };
+
+    void submit(Job job) {
+      {
+        std::lock_guard<std::mutex> guard(lock);
+        queue.push_back(std::move(job));
+      }
+      wanted.notify_one();
+    };
+
+    void run() {
+      uint64_t one = 1;
+      for(;;) {
+        Job job;
+        {
+          std::unique_lock<std::mutex> guard(lock);
+          while(stopping == false && queue.empty()) wanted.wait(guard);
+          if (stopping) return;
+          job = std::move(queue.front());
+          queue.pop_front();
+        }
+        do {
+          job.res = ::pread(job.file.fd(), &job.data[0], job.data.size(), job.offset);
+        } while(job.res < 0 && errno == EINTR);
+        // next chunk is most likely wanted next, let the kernel read it meanwhile
+        if (job.res > 0) ::posix_fadvise(job.file.fd(), job.offset + job.res, job.data.size(), POSIX_FADV_WILLNEED);
+        {
+          std::lock_guard<std::mutex> guard(lock);
+          done.push_back(std::move(job));
+        }
+        if (::write(wfd, &one, sizeof(one)) < 0) {} // wakes up event loop
+      }
+    };
+
+    int wfd; //<! eventfd of server
+    bool stopping; //<! threads should return
+    std::mutex lock; //<! protects queue, done and stopping
+    std::condition_variable wanted; //<! signalled when queue gets jobs or stopping is set
+    std::deque<Job> queue; //<! reads waiting for a thread
+    std::vector<Job> done; //<! completed reads
+    std::vector<std::thread> threads; //<! reader threads
+  };
+
+  Server::Server(): lfd(-1), efd(-1), wfd(-1), stopping(false), active(0), last_sweep(0), uring_tried(false) {
+    struct epoll_event ev;
+    idle_timeout = 60;
+    max_connections = 10000;
+    max_request_size = YAHTTP_MAX_REQUEST_SIZE;
+    max_pending_output = 1048576;
+    linger_timeout = 2;
+    max_linger_size = 16777216;
+    reuse_port = false;
+    conditional = true;
+    compress = false;
+    compression_level = 6;
+    compression_min_size = 1024;
+    inflate_requests = false;
+    parse_cookies = true;
+    parse_getvars = true;
+    parse_multipart = false;
+    upload_dir = "/tmp";
+    async_files = false;
+    io_threads = 2;
+    backend = backend_epoll;
+
+    if ((efd = ::epoll_create1(EPOLL_CLOEXEC)) < 0) throw Error(systemError("epoll_create1"));
+    if ((wfd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0) {
+      ::close(efd);
+      throw Error(systemError("eventfd"));
+    }
+    ev.events = EPOLLIN;
+    ev.data.u64 = static_cast<uint64_t>(wfd);
+    ::epoll_ctl(efd, EPOLL_CTL_ADD, wfd, &ev);
+  }
+
+  Server::~Server() {
+    readers.reset(); // waits for reads in progress
+    uring.reset(); // cancels operations still in flight
+    for(size_t i = 0; i < table.size(); i++)
+      if (table[i] && table[i]->fd > -1) ::close(table[i]->fd);
+    if (lfd > -1) ::close(lfd);
+    ::close(wfd);
+    ::close(efd);
+  }
+
+  void Server::listen(const std::string& address, int port, int backlog) {
+    struct sockaddr_storage ss;
+    struct sockaddr_in *sin = reinterpret_cast<struct sockaddr_in*>(&ss);
+    struct sockaddr_in6 *sin6 = reinterpret_cast<struct sockaddr_in6*>(&ss);
+    struct epoll_event ev;
+    socklen_t sslen;
+    int val = 1;
+
+    if (lfd > -1) throw Error("Server is already listening");
+    ::memset(&ss, 0, sizeof(ss));
+    if (::inet_pton(AF_INET, address.c_str(), &sin->sin_addr) == 1) {
+      sin->sin_family = AF_INET;
+      sin->sin_port = htons(port);
+      sslen = sizeof(*sin);
+    } else if (::inet_pton(AF_INET6, address.c_str(), &sin6->sin6_addr) == 1) {
+      sin6->sin6_family = AF_INET6;
+      sin6->sin6_port = htons(port);
+      sslen = sizeof(*sin6);
+    } else {
+      throw Error("Invalid listen address: " + address);
+    }
+
+    if ((lfd = ::socket(ss.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) < 0)
+      throw Error(systemError("socket"));
+    ::setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &val, sizeof(val));
+    if (reuse_port && ::setsockopt(lfd, SOL_SOCKET, SO_REUSEPORT, &val, sizeof(val)) < 0) {
+      std::string err = systemError("setsockopt(SO_REUSEPORT)");
+      ::close(lfd);
+      lfd = -1;
+      throw Error(err);
+    }
+    if (::bind(lfd, reinterpret_cast<struct sockaddr*>(&ss), sslen) < 0 ||
+        ::listen(lfd, backlog) < 0) {
+      std::string err = systemError("Cannot listen on " + address);
+      ::close(lfd);
+      lfd = -1;
+      throw Error(err);
+    }
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.u64 = static_cast<uint64_t>(lfd);
+    ::epoll_ctl(efd, EPOLL_CTL_ADD, lfd, &ev);
+  }
+
+  int Server::localPort() const {
+    struct sockaddr_storage ss;
+    socklen_t sslen = sizeof(ss);
+    if (lfd < 0 || ::getsockname(lfd, reinterpret_cast<struct sockaddr*>(&ss), &sslen) < 0) return 0;
+    if (ss.ss_family == AF_INET6) return ntohs(reinterpret_cast<struct sockaddr_in6*>(&ss)->sin6_port);
+    return ntohs(reinterpret_cast<struct sockaddr_in*>(&ss)->sin_port);
+  }
+
+  void Server::run() {
+    while(!stopping) runOnce(1000);
+    stopping = false;
+  }
+
+  void Server::stop() {
+    uint64_t one = 1;
+    stopping = true;
+    if (::write(wfd, &one, sizeof(one)) < 0) {} // wakes up epoll_wait
+  }
+
+  void Server::runOnce(int timeout) {
+    struct epoll_event events[256];
+    int n = 0;
+
+    if (uring_tried == false) {
+      uring_tried = true;
+      if (backend == backend_uring) setupUring();
+    }
+    if (uring) {
+      runUring(timeout);
+    } else if ((n = ::epoll_wait(efd, events, 256, timeout)) < 0 && errno != EINTR) {
+      throw Error(systemError("epoll_wait"));
+    }
+
+    for(int i = 0; i < n; i++) {
+      int fd = static_cast<int>(events[i].data.u64 & 0xffffffff);
+      unsigned int generation = static_cast<unsigned int>(events[i].data.u64 >> 32);
+      if (generation == 0) {
+        if (fd == lfd) accept();
+        else if (fd == wfd) {
+          uint64_t value;
+          if (::read(wfd, &value, sizeof(value)) < 0) {} // reset eventfd
+          if (readers) finishReads();
+        }
+        continue;
+      }
+      if (static_cast<size_t>(fd) >= table.size() || !table[fd]) continue;
+      Connection& conn = *table[fd];
+      // skip events for connections closed earlier in this batch
+      if (conn.fd < 0 || conn.generation != generation) continue;
+      if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLERR | EPOLLHUP)) onRead(conn);
+      if (conn.fd > -1 && (events[i].events & EPOLLOUT)) onWrite(conn);
+    }
+
+    time_t now = ::time(NULL);
+    if (now != last_sweep) sweep(now);
+  }
+
+  void Server::accept() {
+    struct epoll_event ev;
+    int fd, val = 1;
+
+    while((fd = ::accept4(lfd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) > -1) {
+      if (active >= max_connections) {
+        ::close(fd);
+        continue;
+      }
+      ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &val, sizeof(val));
+      Connection& conn = attach(fd);
+      ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+      ev.data.u64 = (static_cast<uint64_t>(conn.generation) << 32) | static_cast<uint64_t>(fd);
+      if (::epoll_ctl(efd, EPOLL_CTL_ADD, fd, &ev) < 0) close(conn);
+    }
+  }
+
+  Server::Connection& Server::attach(int fd) {
+    if (static_cast<size_t>(fd) >= table.size()) table.resize(fd + 1);
+    if (!table[fd]) {
+      table[fd].reset(new Connection());
+      Connection* slot = table[fd].get();
+      slot->loader.headers_complete = [this, slot](Request*) { return onHeaders(*slot); };
+    }
+    Connection& conn = *table[fd];
+    conn.fd = fd;
+    if (++conn.generation == 0) conn.generation = 1; // zero is reserved for server sockets
+    conn.out.clear();
+    conn.outpos = 0;
+    conn.bodies.clear();
+    conn.closing = false;
+    conn.paused = false;
+    conn.linger = false;
+    conn.lingering = false;
+    conn.drained = 0;
+    conn.handler = THandlerFunction();
+    conn.last = ::time(NULL);
+    conn.loader.inflate = inflate_requests;
+    conn.loader.parse_cookies = parse_cookies;
+    conn.loader.parse_getvars = parse_getvars;
+    conn.loader.parse_multipart = parse_multipart;
+    conn.loader.upload_dir = upload_dir;
+    conn.loader.max_inflated_size = max_request_size;
+    conn.loader.initialize(&conn.req);
+    conn.req.max_request_size = max_request_size;
+    active++;
+    return conn;
+  }
+
+  void Server::close(Connection& conn) {
+    if (conn.fd < 0) return;
+    if (uring) {
+      // operations in flight still refer to the socket, they complete once it is shut down
+      if (conn.shut == false) ::shutdown(conn.fd, SHUT_RDWR);
+      conn.shut = true;
+      release(conn);
+      return;
+    }
+    ::close(conn.fd); // also removes it from epoll
+    conn.fd = -1;
+    conn.out.clear();
+    conn.outpos = 0;
+    conn.bodies.clear();
+    conn.loader.formdata.reset(); // temporary files of uploads go with connection
+    conn.req.uploads.clear();
+    active--;
+  }
+
+  void Server::release(Connection& conn) {
+    if (conn.shut == false || conn.inflight > 0) return;
+    if (conn.fixed) registerSocket(conn, false);
+    ::close(conn.fd);
+    conn.fd = -1;
+    conn.shut = false;
+    conn.out.clear();
+    conn.outpos = 0;
+    conn.sending.clear();
+    conn.sendchunk.clear();
+    conn.sendbody = NULL;
+    conn.sendbodylen = 0;
+    conn.sendpos = 0;
+    conn.bodies.clear();
+    conn.loader.formdata.reset(); // temporary files of uploads go with connection
+    conn.req.uploads.clear();
+    active--;
+  }
+
+  void Server::sweep(time_t now) {
+    last_sweep = now;
+    for(size_t i = 0; i < table.size(); i++) {
+      if (!table[i] || table[i]->fd < 0 || table[i]->shut) continue;
+      // lingering does not update last, so it ends linger_timeout after it began
+      if (table[i]->lingering ? now - table[i]->last >= linger_timeout : idle_timeout > 0 && now - table[i]->last > idle_timeout) close(*table[i]);
+    }
+  }
+
+  void Server::handle(Request* req, Response* resp, THandlerFunction& handler) {
+    if (handler || Router::Route(req, handler)) {
+      handler(req, resp);
+    } else if (notFound) {
+      notFound(req, resp);
+    } else {
+      resp->status = 404;
+      resp->headers["content-type"] = "text/plain";
+      resp->body = "Not Found";
+    }
+  }
+
+  void Server::respond(Connection& conn) {
+    Request& req = conn.req;
+    Response& resp = conn.resp;
+    bool alive = keepAlive(req);
+
+    resp.initialize();
+    resp.version = (req.version > 9 ? req.version : 10);
+    resp.url = req.url;
+    resp.method = req.method;
+    resp.status = 200;
+    THandlerFunction handler;
+    handler.swap(conn.handler);
+    try {
+      handle(&req, &resp, handler);
+    } catch (...) {
+      // anything a handler throws fails only this request
+      resp.initialize();
+      resp.version = (req.version > 9 ? req.version : 10);
+      resp.url = req.url;
+      resp.method = req.method;
+      resp.status = 500;
+      resp.headers["content-type"] = "text/plain";
+      resp.body = "Internal Server Error";
+    }
+    if (conditional) resp.applyConditional(req);
+#ifdef HAVE_ZLIB
+    if (compress) Compression::apply(req, resp, compression_level, compression_min_size);
+#endif
+    if (async_files || uring) {
+      // read file in chunks off the loop instead of through ifstream while rendering
+      const HTTPBase::SendFileRender* plain = resp.renderer.target<HTTPBase::SendFileRender>();
+      if (plain != NULL) {
+        HTTPBase::ZeroCopyFileRender opened(plain->path);
+        if (opened.valid()) resp.renderer = opened;
+      }
+    }
+    queue(conn, alive);
+  }
+
+  void Server::queue(Connection& conn, bool alive) {
+    Request& req = conn.req;
+    Response& resp = conn.resp;
+    const HTTPBase::ZeroCopyFileRender* file = resp.renderer.target<HTTPBase::ZeroCopyFileRender>();
+    const HTTPBase::SharedBufferRender* buffer = resp.renderer.target<HTTPBase::SharedBufferRender>();
+    const HTTPBase::MultiRangeRender* ranges = resp.renderer.target<HTTPBase::MultiRangeRender>();
+    if (file != NULL && file->valid() == false) file = NULL;
+    if (resp.headers.find("content-length") == resp.headers.end() && Utility::statusHasBody(resp.status)) {
+      if (resp.renderer.target<HTTPBase::SendBodyRender>() != NULL || file != NULL || buffer != NULL || ranges != NULL) {
+        std::ostringstream len;
+        len << (file != NULL ? file->size() : (buffer != NULL ? buffer->size : (ranges != NULL ? ranges->size() : resp.body.size())));
+        resp.headers["content-length"] = len.str();
+      } else if (resp.version < 11) {
+        alive = false; // body ends when connection closes
+      }
+    }
+    strstr_map_t::const_iterator i = resp.headers.find("connection");
+    if (i != resp.headers.end() && i->second.find("close") != std::string::npos) alive = false;
+    if (!alive) resp.headers["connection"] = "close";
+    else if (resp.version < 11) resp.headers["connection"] = "keep-alive";
+
+    conn.stream.str("");
+    if (file != NULL || buffer != NULL || ranges != NULL) {
+      // write headers only, body is sent from files or memory after them, io_uring reads files as async_files does
+      std::vector<HTTPBase::MultiRangeRender::Part> parts(1);
+      if (ranges != NULL) parts = ranges->parts;
+      else if (file != NULL) parts[0].file = *file;
+      else parts[0].buffer = *buffer;
+      resp.renderer = HTTPBase::SendBodyRender();
+      resp.body.clear();
+      resp.write(conn.stream);
+      conn.out.append(conn.stream.str());
+      for(size_t i = 0; req.method != "HEAD" && i < parts.size(); i++) {
+        conn.out.append(parts[i].text);
+        QueuedBody body = (parts[i].file.valid() ? QueuedBody(conn.out.size(), parts[i].file, async_files || uring) : QueuedBody(conn.out.size(), parts[i].buffer));
+        if (body.remaining > 0) conn.bodies.push_back(body);
+      }
+    } else {
+      resp.write(conn.stream);
+      std::string data = conn.stream.str();
+      if (req.method == "HEAD") {
+        size_t end = data.find("\r\n\r\n");
+        if (end != std::string::npos) data.resize(end + 4);
+      }
+      conn.out.append(data);
+    }
+    conn.closing = !alive;
+  }
+
+  void Server::check(Request* req, Response* resp, THandlerFunction& handler) {
+    if (Router::Route(req, handler) == false && !notFound) {
+      resp->status = 404;
+      resp->headers["content-type"] = "text/plain";
+      resp->body = "Not Found";
+    } else if (checkHeaders) {
+      checkHeaders(req, resp);
+    }
+  }
+
+  bool Server::onHeaders(Connection& conn) {
+    Request& req = conn.req;
+    Response& resp = conn.resp;
+    strstr_map_t::const_iterator expect = req.headers.find("expect");
+    strstr_map_t::const_iterator length = req.headers.find("content-length");
+    if (req.version < 11) expect = req.headers.end(); // Expect is only for HTTP/1.1
+    if (expect == req.headers.end() && req.headers.find("transfer-encoding") == req.headers.end() &&
+        (length == req.headers.end() || length->second == "0")) return true; // no body to decide about
+
+    resp.initialize();
+    resp.version = (req.version > 9 ? req.version : 10);
+    resp.url = req.url;
+    resp.method = req.method;
+    resp.status = 0;
+    if (length != req.headers.end() && max_request_size > -1 && std::strtoll(length->second.c_str(), NULL, 10) > max_request_size) {
+      resp.status = 413;
+    } else if (expect != req.headers.end() && ::strcasecmp(expect->second.c_str(), "100-continue") != 0) {
+      resp.status = 417;
+    } else {
+      try {
+        check(&req, &resp, conn.handler);
+      } catch (...) {
+        resp.initialize();
+        resp.version = (req.version > 9 ? req.version : 10);
+        resp.url = req.url;
+        resp.method = req.method;
+        resp.status = 500;
+        resp.headers["content-type"] = "text/plain";
+        resp.body = "Internal Server Error";
+      }
+    }
+
+    if (resp.status == 0) {
+      // body which is already on its way needs no invitation
+      if (expect != req.headers.end() && conn.loader.pending() == false) conn.out.append("HTTP/1.1 100 Continue\r\n\r\n");
+      return true;
+    }
+    // answer at once and close instead of reading body nobody wants
+    conn.handler = THandlerFunction();
+    conn.linger = true;
+    queue(conn, false);
+    return false;
+  }
+
+  void Server::reject(Connection& conn, int status) {
+    std::ostringstream head;
+    head << "HTTP/1.1 " << status << " " << Utility::status2text(status) << "\r\nConnection: close\r\nContent-Length: 0\r\n\r\n";
+    conn.out.append(head.str());
+    conn.closing = true;
+    conn.linger = true;
+  }
+
+  void Server::finish(Connection& conn) {
+    if (conn.linger == false || linger_timeout < 1) {
+      close(conn);
+      return;
+    }
+    // closing with unread input resets the connection, which can throw away the answer before client reads it
+    ::shutdown(conn.fd, SHUT_WR);
+    conn.linger = false;
+    conn.lingering = true;
+    conn.last = ::time(NULL);
+    if (uring == NULL) drain(conn);
+    else if (conn.recving == false) armRecv(conn);
+  }
+
+  void Server::drain(Connection& conn) {
+    char buf[16384];
+    ssize_t n;
+    while((n = ::read(conn.fd, buf, sizeof(buf))) > 0 || (n < 0 && errno == EINTR)) {
+      if (n > 0 && (conn.drained += n) > max_linger_size) break;
+    }
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+    close(conn);
+  }
+
+  void Server::process(Connection& conn) {
+    while(conn.closing == false && conn.loader.ready()) {
+      conn.loader.finalize();
+      respond(conn);
+      if (conn.closing) break;
+      conn.loader.initializeNext(&conn.req);
+      conn.req.max_request_size = max_request_size;
+      if (conn.loader.pending() == false) break;
+      conn.loader.feed("", 0); // parse pipelined data
+    }
+  }
+
+  void Server::onRead(Connection& conn) {
+    char buf[16384];
+    ssize_t n;
+
+    if (conn.lingering) {
+      drain(conn);
+      return;
+    }
+    conn.paused = false;
+    while(conn.closing == false) {
+      if (conn.out.size() - conn.outpos > max_pending_output) {
+        conn.paused = true; // resumed from onWrite
+        break;
+      }
+      n = ::read(conn.fd, buf, sizeof(buf));
+      if (n > 0) {
+        conn.last = ::time(NULL);
+        try {
+          conn.loader.feed(buf, n);
+          process(conn);
+        } catch (SizeError& ex) {
+          reject(conn, 413);
+        } catch (ParseError& ex) {
+          reject(conn, 400);
+        }
+      } else if (n == 0) {
+        conn.closing = true; // peer is done sending
+      } else if (errno == EINTR) {
+        continue;
+      } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        break;
+      } else {
+        close(conn);
+        return;
+      }
+    }
+    onWrite(conn);
+  }
+
+  void Server::onWrite(Connection& conn) {
+    ssize_t n;
+    if (conn.lingering) return; // everything has been sent already
+    while(conn.outpos < conn.out.size() || conn.bodies.empty() == false) {
+      if (conn.bodies.empty() == false && conn.bodies.front().at == conn.outpos) {
+        QueuedBody& body = conn.bodies.front();
+        if (body.remaining == 0) {
+          conn.bodies.pop_front();
+          continue;
+        }
+        if (body.data != NULL) {
+          n = ::send(conn.fd, body.data + body.offset, body.remaining, MSG_NOSIGNAL);
+          if (n > 0) body.offset += n;
+        } else if (body.async) {
+          if (nextChunk(conn, body) == false) return; // continued once chunk has been read
+          n = ::send(conn.fd, body.chunk.data() + body.chunkpos, body.chunk.size() - body.chunkpos, MSG_NOSIGNAL);
+          if (n > 0) {
+            body.chunkpos += n;
+            body.offset += n;
+          }
+        } else {
+          n = body.file.sendTo(conn.fd, body.offset, body.remaining);
+        }
+        if (n > 0) {
+          body.remaining -= n;
+          continue;
+        } else if (n == 0) {
+          // file got shorter than announced Content-Length
+          close(conn);
+          return;
+        }
+      } else {
+        size_t end = (conn.bodies.empty() ? conn.out.size() : conn.bodies.front().at);
+        n = ::send(conn.fd, conn.out.data() + conn.outpos, end - conn.outpos, MSG_NOSIGNAL | (conn.bodies.empty() ? 0 : MSG_MORE));
+        if (n > -1) {
+          conn.outpos += n;
+          continue;
+        }
+      }
+      if (errno == EINTR) {
+        continue;
+      } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        return; // wait for EPOLLOUT
+      } else {
+        close(conn);
+        return;
+      }
+    }
+    conn.out.clear();
+    conn.outpos = 0;
+    conn.last = ::time(NULL);
+    if (conn.closing) finish(conn);
+    else if (conn.paused) onRead(conn);
+  }
+
+#ifdef HAVE_IO_URING
+  // operation is kept in top byte of user_data, socket in the low bits
+  enum {
+    uring_accept = 1,
+    uring_wake,
+    uring_provide,
+    uring_recv,
+    uring_send,
+    uring_read,
+    uring_update
+  };
+
+  static const unsigned int uring_entries = 1024; // submission queue size
+  static const unsigned int uring_buffer_count = 256; // number of receive buffers
+  static const size_t uring_buffer_size = 16384; // size of single receive buffer
+  static const unsigned int uring_max_files = 32768; // registered file table size, limited further by RLIMIT_NOFILE
+
+  static inline uint64_t uringTag(unsigned int op, int fd) {
+    return (static_cast<uint64_t>(op) << 56) | static_cast<uint32_t>(fd);
+  }
+
+  /*! Minimal io_uring ring, driven through raw system calls */
+  struct Server::Uring {
+    Uring(): fd(-1), sq_ptr(MAP_FAILED), cq_ptr(MAP_FAILED), sqes_ptr(MAP_FAILED), tail(0), multishot(true), files(0) {};
+    ~Uring();
+
+    bool setup(unsigned int entries); //<! create and map ring, returns false if kernel lacks needed features
+    struct io_uring_sqe* sqe(); //<! next cleared submission entry, submits queued entries when queue is full
+    int enter(unsigned int wait, int timeout); //<! submit queued entries and wait for completions, returns negated errno on failure
+    void provide(unsigned int bid, unsigned int count); //<! give receive buffers to kernel
+    void accept(int lfd); //<! queue accept on listening socket
+    void wake(int wfd); //<! queue poll on stop eventfd
+
+    int fd; //<! ring descriptor
+    struct io_uring_params params; //<! ring parameters
+    void *sq_ptr, *cq_ptr, *sqes_ptr; //<! mapped ring memory
+    size_t sq_size, cq_size; //<! sizes of mapped rings
+    unsigned int *sq_head, *sq_tail, *sq_mask, *sq_array; //<! submission ring
+    unsigned int *cq_head, *cq_tail, *cq_mask; //<! completion ring
+    struct io_uring_sqe *sqes; //<! submission entries
+    struct io_uring_cqe *cqes; //<! completion entries
+    unsigned int tail; //<! local submission tail, published by enter
+    bool multishot; //<! multishot accept is supported
+    unsigned int files; //<! size of registered file table, sockets below it are registered, 0 if registering is not supported
+    std::vector<char> buffers; //<! receive buffers provided to kernel
+    std::vector<int> starved; //<! sockets whose recv ran out of buffers
+  };
+
+  Server::Uring::~Uring() {
+    if (sqes_ptr != MAP_FAILED) ::munmap(sqes_ptr, params.sq_entries * sizeof(struct io_uring_sqe));
+    if (cq_ptr != MAP_FAILED && cq_ptr != sq_ptr) ::munmap(cq_ptr, cq_size);
+    if (sq_ptr != MAP_FAILED) ::munmap(sq_ptr, sq_size);
+    if (fd > -1) ::close(fd);
+  }
+
+  bool Server::Uring::setup(unsigned int entries) {
+    ::memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = entries * 4;
+    if ((fd = ::syscall(__NR_io_uring_setup, entries, &params)) < 0) return false;
+    if ((params.features & IORING_FEAT_EXT_ARG) == 0 || (params.features & IORING_FEAT_NODROP) == 0) return false;
+
+    sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+    cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) sq_size = cq_size = std::max(sq_size, cq_size);
+    sq_ptr = ::mmap(NULL, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (sq_ptr == MAP_FAILED) return false;
+    if (params.features & IORING_FEAT_SINGLE_MMAP) cq_ptr = sq_ptr;
+    else if ((cq_ptr = ::mmap(NULL, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING)) == MAP_FAILED) return false;
+    sqes_ptr = ::mmap(NULL, params.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (sqes_ptr == MAP_FAILED) return false;
+
+    char *sq = static_cast<char*>(sq_ptr), *cq = static_cast<char*>(cq_ptr);
+    sq_head = reinterpret_cast<unsigned int*>(sq + params.sq_off.head);
+    sq_tail = reinterpret_cast<unsigned int*>(sq + params.sq_off.tail);
+    sq_mask = reinterpret_cast<unsigned int*>(sq + params.sq_off.ring_mask);
+    sq_array = reinterpret_cast<unsigned int*>(sq + params.sq_off.array);
+    cq_head = reinterpret_cast<unsigned int*>(cq + params.cq_off.head);
+    cq_tail = reinterpret_cast<unsigned int*>(cq + params.cq_off.tail);
+    cq_mask = reinterpret_cast<unsigned int*>(cq + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<struct io_uring_cqe*>(cq + params.cq_off.cqes);
+    sqes = static_cast<struct io_uring_sqe*>(sqes_ptr);
+    tail = *sq_tail;
+    return true;
+  }
+
+  struct io_uring_sqe* Server::Uring::sqe() {
+    if (tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) >= params.sq_entries) enter(0, 0);
+    unsigned int idx = tail & *sq_mask;
+    struct io_uring_sqe* e = &sqes[idx];
+    ::memset(e, 0, sizeof(*e));
+    sq_array[idx] = idx;
+    tail++;
+    return e;
+  }
+
+  int Server::Uring::enter(unsigned int wait, int timeout) {
+    struct io_uring_getevents_arg arg;
+    struct __kernel_timespec ts;
+    unsigned int submit = tail - *sq_tail;
+    unsigned int flags = 0;
+    int r;
+
+    __atomic_store_n(sq_tail, tail, __ATOMIC_RELEASE);
+    ::memset(&arg, 0, sizeof(arg));
+    if (wait > 0) {
+      flags = IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG;
+      if (timeout > -1) {
+        ts.tv_sec = timeout / 1000;
+        ts.tv_nsec = (timeout % 1000) * 1000000L;
+        arg.ts = reinterpret_cast<uint64_t>(&ts);
+      }
+    }
+    r = ::syscall(__NR_io_uring_enter, fd, submit, wait, flags, (wait > 0 ? &arg : NULL), (wait > 0 ? sizeof(arg) : 0));
+    return (r < 0 ? -errno : r);
+  }
+
+  void Server::Uring::provide(unsigned int bid, unsigned int count) {
+    struct io_uring_sqe* e = sqe();
+    e->opcode = IORING_OP_PROVIDE_BUFFERS;
+    e->fd = count;
+    e->addr = reinterpret_cast<uint64_t>(&buffers[bid * uring_buffer_size]);
+    e->len = uring_buffer_size;
+    e->off = bid;
+    e->buf_group = 0;
+    e->user_data = uringTag(uring_provide, 0);
+  }
+
+  void Server::Uring::accept(int lfd) {
+    struct io_uring_sqe* e = sqe();
+    e->opcode = IORING_OP_ACCEPT;
+    e->fd = lfd;
+    e->accept_flags = SOCK_CLOEXEC;
+    if (multishot) e->ioprio = IORING_ACCEPT_MULTISHOT;
+    e->user_data = uringTag(uring_accept, lfd);
+  }
+
+  void Server::Uring::wake(int wfd) {
+    struct io_uring_sqe* e = sqe();
+    e->opcode = IORING_OP_POLL_ADD;
+    e->fd = wfd;
+    e->poll32_events = POLLIN;
+    e->user_data = uringTag(uring_wake, wfd);
+  }
+
+  bool Server::setupUring() {
+    std::unique_ptr<Uring> ring(new Uring());
+    if (ring->setup(uring_entries) == false) return false;
+
+    // sparse table that sockets are put in as they are accepted
+    struct rlimit limit;
+    unsigned int files = uring_max_files;
+    if (::getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < files) files = limit.rlim_cur;
+    std::vector<int> sparse(files, -1);
+    if (files > 0 && ::syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_FILES, sparse.data(), files) == 0) ring->files = files;
+
+    ring->buffers.resize(uring_buffer_count * uring_buffer_size);
+    ring->provide(0, uring_buffer_count);
+    ring->wake(wfd);
+    if (lfd > -1) {
+      // io_uring waits for blocking sockets itself instead of failing with EAGAIN
+      ::fcntl(lfd, F_SETFL, ::fcntl(lfd, F_GETFL) & ~O_NONBLOCK);
+      ring->accept(lfd);
+    }
+    uring.swap(ring);
+    return true;
+  }
+
+  void Server::runUring(int timeout) {
+    Uring& ring = *uring;
+    int r = ring.enter(1, timeout);
+    if (r < 0 && r != -ETIME && r != -EINTR && r != -EBUSY) {
+      errno = -r;
+      throw Error(systemError("io_uring_enter"));
+    }
+
+    unsigned int head = *ring.cq_head;
+    unsigned int tail = __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE);
+    while(head != tail) {
+      struct io_uring_cqe cqe = ring.cqes[head & *ring.cq_mask];
+      unsigned int op = static_cast<unsigned int>(cqe.user_data >> 56);
+      int fd = static_cast<int>(cqe.user_data & 0xffffffff);
+      head++;
+      __atomic_store_n(ring.cq_head, head, __ATOMIC_RELEASE);
+
+      switch(op) {
+      case uring_accept:
+        if (cqe.res == -EINVAL && ring.multishot) ring.multishot = false;
+        else onUringAccept(cqe.res);
+        if ((cqe.flags & IORING_CQE_F_MORE) == 0) ring.accept(lfd);
+        break;
+      case uring_wake: {
+        uint64_t value;
+        if (::read(wfd, &value, sizeof(value)) < 0) {} // reset eventfd
+        ring.wake(wfd);
+        break;
+      }
+      case uring_read: {
+        Connection& conn = *table[fd];
+        conn.inflight--;
+        if (conn.shut) release(conn);
+        else onFileRead(conn, conn.bodies.front().incoming, cqe.res);
+        break;
+      }
+      case uring_provide:
+        if (cqe.res < 0) {
+          errno = -cqe.res;
+          throw Error(systemError("Cannot provide receive buffers"));
+        }
+        break;
+      case uring_recv:
+        onUringRecv(*table[fd], cqe.res, cqe.flags);
+        break;
+      case uring_update:
+        if (cqe.res < 0) ring.files = 0; // sockets accepted from now on are used through their descriptors
+        break;
+      case uring_send:
+        onUringSend(*table[fd], cqe.res);
+        break;
+      }
+    }
+
+    // buffers have been given back by now
+    std::vector<int> starved;
+    starved.swap(ring.starved);
+    for(size_t i = 0; i < starved.size(); i++) {
+      Connection& conn = *table[starved[i]];
+      if (conn.shut) release(conn);
+      else armRecv(conn);
+    }
+  }
+
+  void Server::onUringAccept(int res) {
+    int val = 1;
+    if (res < 0) return;
+    if (active >= max_connections) {
+      ::close(res);
+      return;
+    }
+    ::setsockopt(res, IPPROTO_TCP, TCP_NODELAY, &val, sizeof(val));
+    Connection& conn = attach(res);
+    registerSocket(conn, true);
+    armRecv(conn);
+  }
+
+  void Server::registerSocket(Connection& conn, bool add) {
+    static const int unregistered = -1;
+    if (add && static_cast<unsigned int>(conn.fd) >= uring->files) return;
+    // update is done in submission order, before operations queued after it
+    struct io_uring_sqe* e = uring->sqe();
+    e->opcode = IORING_OP_FILES_UPDATE;
+    e->fd = -1;
+    e->addr = reinterpret_cast<uint64_t>(add ? &conn.fd : &unregistered);
+    e->len = 1;
+    e->off = conn.fd;
+    e->user_data = uringTag(uring_update, conn.fd);
+    conn.fixed = add;
+  }
+
+  void Server::armRecv(Connection& conn) {
+    struct io_uring_sqe* e = uring->sqe();
+    e->opcode = IORING_OP_RECV;
+    e->fd = conn.fd;
+    e->flags = IOSQE_BUFFER_SELECT | (conn.fixed ? IOSQE_FIXED_FILE : 0);
+    e->buf_group = 0;
+    e->len = uring_buffer_size;
+    e->user_data = uringTag(uring_recv, conn.fd);
+    conn.inflight++;
+    conn.recving = true;
+  }
+
+  void Server::flushUring(Connection& conn) {
+    if (conn.shut || conn.sending.empty() == false || conn.sendbody != NULL) return; // previous send still in flight
+    if (takeBody(conn) == false) {
+      if (conn.bodies.empty() == false && conn.bodies.front().at == 0) return; // continued once chunk has been read
+      if (conn.out.empty()) {
+        if (conn.closing && conn.lingering == false) finish(conn);
+        return;
+      }
+      if (conn.bodies.empty()) {
+        conn.sending.swap(conn.out);
+        conn.out.clear();
+      } else {
+        // send up to next body, positions of bodies move along
+        size_t end = conn.bodies.front().at;
+        conn.sending.assign(conn.out, 0, end);
+        conn.out.erase(0, end);
+        for(std::deque<QueuedBody>::iterator i = conn.bodies.begin(); i != conn.bodies.end(); i++) i->at -= end;
+        takeBody(conn); // start of body goes with headers when it is ready
+      }
+    }
+    conn.sendpos = 0;
+    submitSend(conn);
+  }
+
+  bool Server::takeBody(Connection& conn) {
+    while(conn.bodies.empty() == false && conn.bodies.front().at == 0) {
+      QueuedBody& body = conn.bodies.front();
+      if (body.remaining == 0) {
+        conn.bodies.pop_front();
+        continue;
+      }
+      if (body.data != NULL) {
+        // shared memory is kept alive by body until next flush
+        conn.sendbody = body.data + body.offset;
+        conn.sendbodylen = body.remaining;
+      } else {
+        if (nextChunk(conn, body) == false) return false;
+        conn.sendchunk.swap(body.chunk);
+        body.chunk.clear();
+        conn.sendbody = conn.sendchunk.data();
+        conn.sendbodylen = conn.sendchunk.size();
+      }
+      body.offset += conn.sendbodylen;
+      body.remaining -= conn.sendbodylen;
+      return true;
+    }
+    return false;
+  }
+
+  void Server::submitSend(Connection& conn) {
+    struct io_uring_sqe* e = uring->sqe();
+    size_t head = conn.sending.size();
+    if (conn.sendpos < head && conn.sendbodylen > 0) {
+      // headers and body in one operation instead of linked sends
+      conn.sendiov[0].iov_base = &conn.sending[conn.sendpos];
+      conn.sendiov[0].iov_len = head - conn.sendpos;
+      conn.sendiov[1].iov_base = const_cast<char*>(conn.sendbody);
+      conn.sendiov[1].iov_len = conn.sendbodylen;
+      ::memset(&conn.sendhdr, 0, sizeof(conn.sendhdr));
+      conn.sendhdr.msg_iov = conn.sendiov;
+      conn.sendhdr.msg_iovlen = 2;
+      e->opcode = IORING_OP_SENDMSG;
+      e->addr = reinterpret_cast<uint64_t>(&conn.sendhdr);
+      e->len = 1;
+    } else if (conn.sendpos < head) {
+      e->opcode = IORING_OP_SEND;
+      e->addr = reinterpret_cast<uint64_t>(conn.sending.data() + conn.sendpos);
+      e->len = head - conn.sendpos;
+    } else {
+      e->opcode = IORING_OP_SEND;
+      e->addr = reinterpret_cast<uint64_t>(conn.sendbody + conn.sendpos - head);
+      e->len = head + conn.sendbodylen - conn.sendpos;
+    }
+    e->fd = conn.fd;
+    if (conn.fixed) e->flags = IOSQE_FIXED_FILE;
+    e->msg_flags = MSG_NOSIGNAL;
+    e->user_data = uringTag(uring_send, conn.fd);
+    conn.inflight++;
+  }
+
+  void Server::onUringRecv(Connection& conn, int res, unsigned int flags) {
+    conn.inflight--;
+    conn.recving = false;
+    if (flags & IORING_CQE_F_BUFFER) {
+      unsigned int bid = flags >> IORING_CQE_BUFFER_SHIFT;
+      if (res > 0 && conn.shut == false && conn.closing == false) {
+        conn.last = ::time(NULL);
+        try {
+          conn.loader.feed(&uring->buffers[bid * uring_buffer_size], res);
+          process(conn);
+        } catch (SizeError& ex) {
+          reject(conn, 413);
+        } catch (ParseError& ex) {
+          reject(conn, 400);
+        }
+      }
+      uring->provide(bid, 1);
+    }
+
+    if (conn.shut) {
+      release(conn);
+      return;
+    } else if (res == -ENOBUFS) {
+      uring->starved.push_back(conn.fd);
+      return;
+    } else if (res < 0) {
+      close(conn);
+      return;
+    } else if (conn.lingering) {
+      if (res == 0 || (conn.drained += res) > max_linger_size) close(conn);
+      else armRecv(conn);
+      return;
+    } else if (res == 0) {
+      conn.closing = true; // peer is done sending
+    }
+
+    flushUring(conn);
+    if (conn.shut || conn.closing) return;
+    if (conn.out.size() + conn.sending.size() + conn.sendbodylen - conn.sendpos > max_pending_output) conn.paused = true; // resumed from onUringSend
+    else armRecv(conn);
+  }
+
+  void Server::onUringSend(Connection& conn, int res) {
+    conn.inflight--;
+    if (conn.shut) {
+      release(conn);
+      return;
+    } else if (res < 0) {
+      close(conn);
+      return;
+    }
+    conn.last = ::time(NULL);
+    conn.sendpos += res;
+    if (conn.sendpos < conn.sending.size() + conn.sendbodylen) {
+      submitSend(conn); // short send, queue the rest
+      return;
+    }
+    conn.sending.clear();
+    conn.sendchunk.clear();
+    conn.sendbody = NULL;
+    conn.sendbodylen = 0;
+    conn.sendpos = 0;
+    flushUring(conn);
+    if (conn.shut == false && conn.paused && conn.recving == false && conn.out.size() + conn.sending.size() <= max_pending_output) {
+      conn.paused = false;
+      armRecv(conn);
+    }
+  }
+#else
+  struct Server::Uring {};
+
+  bool Server::setupUring() { return false; }
+  void Server::runUring(int) {}
+  void Server::armRecv(Connection&) {}
+  void Server::registerSocket(Connection&, bool) {}
+  void Server::flushUring(Connection&) {}
+  void Server::onUringAccept(int) {}
+  void Server::onUringRecv(Connection&, int, unsigned int) {}
+  void Server::onUringSend(Connection&, int) {}
+#endif
+
+  bool Server::nextChunk(Connection& conn, QueuedBody& body) {
+    if (body.chunkpos == body.chunk.size()) {
+      body.chunk.swap(body.ahead);
+      body.ahead.clear();
+      body.chunkpos = 0;
+    }
+    // keep one chunk read ahead of the one being sent
+    if (body.reading == false && body.ahead.empty() && body.readpos < body.offset + body.remaining) startRead(conn, body);
+    return body.chunkpos < body.chunk.size();
+  }
+
+  void Server::startRead(Connection& conn, QueuedBody& body) {
+    size_t len = std::min(file_chunk_size, body.offset + body.remaining - body.readpos);
+    body.reading = true;
+    // sequential access doubles readahead of the kernel
+    if (body.readpos == body.file.offset()) ::posix_fadvise(body.file.fd(), body.readpos, body.remaining, POSIX_FADV_SEQUENTIAL);
+#ifdef HAVE_IO_URING
+    if (uring) {
+      body.incoming.resize(len);
+      struct io_uring_sqe* e = uring->sqe();
+      e->opcode = IORING_OP_READ;
+      e->fd = body.file.fd();
+      e->addr = reinterpret_cast<uint64_t>(&body.incoming[0]);
+      e->len = len;
+      e->off = body.readpos;
+      e->user_data = uringTag(uring_read, conn.fd);
+      conn.inflight++;
+      return;
+    }
+#endif
+    if (!readers) readers.reset(new Readers(wfd, io_threads));
+    Readers::Job job;
+    job.fd = conn.fd;
+    job.generation = conn.generation;
+    job.file = body.file;
+    job.offset = body.readpos;
+    job.data.resize(len);
+    job.res = 0;
+    readers->submit(std::move(job));
+  }
+
+  void Server::onFileRead(Connection& conn, std::string& data, ssize_t res) {
+    QueuedBody& body = conn.bodies.front();
+    body.reading = false;
+    if (res <= 0) {
+      // file got shorter than announced Content-Length or cannot be read
+      close(conn);
+      return;
+    }
+    data.resize(res);
+    body.ahead.swap(data);
+    body.readpos += res;
+    if (uring) flushUring(conn);
+    else onWrite(conn);
+  }
+
+  void Server::finishReads() {
+    std::vector<Readers::Job> done;
+    {
+      std::lock_guard<std::mutex> guard(readers->lock);
+      done.swap(readers->done);
+    }
+    for(size_t i = 0; i < done.size(); i++) {
+      Readers::Job& job = done[i];
+      Connection& conn = *table[job.fd];
+      // connection may have been closed while its file was read
+      if (conn.fd < 0 || conn.generation != job.generation) continue;
+      onFileRead(conn, job.data, job.res);
+    }
+  }
+
+  ServerPool::ServerPool(size_t workers): pin_cpus(false) {
+    if (workers == 0) workers = std::thread::hardware_concurrency();
+    if (workers == 0) workers = 1;
+    for(size_t i = 0; i < workers; i++) {
+      servers.push_back(std::unique_ptr<Server>(new Server()));
+      servers.back()->reuse_port = true;
+    }
+  }
+
+  ServerPool::~ServerPool() {
+    stop();
+    join();
+  }
+
+  void ServerPool::listen(const std::string& address, int port, int backlog) {
+    servers[0]->listen(address, port, backlog);
+    port = servers[0]->localPort(); // the rest must join the port picked for first
+    for(size_t i = 1; i < servers.size(); i++)
+      servers[i]->listen(address, port, backlog);
+  }
+
+  void ServerPool::start() {
+    if (threads.size() > 0) throw Error("ServerPool is already started");
+    size_t ncpu = std::thread::hardware_concurrency();
+    for(size_t i = 0; i < servers.size(); i++) {
+      Server* server = servers[i].get();
+      threads.push_back(std::thread([server]() { server->run(); }));
+      if (pin_cpus && ncpu > 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(i % ncpu, &set);
+        ::pthread_setaffinity_np(threads.back().native_handle(), sizeof(set), &set);
+      }
+    }
+  }
+
+  void ServerPool::stop() {
+    for(size_t i = 0; i < servers.size(); i++)
+      servers[i]->stop();
+  }
+
+  void ServerPool::join() {
+    for(size_t i = 0; i < threads.size(); i++)
+      threads[i].join();
+    threads.clear();
+  }
+
+  size_t ServerPool::connections() const {
+    size_t n = 0;
+    for(size_t i = 0; i < servers.size(); i++)
+      n += servers[i]->connections();
+    return n;
+  }
+};
+#endif
@@ -0,0 +1,244 @@
+#pragma once
+/* @file
+ * @brief Defines event loop HTTP server
+ */
+#include "yahttp-config.h"
+#include "router.hpp"
+
+#if defined(HAVE_CPP_FUNC_PTR) && defined(HAVE_SYS_EPOLL_H)
+#include <atomic>
+#include <ctime>
+#include <deque>
+#include <string>
+#include <memory>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+
+namespace YaHTTP {
+  typedef enum {
+    backend_epoll, //<! edge-triggered epoll with non-blocking sockets
+    backend_uring //<! io_uring completions, falls back to epoll if kernel does not support it
+  } serverbackend_t; //<! I/O backend of Server
+
+  /*! Event loop HTTP/1.x server.
+
+Uses edge-triggered epoll and non-blocking sockets. Connections are kept alive and pipelined requests are
+answered in order. Each connection slot keeps its Request, Response and AsyncRequestLoader, so they are reused
+by later connections. Requests are dispatched through Router::Route, override check and handle to dispatch otherwise.
+
+Responses get Content-Length when they are rendered from body, with HTTPBase::ZeroCopyFileRender or with
+HTTPBase::SharedBufferRender, other renderers are sent chunked to HTTP/1.1 clients and the connection is closed after
+them for HTTP/1.0 clients. Files of ZeroCopyFileRender are sent with sendfile(2) and memory of SharedBufferRender
+directly from where it is, after the headers, which are sent with MSG_MORE so that they share packets with the body.
+Conditional and Range requests are answered with Response::applyConditional, so ranges of these bodies are sent as
+slices without copying either. With compress set, textual bodies and SendFileRender files are compressed for clients
+accepting gzip or deflate.
+
+With async_files set, files are read in chunks on io_threads I/O threads, or with io_uring reads on backend_uring,
+instead of being sent with sendfile(2) or rendered in place. The loop keeps serving other connections while a read
+waits for the disk, and the next chunk of a file is read while the previous one is sent. SendFileRender bodies are
+read the same way and get Content-Length.
+
+Requests with a body are checked as soon as their headers are complete, before the body is read. Requests larger
+than max_request_size get 413, requests with no route get 404 unless notFound is set, and checkHeaders can reject
+others by setting a status. Rejected requests are answered at once without reading the body, and chunked bodies are
+rejected with 413 once they grow larger than max_request_size. The sending side of the connection is then shut down
+and whatever the client still sends is read and thrown away for up to linger_timeout seconds or max_linger_size bytes
+before the connection is closed, so that a client busy sending its body gets to read the answer instead of a reset.
+HTTP/1.1 requests with Expect: 100-continue get 100 Continue once they pass, and 417 for other expectations.
+
+@code
+YaHTTP::Router::Get("/", index);
+YaHTTP::Server server;
+server.listen("127.0.0.1", 8080);
+server.run();
+@endcode
+
+With backend set to backend_uring, sockets are served from io_uring instead: connections are accepted with multishot
+accept and registered with the ring, so that their operations skip file table lookups, data is received into buffers
+provided to the kernel and fed directly to the loader, and queued responses are sent with one send per batch. Files
+are always read in chunks with io_uring reads, as with async_files, and the first chunk or shared memory of a body
+goes out with the headers before it in one sendmsg. If io_uring cannot be set up, epoll is used.
+
+run and runOnce must be called from one thread at a time, stop can be called from any thread.
+  */
+  class Server {
+  public:
+    Server(); //<! construct server, throws Error if event loop cannot be created
+    virtual ~Server(); //<! closes listening socket and all connections
+
+    void listen(const std::string& address, int port, int backlog = 1024); //<! listen on IPv4 or IPv6 address, port 0 picks free port, throws Error on failure
+    int localPort() const; //<! port the server is listening on
+
+    void run(); //<! handle connections until stop is called
+    void runOnce(int timeout); //<! wait at most timeout milliseconds for events and handle them
+    void stop(); //<! make run return, safe to call from other threads and signal handlers, run returns at once if called before it
+    size_t connections() const { return active; }; //<! number of open connections
+    serverbackend_t activeBackend() const { return (uring ? backend_uring : backend_epoll); }; //<! backend in use once run has been called
+
+    THandlerFunction notFound; //<! called when no route matches, responds with 404 if empty
+    THandlerFunction checkHeaders; //<! called with headers of request with body before body is read, setting resp->status rejects request with resp
+    int idle_timeout; //<! seconds after idle connections are closed, 0 disables
+    size_t max_connections; //<! connections over this are closed right after accepting
+    ssize_t max_request_size; //<! maximum size of request, see HTTPBase::max_request_size
+    size_t max_pending_output; //<! reading from connection pauses when this many response bytes are waiting
+    int linger_timeout; //<! seconds unread request data is drained from connection of rejected request before it is closed, 0 closes at once
+    size_t max_linger_size; //<! connection of rejected request is closed once this many bytes have been drained from it
+    bool reuse_port; //<! bind with SO_REUSEPORT, so that several servers can listen on the same port
+    bool conditional; //<! answer conditional and Range requests with Response::applyConditional
+    bool compress; //<! compress responses with Compression::apply when zlib is available
+    int compression_level; //<! zlib compression level used when compressing
+    size_t compression_min_size; //<! bodies smaller than this are not compressed
+    bool inflate_requests; //<! inflate gzip and deflate encoded request bodies as they arrive, up to max_request_size bytes
+    bool parse_cookies; //<! populate Request::jar for every request, if false it is populated on first COOKIES() call
+    bool parse_getvars; //<! populate Request::getvars for every request, if false only Request::query is
+    bool parse_multipart; //<! parse multipart/form-data request bodies into postvars and uploads as they arrive, see AsyncLoader::parse_multipart
+    std::string upload_dir; //<! directory for temporary files of uploads
+    bool async_files; //<! read file bodies in chunks off the event loop instead of sending them with sendfile
+    size_t io_threads; //<! number of threads reading files for async_files with epoll backend, started on first read
+    serverbackend_t backend; //<! I/O backend, chosen when run or runOnce is first called
+
+  protected:
+    /*! File or shared memory queued for sending after given amount of Connection::out */
+    struct QueuedBody {
+      QueuedBody(size_t at_, const HTTPBase::ZeroCopyFileRender& file_, bool async_ = false): at(at_), file(file_), data(NULL), offset(file_.offset()), remaining(file_.size()), async(async_), readpos(file_.offset()), chunkpos(0), reading(false) {};
+      QueuedBody(size_t at_, const HTTPBase::SharedBufferRender& buffer): at(at_), owner(buffer.owner), data(buffer.data), offset(0), remaining(buffer.size), async(false), readpos(0), chunkpos(0), reading(false) {};
+      size_t at; //<! position in out where body belongs
+      HTTPBase::ZeroCopyFileRender file; //<! file to send, unless data is set
+      std::shared_ptr<const void> owner; //<! keeps data alive
+      const char* data; //<! memory to send
+      size_t offset; //<! next byte to send
+      size_t remaining; //<! bytes left to send
+      bool async; //<! file is read in chunks instead of sent with sendfile
+      size_t readpos; //<! file offset of next chunk to read
+      std::string chunk; //<! chunk being sent
+      size_t chunkpos; //<! amount of chunk already sent
+      std::string ahead; //<! chunk read ahead of the one being sent
+      std::string incoming; //<! buffer of io_uring read in flight
+      bool reading; //<! read of next chunk is in flight
+    };
+
+    /*! State of a single connection slot */
+    struct Connection {
+      Connection(): fd(-1), generation(0), outpos(0), last(0), closing(false), paused(false), linger(false), lingering(false), drained(0), sendbody(NULL), sendbodylen(0), sendpos(0), inflight(0), recving(false), shut(false), fixed(false) {};
+      int fd; //<! socket, -1 when slot is free
+      unsigned int generation; //<! incremented whenever slot gets new connection
+      Request req; //<! request being read
+      Response resp; //<! response being built
+      AsyncRequestLoader loader; //<! request parser
+      std::ostringstream stream; //<! serialization buffer
+      std::string out; //<! data waiting to be sent
+      size_t outpos; //<! amount of out already sent
+      std::deque<QueuedBody> bodies; //<! files and shared memory to send between data in out
+      time_t last; //<! time of last activity
+      bool closing; //<! close after out has been sent
+      bool paused; //<! reading stopped until out has been sent
+      bool linger; //<! request was answered without reading all of it, drain connection before closing it
+      bool lingering; //<! sending side has been shut down and input is read and thrown away until peer stops
+      size_t drained; //<! bytes thrown away while lingering
+      THandlerFunction handler; //<! handler check routed request to, passed to handle for same request
+      std::string sending; //<! data being sent by io_uring, out is queued behind it
+      std::string sendchunk; //<! file chunk being sent by io_uring after sending
+      const char* sendbody; //<! body data being sent by io_uring after sending, in sendchunk or memory of first body
+      size_t sendbodylen; //<! length of sendbody
+      size_t sendpos; //<! amount of sending and sendbody already sent
+      struct iovec sendiov[2]; //<! sending and sendbody for sendmsg
+      struct msghdr sendhdr; //<! message of sendmsg in flight
+      int inflight; //<! io_uring operations in flight
+      bool recving; //<! io_uring recv is in flight
+      bool shut; //<! socket has been shut down, it is closed once nothing is in flight
+      bool fixed; //<! socket is registered with io_uring at index fd
+    };
+    struct Uring; //<! io_uring state, defined in server.cpp
+    struct Readers; //<! file reading threads, defined in server.cpp
+
+    virtual void handle(Request* req, Response* resp, THandlerFunction& handler); //<! produce response for request, handler is set if check already routed request
+    virtual void check(Request* req, Response* resp, THandlerFunction& handler); //<! decide about request with body before body is read, leave resp->status at 0 to accept it, handler routed for request is passed to handle
+    void reject(Connection& conn, int status); //<! answer request that cannot be loaded with bare status and close connection after it
+    void finish(Connection& conn); //<! close connection once its output has been sent, lingering first if it has unread input
+    void drain(Connection& conn); //<! read and throw away input of lingering connection until peer stops or limit is reached
+    void respond(Connection& conn); //<! handle loaded request and queue response
+    void queue(Connection& conn, bool alive); //<! serialize response of connection and queue it for sending
+    bool onHeaders(Connection& conn); //<! check request once its headers are complete, returns false if request was answered without reading body
+    void process(Connection& conn); //<! respond to all complete requests in loader
+    void onRead(Connection& conn); //<! read until socket is drained
+    void onWrite(Connection& conn); //<! send queued output
+    void accept(); //<! accept pending connections
+    Connection& attach(int fd); //<! set up connection slot for accepted socket
+    void close(Connection& conn); //<! close connection and free its slot
+    void sweep(time_t now); //<! close idle connections
+    bool setupUring(); //<! set up io_uring backend, returns false if not supported
+    void runUring(int timeout); //<! io_uring variant of runOnce
+    void armRecv(Connection& conn); //<! queue io_uring recv for connection
+    void registerSocket(Connection& conn, bool add); //<! register socket of connection with io_uring, or drop it before it is closed
+    void flushUring(Connection& conn); //<! queue io_uring send of queued output
+    bool takeBody(Connection& conn); //<! make next piece of first body sendbody if it is at start of out, returns false if it is not or its chunk is still being read
+    void submitSend(Connection& conn); //<! queue io_uring send of what is left of sending and sendbody
+    void onUringAccept(int res); //<! handle accepted connection
+    void onUringRecv(Connection& conn, int res, unsigned int flags); //<! handle received data
+    void onUringSend(Connection& conn, int res); //<! handle sent data
+    void release(Connection& conn); //<! close socket of shut down connection once nothing is in flight
+    bool nextChunk(Connection& conn, QueuedBody& body); //<! move read ahead chunk into place and start next read, returns false while there is nothing to send
+    void startRead(Connection& conn, QueuedBody& body); //<! read next chunk of file on reader thread or with io_uring
+    void onFileRead(Connection& conn, std::string& data, ssize_t res); //<! handle chunk read for first body of connection
+    void finishReads(); //<! hand chunks read by reader threads to their connections
+
+    int lfd; //<! listening socket
+    int efd; //<! epoll descriptor
+    int wfd; //<! eventfd used by stop and reader threads
+    std::atomic<bool> stopping; //<! set by stop, cleared when run returns
+    std::atomic<size_t> active; //<! number of open connections
+    time_t last_sweep; //<! time of last idle sweep
+    std::vector<std::unique_ptr<Connection> > table; //<! connection slots indexed by socket
+    std::unique_ptr<Uring> uring; //<! io_uring state when backend_uring is in use
+    bool uring_tried; //<! io_uring setup has been attempted
+    std::unique_ptr<Readers> readers; //<! file reading threads, started on first read
+
+  private:
+    Server(const Server&); //<! not copyable
+    Server& operator=(const Server&); //<! not copyable
+  };
+
+  /*! Runs several Servers on their own threads.
+
+Every worker has its own listening socket bound to the same port with SO_REUSEPORT, so the kernel spreads new
+connections between workers and they share no state while serving. Configure workers through worker() before
+calling listen. Handlers are called from all worker threads at once, use Router::EnableThreadCache for route
+caching without shared locks.
+
+@code
+YaHTTP::ServerPool pool;
+pool.listen("0.0.0.0", 8080);
+pool.run();
+@endcode
+  */
+  class ServerPool {
+  public:
+    ServerPool(size_t workers = 0); //<! construct pool of workers, 0 uses one worker per CPU
+    ~ServerPool(); //<! stops and joins workers
+
+    void listen(const std::string& address, int port, int backlog = 1024); //<! make every worker listen on address and port, port 0 picks free port
+    int localPort() const { return servers[0]->localPort(); }; //<! port the workers are listening on
+
+    void start(); //<! start worker threads
+    void stop(); //<! make workers return, safe to call from other threads and signal handlers
+    void join(); //<! wait until workers have returned
+    void run() { start(); join(); }; //<! start workers and wait until stop is called
+
+    size_t size() const { return servers.size(); }; //<! number of workers
+    Server& worker(size_t n) { return *servers[n]; }; //<! nth worker
+    size_t connections() const; //<! number of open connections in all workers
+
+    bool pin_cpus; //<! pin worker n to CPU n modulo number of CPUs when started
+
+  private:
+    std::vector<std::unique_ptr<Server> > servers; //<! workers
+    std::vector<std::thread> threads; //<! worker threads, empty when not started
+
+    ServerPool(const ServerPool&); //<! not copyable
+    ServerPool& operator=(const ServerPool&); //<! not copyable
+  };
+};
+#endif
@@ -0,0 +1,288 @@
+#pragma once
+/* @file
+ * @brief Defines compile-time route tables
+ */
+#include "router.hpp"
+
+#ifndef YAHTTP_STATIC_ROUTE_SEGMENTS
+#define YAHTTP_STATIC_ROUTE_SEGMENTS 16
+#endif
+
+#ifdef HAVE_CPP_FUNC_PTR
+namespace YaHTTP {
+  typedef void (*TStaticHandler)(Request* req, Response* resp); //!< Plain handler function pointer
+
+  typedef enum {
+    segment_end, //<! no more segments
+    segment_literal, //<! text matched as is
+    segment_parameter, //<! typed parameter up to delimiter
+    segment_glob //<! rest of path
+  } segmentkind_t; //<! Kind of compiled route mask segment
+
+  /*! Piece of route mask resolved at compile time */
+  struct StaticRouteSegment {
+    constexpr StaticRouteSegment(segmentkind_t kind_, paramtype_t type_, size_t offset_, size_t length_, char delim_):
+      kind(kind_), type(type_), offset(offset_), length(length_), delim(delim_) {};
+
+    segmentkind_t kind; //<! what segment matches
+    paramtype_t type; //<! type of parameter
+    size_t offset; //<! offset of literal text or parameter name in mask
+    size_t length; //<! length of literal text or parameter name
+    char delim; //<! character following parameter in mask, NUL at end
+  };
+
+  template <size_t... I> struct StaticIndexes {}; //<! pack of indexes
+  template <size_t N, size_t... I> struct StaticMakeIndexes: StaticMakeIndexes<N - 1, N - 1, I...> {}; //<! makes StaticIndexes<0..N-1>
+  template <size_t... I> struct StaticMakeIndexes<0, I...> { typedef StaticIndexes<I...> type; }; //<! end of recursion
+
+  /*! Compile-time checks for route masks, see Router for the syntax */
+  struct StaticRouteMask {
+    static constexpr size_t length(const char* str) {
+      return *str == '\0' ? 0 : 1 + length(str + 1);
+    }; //<! length of string
+
+    static constexpr bool typeIs(const char* type, const char* name) {
+      return *name == '\0' ? *type == '>' : (*type == *name && typeIs(type + 1, name + 1));
+    }; //<! whether type, terminated with &gt;, equals name
+
+    static constexpr bool validType(const char* type) {
+      return typeIs(type, "string") || typeIs(type, "int") || typeIs(type, "hex") ||
+             typeIs(type, "uuid") || typeIs(type, "slug");
+    }; //<! whether type is known
+
+    static constexpr const char* close(const char* param) {
+      return (*param == '>' || *param == '\0') ? param : close(param + 1);
+    }; //<! position of &gt; ending parameter, or end of invalid mask
+
+    static constexpr bool validParameter(const char* param, bool glob) {
+      return *param == '\0' ? false :
+             *param == '<' ? false :
+             *param == '>' ? valid(param + 1) :
+             *param == ':' ? (!glob && validType(param + 1) && valid(close(param) + 1)) :
+             validParameter(param + 1, glob);
+    }; //<! validates parameter and rest of mask
+
+    static constexpr bool valid(const char* mask) {
+      return *mask == '\0' ? true :
+             *mask == '>' ? false :
+             *mask == '<' ? validParameter(mask + 1, mask[1] == '*') :
+             valid(mask + 1);
+    }; //<! whether mask is valid
+
+    static constexpr bool validMethod(const char* method) {
+      return *method == '\0' ? true : (*method >= 'A' && *method <= 'Z' && validMethod(method + 1));
+    }; //<! methods must be empty (any) or uppercase
+
+    static constexpr size_t literalEnd(const char* mask, size_t pos) {
+      return (mask[pos] == '\0' || mask[pos] == '<') ? pos : literalEnd(mask, pos + 1);
+    }; //<! end of literal text starting at pos
+
+    static constexpr size_t segmentEnd(const char* mask, size_t pos) {
+      return mask[pos] == '<' ? static_cast<size_t>(close(mask + pos) - mask) + (*close(mask + pos) == '>' ? 1 : 0) : literalEnd(mask, pos);
+    }; //<! end of segment starting at pos
+
+    static constexpr size_t segmentStart(const char* mask, size_t n, size_t pos = 0) {
+      return (n == 0 || mask[pos] == '\0') ? pos : segmentStart(mask, n - 1, segmentEnd(mask, pos));
+    }; //<! start of nth segment
+
+    static constexpr size_t segments(const char* mask, size_t pos = 0) {
+      return mask[pos] == '\0' ? 0 : 1 + segments(mask, segmentEnd(mask, pos));
+    }; //<! number of segments
+
+    static constexpr size_t nameEnd(const char* mask, size_t pos) {
+      return (mask[pos] == ':' || mask[pos] == '>' || mask[pos] == '\0') ? pos : nameEnd(mask, pos + 1);
+    }; //<! end of parameter name starting at pos
+
+    static constexpr paramtype_t type(const char* spec) {
+      return *spec != ':' ? param_string :
+             typeIs(spec + 1, "int") ? param_int :
+             typeIs(spec + 1, "hex") ? param_hex :
+             typeIs(spec + 1, "uuid") ? param_uuid :
+             typeIs(spec + 1, "slug") ? param_slug : param_string;
+    }; //<! type of parameter given what follows its name
+
+    static constexpr StaticRouteSegment parameter(const char* mask, size_t pos, size_t end) {
+      return StaticRouteSegment(segment_parameter, type(mask + nameEnd(mask, pos)), pos, nameEnd(mask, pos) - pos, mask[end] == '>' ? mask[end + 1] : '\0');
+    }; //<! parameter whose name starts at pos and which ends at end
+
+    static constexpr StaticRouteSegment segment(const char* mask, size_t pos) {
+      return mask[pos] == '\0' ? StaticRouteSegment(segment_end, param_string, pos, 0, '\0') :
+             mask[pos] != '<' ? StaticRouteSegment(segment_literal, param_string, pos, literalEnd(mask, pos) - pos, '\0') :
+             mask[pos + 1] == '*' ? StaticRouteSegment(segment_glob, param_string, pos + 2, nameEnd(mask, pos + 2) - pos - 2, '\0') :
+             parameter(mask, pos + 1, static_cast<size_t>(close(mask + pos) - mask));
+    }; //<! segment starting at pos
+  };
+
+  /*! Single compile-time route, handler is called directly.
+
+The mask is split into literal and parameter segments when the route is constructed, so matching compares literal
+text and consumes parameters by their type without parsing the mask or allocating. Parameter names are copied into
+params only when the whole path matches. Masks may have at most YAHTTP_STATIC_ROUTE_SEGMENTS segments.
+  */
+  template <TStaticHandler H>
+  struct StaticRoute {
+    constexpr StaticRoute(const char* method_, const char* mask_, const char* name_):
+      StaticRoute(method_, mask_, name_, typename StaticMakeIndexes<YAHTTP_STATIC_ROUTE_SEGMENTS>::type()) {};
+
+    template <size_t... I>
+    constexpr StaticRoute(const char* method_, const char* mask_, const char* name_, StaticIndexes<I...>):
+      method(method_), mask(mask_), name(name_),
+      segments{ StaticRouteMask::segment(mask_, StaticRouteMask::segmentStart(mask_, I))... } {};
+
+    constexpr bool valid() const {
+      return StaticRouteMask::valid(mask) && StaticRouteMask::validMethod(method) &&
+             StaticRouteMask::segments(mask) < YAHTTP_STATIC_ROUTE_SEGMENTS;
+    }; //<! whether method and mask are valid and mask fits in segments
+
+    bool match(const std::string& path, TRouteParameterList& params) const {
+      struct { size_t pos, len; long long number; } found[YAHTTP_STATIC_ROUTE_SEGMENTS];
+      size_t k = 0, i;
+      for(i = 0; segments[i].kind != segment_end; i++) {
+        const StaticRouteSegment& s = segments[i];
+        if (s.kind == segment_literal) {
+          if (path.size() - k < s.length || path.compare(k, s.length, mask + s.offset, s.length) != 0) return false;
+          k += s.length;
+          continue;
+        }
+        if (k == path.size()) return false; // parameters need something to match
+        found[i].pos = k;
+        found[i].number = 0;
+        if (s.kind == segment_glob) {
+          k = path.size();
+        } else if (s.type == param_string) {
+          while(k < path.size() && path[k] != s.delim) k++;
+        } else if (Router::matchParameter(s.type, path, k, s.delim, found[i].number) == false) {
+          return false;
+        }
+        found[i].len = k - found[i].pos;
+      }
+      if (k != path.size()) return false;
+
+      params.clear();
+      for(i = 0; segments[i].kind != segment_end; i++) {
+        const StaticRouteSegment& s = segments[i];
+        if (s.kind == segment_literal || (s.kind == segment_glob && s.length == 0)) continue;
+        TRouteParameter param;
+        param.name.assign(mask + s.offset, s.length);
+        param.type = s.type;
+        param.pos = found[i].pos;
+        param.len = found[i].len;
+        param.number = found[i].number;
+        params.push_back(param);
+      }
+      return true;
+    }; //<! matches path against compiled mask, collecting parameters like Router::match
+
+    static void call(Request* req, Response* resp) { H(req, resp); }; //<! invoke handler
+    static TStaticHandler handler() { return H; }; //<! handler pointer
+
+    const char* method; //<! method, empty matches any
+    const char* mask; //<! url mask
+    const char* name; //<! route name
+    StaticRouteSegment segments[YAHTTP_STATIC_ROUTE_SEGMENTS]; //<! compiled mask, ended by segment_end
+  };
+
+  /*! Compile-time route table.
+
+Routes are evaluated in order like with Router, but the table has no startup cost and handlers are
+called directly instead of through THandlerFunction. Declare it with YAHTTP_STATIC_ROUTER so that
+methods and masks are checked with static_assert.
+
+@code
+static void index(YaHTTP::Request *req, YaHTTP::Response *resp);
+static void object(YaHTTP::Request *req, YaHTTP::Response *resp);
+
+YAHTTP_STATIC_ROUTER(routes,
+  YAHTTP_STATIC_ROUTE("GET", "/", index, "index"),
+  YAHTTP_STATIC_ROUTE("GET", "/obj/<id:int>", object, "object")
+);
+
+routes.route(&req, &resp);
+@endcode
+  */
+  template <class... Routes> class StaticRouter;
+
+  template <>
+  class StaticRouter<> {
+  public:
+    constexpr StaticRouter() {};
+    constexpr bool valid() const { return true; }; //<! empty table is valid
+    constexpr size_t size() const { return 0; }; //<! number of routes
+
+    bool find(Request*, TRouteParameterList&, TStaticHandler&, const char*&) const { return false; }; //<! end of table
+    bool dispatch(Request*, Response*, TRouteParameterList&) const { return false; }; //<! end of table
+    void printRoutes(std::ostream&) const {}; //<! end of table
+  };
+
+  template <class Head, class... Tail>
+  class StaticRouter<Head, Tail...> {
+  public:
+    constexpr StaticRouter(const Head& head_, const Tail&... tail_): head(head_), tail(tail_...) {};
+
+    constexpr bool valid() const { return head.valid() && tail.valid(); }; //<! whether all routes are valid
+    constexpr size_t size() const { return 1 + tail.size(); }; //<! number of routes
+
+    bool find(Request* req, TRouteParameterList& params, TStaticHandler& handler, const char*& name) const {
+      if ((*head.method == '\0' || req->method == head.method) && head.match(req->url.path, params)) {
+        handler = Head::handler();
+        name = head.name;
+        return true;
+      }
+      return tail.find(req, params, handler, name);
+    }; //<! find matching route
+
+    bool route(Request* req, TStaticHandler& handler) const {
+      TRouteParameterList params;
+      const char* name;
+      if (!find(req, params, handler, name)) return false;
+      Router::setParameters(req, params);
+      req->routeName = name;
+      return true;
+    }; //<! Performs routing based on req->url.path, like Router::Route
+
+    bool route(Request* req, Response* resp) const {
+      TRouteParameterList params;
+      return dispatch(req, resp, params);
+    }; //<! Performs routing and calls the handler, returns false if no route matched
+
+    bool dispatch(Request* req, Response* resp, TRouteParameterList& params) const {
+      if ((*head.method == '\0' || req->method == head.method) && head.match(req->url.path, params)) {
+        Router::setParameters(req, params);
+        req->routeName = head.name;
+        Head::call(req, resp);
+        return true;
+      }
+      return tail.dispatch(req, resp, params);
+    }; //<! dispatch using caller provided parameter storage
+
+    void printRoutes(std::ostream &os) const {
+      std::streamsize ss = os.width();
+      std::ios::fmtflags ff = os.setf(std::ios::left);
+      os.width(10);
+      os << head.method;
+      os.width(50);
+      os << head.mask;
+      os.width(ss);
+      os.setf(ff);
+      os << "    " << head.name << std::endl;
+      tail.printRoutes(os);
+    }; //<! Prints all routes to given output stream
+
+    Head head; //<! this route
+    StaticRouter<Tail...> tail; //<! rest of the routes
+  };
+
+  /*! Helper for constructing StaticRouter without spelling out route types */
+  template <class... Routes>
+  constexpr StaticRouter<Routes...> makeStaticRouter(const Routes&... routes) {
+    return StaticRouter<Routes...>(routes...);
+  }
+};
+
+/*! Declares a single compile-time route for YAHTTP_STATIC_ROUTER */
+#define YAHTTP_STATIC_ROUTE(method, mask, handler, name) YaHTTP::StaticRoute<&handler>(method, mask, name)
+/*! Declares constexpr route table var and checks it with static_assert */
+#define YAHTTP_STATIC_ROUTER(var, ...) \
+  constexpr auto var = YaHTTP::makeStaticRouter(__VA_ARGS__); \
+  static_assert(var.valid(), "Invalid method or URL mask in static route table " #var)
+#endif
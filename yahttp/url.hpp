@@ -1,4 +1,5 @@
 #pragma once
+#include <limits>
 #include <sstream>
 #include <string>
 
@@ -9,78 +10,91 @@
 #endif 
 
 namespace YaHTTP {
-  /*! URL parser and container */
-  class URL {
-   private: 
-      bool parseSchema(const std::string& url, size_t &pos) {
+  class URL;
+
+  /*! URL parser that records components as views into the parsed buffer.
+
+The buffer must outlive the view. Username and password are kept undecoded, they are decoded when
+converting to URL with toURL.
+  */
+  class URLView {
+   private:
+      static int parsePort(const StringView& str) {
+          int value = 0;
+          for(size_t i = 0; i < str.size() && YaHTTP::isdigit(str[i]); i++) {
+             if (value > (std::numeric_limits<int>::max() - (str[i] - '0')) / 10) return std::numeric_limits<int>::max();
+             value = value * 10 + (str[i] - '0');
+          }
+          return value;
+      }; //<! parse port number, stops at first non-digit
+
+      bool parseSchema(const StringView& url, size_t &pos) {
           size_t pos1;
           if (pos >= url.size()) return false; // no data
-          if ( (pos1 = url.find_first_of(":",pos)) == std::string::npos ) return false; // schema is mandatory
+          if ( (pos1 = url.find(':', pos)) == StringView::npos ) return false; // schema is mandatory
           protocol = url.substr(pos, pos1-pos);
-          if (protocol == "http") port = 80;
-          if (protocol == "https") port = 443;
+          if (protocol == StringView("http", 4)) port = 80;
+          if (protocol == StringView("https", 5)) port = 443;
           pos = pos1+1; // after :
-          if (url.compare(pos, 2, "//") == 0) {
+          if (url.substr(pos, 2) == StringView("//", 2)) {
              pathless = false; // if this is true we put rest into parameters
              pos += 2;
           }
           return true;
       }; //<! parse schema/protocol part 
 
-      bool parseHost(const std::string& url, size_t &pos) {
+      bool parseHost(const StringView& url, size_t &pos) {
           size_t pos1;
           if (pos >= url.size()) return true; // no data
-          if ( (pos1 = url.find_first_of("/", pos)) == std::string::npos ) {
+          if ( (pos1 = url.find('/', pos)) == StringView::npos ) {
              host = url.substr(pos);
-             path = "/";
+             path = StringView("/", 1);
              pos = url.size();
           } else {
              host = url.substr(pos, pos1-pos);
              pos = pos1;
           }
-          if (host.at(0) == '[') { // IPv6
-            if ((pos1 = host.find_first_of("]")) == std::string::npos) {
+          if (host.size() > 0 && host[0] == '[') { // IPv6
+            if ((pos1 = host.find(']')) == StringView::npos) {
               // incomplete address
               return false;
             }
             size_t pos2;
-            if ((pos2 = host.find_first_of(":", pos1)) != std::string::npos) {
-              std::istringstream tmp(host.substr(pos2 + 1));
-              tmp >> port;
+            if ((pos2 = host.find(':', pos1)) != StringView::npos) {
+              port = parsePort(host.substr(pos2 + 1));
             }
             host = host.substr(1, pos1 - 1);
-          } else if ( (pos1 = host.find_first_of(":")) != std::string::npos ) {
-             std::istringstream tmp(host.substr(pos1+1));
-             tmp >> port;
+          } else if ( (pos1 = host.find(':')) != StringView::npos ) {
+             port = parsePort(host.substr(pos1+1));
              host = host.substr(0, pos1);
           }
           return true;
       }; //<! parse host and port
 
-      bool parseUserPass(const std::string& url, size_t &pos) {
-          size_t pos1,pos2;
+      bool parseUserPass(const StringView& url, size_t &pos) {
+          size_t pos1,pos2,end;
           if (pos >= url.size()) return true; // no data
 
-          if ( (pos1 = url.find_first_of("@",pos)) == std::string::npos ) return true; // no userinfo
-          pos2 = url.find_first_of(":",pos);
+          // userinfo can only be in authority part
+          for(end = pos; end < url.size() && url[end] != '/' && url[end] != '?' && url[end] != '#'; end++);
+          if ( (pos1 = url.substr(0, end).find('@',pos)) == StringView::npos ) return true; // no userinfo
+          pos2 = url.substr(0, pos1).find(':',pos);
 
-          if (pos2 != std::string::npos) { // comes with password
+          if (pos2 != StringView::npos) { // comes with password
              username = url.substr(pos, pos2 - pos);
              password = url.substr(pos2+1, pos1 - pos2 - 1);
-             password = Utility::decodeURL(password);
           } else {
              username = url.substr(pos, pos1 - pos);
           }
           pos = pos1+1;
-          username = Utility::decodeURL(username);
           return true;
       }; //<! parse possible username and password
 
-      bool parsePath(const std::string& url, size_t &pos) {
+      bool parsePath(const StringView& url, size_t &pos) {
           size_t pos1;
           if (pos >= url.size()) return true; // no data
           if (url[pos] != '/') return false; // not an url
-          if ( (pos1 = url.find_first_of("?", pos)) == std::string::npos ) {
+          if ( (pos1 = url.find('?', pos)) == StringView::npos ) {
              path = url.substr(pos);
              pos = url.size();
           } else {
@@ -90,29 +104,74 @@ namespace YaHTTP {
           return true;
       }; //<! parse path component
 
-      bool parseParameters(const std::string& url, size_t &pos) {
+      bool parseParameters(const StringView& url, size_t &pos) {
           size_t pos1;
           if (pos >= url.size()) return true; // no data
           if (url[pos] == '#') return true; // anchor starts here
           if (url[pos] != '?') return false; // not a parameter
-          if ( (pos1 = url.find_first_of("#", pos)) == std::string::npos ) {
-             parameters = url.substr(pos+1);;
+          if ( (pos1 = url.find('#', pos)) == StringView::npos ) {
+             parameters = url.substr(pos+1);
              pos = url.size();
           } else {
              parameters = url.substr(pos+1, pos1-pos-1);
              pos = pos1;
           }
-          if (parameters.size()>0 && *(parameters.end()-1) == '&') parameters.resize(parameters.size()-1);
+          if (parameters.size()>0 && parameters[parameters.size()-1] == '&') parameters = parameters.substr(0, parameters.size()-1);
           return true;
       }; //<! parse url parameters
 
-      bool parseAnchor(const std::string& url, size_t &pos) {
+      bool parseAnchor(const StringView& url, size_t &pos) {
           if (pos >= url.size()) return true; // no data
           if (url[pos] != '#') return false; // not anchor
           anchor = url.substr(pos+1);
           return true;
       }; //<! parse anchor
 
+  public:
+      StringView protocol; //<! schema/protocol 
+      StringView host; //<! host
+      int port; //<! port
+      StringView username; //<! username, not decoded
+      StringView password; //<! password, not decoded
+      StringView path; //<! path 
+      StringView parameters; //<! url parameters
+      StringView anchor; //<! anchor
+      bool pathless; //<! whether this url has no path
+
+      URLView() { initialize(); }; //<! construct empty view
+
+      void initialize() {
+        protocol = host = username = password = path = parameters = anchor = StringView();
+        port = 0; pathless = true;
+      }; //<! initialize to empty URL
+
+      bool parse(const StringView& url) {
+        // setup
+        initialize();
+
+        if (url.size() > YAHTTP_MAX_URL_LENGTH) return false;
+        size_t pos = 0;
+        if (url.empty() || url[0] != '/') { // full url?
+          if (parseSchema(url, pos) == false) return false;
+          if (pathless) {
+            parameters = url.substr(pos);
+            return true;
+          }
+          if (parseUserPass(url, pos) == false) return false;
+          if (parseHost(url, pos) == false) return false;
+        }
+        if (parsePath(url, pos) == false) return false;
+        if (parseParameters(url, pos) == false) return false;
+        return parseAnchor(url, pos);
+      }; //<! parse url, components refer to url's buffer
+
+      void toURL(URL& url) const; //<! copy components into url, reusing its storage
+      URL toURL() const; //<! convert into owning URL
+  };
+
+  /*! URL parser and container */
+  class URL {
+   private: 
       void initialize() {
         protocol = ""; host = ""; port = 0; username = ""; password = ""; path = ""; parameters = ""; anchor =""; pathless = true;
       }; //<! initialize to empty URL
@@ -173,28 +232,41 @@ namespace YaHTTP {
       }; //<! calls parse with url
 
       bool parse(const std::string& url) {
-        // setup
-        initialize();
-
-        if (url.size() > YAHTTP_MAX_URL_LENGTH) return false;
-        size_t pos = 0;
-        if (*(url.begin()) != '/') { // full url?
-          if (parseSchema(url, pos) == false) return false;
-          if (pathless) {
-            parameters = url.substr(pos);
-            return true;
-          }
-          if (parseUserPass(url, pos) == false) return false;
-          if (parseHost(url, pos) == false) return false;
-        }
-        if (parsePath(url, pos) == false) return false;
-        if (parseParameters(url, pos) == false) return false;
-        return parseAnchor(url, pos);
+        URLView view;
+        bool result = view.parse(url);
+        view.toURL(*this);
+        return result;
     }; //<! parse various formats of urls ranging from http://example.com/foo?bar=baz into data:base64:d089swt64wt... 
 
+    void normalize() {
+      asciiToLower(protocol);
+      asciiToLower(host);
+      path = Utility::normalizePath(path);
+    }; //<! lowercases protocol and host and normalizes path, see Utility::normalizePath
+
     friend std::ostream & operator<<(std::ostream& os, const URL& url) {
       os<<url.to_string();
       return os;
     };
   };
+
+  inline void URLView::toURL(URL& url) const {
+    protocol.assignTo(url.protocol);
+    host.assignTo(url.host);
+    url.port = port;
+    if (username.empty()) url.username.clear();
+    else url.username = Utility::decodeURL(username.str());
+    if (password.empty()) url.password.clear();
+    else url.password = Utility::decodeURL(password.str());
+    path.assignTo(url.path);
+    parameters.assignTo(url.parameters);
+    anchor.assignTo(url.anchor);
+    url.pathless = pathless;
+  };
+
+  inline URL URLView::toURL() const {
+    URL url;
+    toURL(url);
+    return url;
+  };
 };
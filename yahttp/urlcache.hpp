@@ -0,0 +1,60 @@
+#pragma once
+/* @file
+ * @brief Defines cache for parsed request targets
+ */
+#include <memory>
+
+#include "cache.hpp"
+#include "url.hpp"
+
+namespace YaHTTP {
+  /*! Bounded cache mapping raw request targets into parsed and normalized URLs.
+
+Entries are keyed by the target up to the query string, so targets that differ only in their
+parameters share one entry. Cached URLs are immutable and can be shared between threads.
+URLs without path and targets that fail to parse are never cached.
+  */
+  class URLCache {
+  private:
+    BoundedCache<std::shared_ptr<const URL> > cache; //<! parsed urls without parameters
+    bool normalize; //<! whether cached urls are normalized
+
+  public:
+    URLCache(size_t capacity = 4096, bool normalize_ = true): cache(capacity), normalize(normalize_) {}; //<! construct cache holding up to capacity urls
+
+    std::shared_ptr<const URL> get(const StringView& target) {
+      std::shared_ptr<const URL> result;
+      std::string key = target.substr(0, target.find('?')).str();
+      if (cache.get(key, result)) return result;
+
+      URLView view;
+      if (view.parse(key) == false) return result;
+      std::shared_ptr<URL> url(new URL());
+      view.toURL(*url);
+      if (normalize) url->normalize();
+      result = url;
+      if (!url->path.empty()) cache.put(key, result);
+      return result;
+    }; //<! parsed url for target without parameters and anchor, empty pointer if target is invalid
+
+    bool parse(const StringView& target, URL& url) {
+      URLView view;
+      std::shared_ptr<const URL> base;
+      bool result = view.parse(target);
+      if (result && !view.path.empty() && (base = get(target))) {
+        url = *base;
+        view.parameters.assignTo(url.parameters);
+        view.anchor.assignTo(url.anchor);
+        return true;
+      }
+      view.toURL(url);
+      if (normalize) url.normalize();
+      return result;
+    }; //<! parse target into url like URL::parse, reusing cached components when possible
+
+    void clear() { cache.clear(); }; //<! drop all cached urls
+    size_t size() { return cache.size(); }; //<! number of cached urls
+    unsigned long hits() const { return cache.hits(); }; //<! number of lookups served from cache
+    unsigned long misses() const { return cache.misses(); }; //<! number of lookups that had to parse
+  };
+};
@@ -1,5 +1,14 @@
 #pragma once
 
+#include <cstring>
+#include <stdint.h>
+#ifdef YAHTTP_USE_UNORDERED_MAP
+#include <unordered_map>
+#endif
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #ifndef YAHTTP_MAX_REQUEST_LINE_SIZE
 #define YAHTTP_MAX_REQUEST_LINE_SIZE 8192
 #endif
@@ -12,30 +21,218 @@ namespace YaHTTP {
   static const char *MONTHS[] = {0,"Jan","Feb","Mar","Apr","May","Jun","Jul","Aug","Sep","Oct","Nov","Dec",0}; //<! List of months 
   static const char *DAYS[] = {"Sun","Mon","Tue","Wed","Thu","Fri","Sat",0}; //<! List of days
 
-  bool isspace(char c);
-  bool isspace(char c, const std::locale& loc);
-  bool isxdigit(char c);
-  bool isxdigit(char c, const std::locale& loc);
-  bool isdigit(char c);
-  bool isdigit(char c, const std::locale& loc);
-  bool isalnum(char c);
-  bool isalnum(char c, const std::locale& loc);
+  enum {
+    CHAR_ALNUM = 0x01, //<! ASCII letter or digit
+    CHAR_URL = 0x02, //<! left as is by Utility::encodeURL when encoding urls
+    CHAR_WURL = 0x04, //<! left as is by wide Utility::encodeURL when encoding urls
+    CHAR_DIGIT = 0x08, //<! decimal digit
+    CHAR_XDIGIT = 0x10, //<! hexadecimal digit
+    CHAR_SPACE = 0x20, //<! whitespace like std::isspace in C locale
+    CHAR_TOKEN = 0x40, //<! token character (RFC 7230 tchar)
+    CHAR_ALPHA = 0x80 //<! ASCII letter
+  }; //<! Character classes in CHARCLASS
+
+  static constexpr unsigned char CHARCLASS[256] = {
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x20, 0x20, 0x20, 0x20, 0x00, 0x00, // 00
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // 10
+    0x20, 0x40, 0x00, 0x46, 0x40, 0x46, 0x46, 0x40, 0x06, 0x06, 0x40, 0x46, 0x06, 0x46, 0x46, 0x06, // 20
+    0x5f, 0x5f, 0x5f, 0x5f, 0x5f, 0x5f, 0x5f, 0x5f, 0x5f, 0x5f, 0x02, 0x06, 0x00, 0x06, 0x00, 0x06, // 30
+    0x06, 0xd7, 0xd7, 0xd7, 0xd7, 0xd7, 0xd7, 0xc7, 0xc7, 0xc7, 0xc7, 0xc7, 0xc7, 0xc7, 0xc7, 0xc7, // 40
+    0xc7, 0xc7, 0xc7, 0xc7, 0xc7, 0xc7, 0xc7, 0xc7, 0xc7, 0xc7, 0xc7, 0x06, 0x00, 0x06, 0x40, 0x46, // 50
+    0x40, 0xd7, 0xd7, 0xd7, 0xd7, 0xd7, 0xd7, 0xc7, 0xc7, 0xc7, 0xc7, 0xc7, 0xc7, 0xc7, 0xc7, 0xc7, // 60
+    0xc7, 0xc7, 0xc7, 0xc7, 0xc7, 0xc7, 0xc7, 0xc7, 0xc7, 0xc7, 0xc7, 0x06, 0x40, 0x06, 0x40, 0x00, // 70
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // 80
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // 90
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // a0
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // b0
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // c0
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // d0
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // e0
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 // f0
+  }; //<! Character class bits for each byte, locale independent
+
+  static constexpr unsigned char HEXVALUE[256] = {
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, // 00
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, // 10
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, // 20
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, // 30
+    0xff, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, // 40
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, // 50
+    0xff, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, // 60
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, // 70
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, // 80
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, // 90
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, // a0
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, // b0
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, // c0
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, // d0
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, // e0
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff // f0
+  }; //<! Value of hex digit for each byte, 0xff if not a hex digit
+
+  static constexpr unsigned char ASCIILOWER[256] = {
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, // 00
+    0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f, // 10
+    0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28, 0x29, 0x2a, 0x2b, 0x2c, 0x2d, 0x2e, 0x2f, // 20
+    0x30, 0x31, 0x32, 0x33, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x3b, 0x3c, 0x3d, 0x3e, 0x3f, // 30
+    0x40, 0x61, 0x62, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a, 0x6b, 0x6c, 0x6d, 0x6e, 0x6f, // 40
+    0x70, 0x71, 0x72, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x5b, 0x5c, 0x5d, 0x5e, 0x5f, // 50
+    0x60, 0x61, 0x62, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a, 0x6b, 0x6c, 0x6d, 0x6e, 0x6f, // 60
+    0x70, 0x71, 0x72, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x7b, 0x7c, 0x7d, 0x7e, 0x7f, // 70
+    0x80, 0x81, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89, 0x8a, 0x8b, 0x8c, 0x8d, 0x8e, 0x8f, // 80
+    0x90, 0x91, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0x9b, 0x9c, 0x9d, 0x9e, 0x9f, // 90
+    0xa0, 0xa1, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xab, 0xac, 0xad, 0xae, 0xaf, // a0
+    0xb0, 0xb1, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xbb, 0xbc, 0xbd, 0xbe, 0xbf, // b0
+    0xc0, 0xc1, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xcb, 0xcc, 0xcd, 0xce, 0xcf, // c0
+    0xd0, 0xd1, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xdb, 0xdc, 0xdd, 0xde, 0xdf, // d0
+    0xe0, 0xe1, 0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xeb, 0xec, 0xed, 0xee, 0xef, // e0
+    0xf0, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa, 0xfb, 0xfc, 0xfd, 0xfe, 0xff // f0
+  }; //<! ASCII lowercase of each byte, other bytes are kept as is
+
+  inline constexpr bool isspace(char c) { return (CHARCLASS[static_cast<unsigned char>(c)] & CHAR_SPACE) != 0; }; //<! ASCII whitespace
+  inline constexpr bool isxdigit(char c) { return (CHARCLASS[static_cast<unsigned char>(c)] & CHAR_XDIGIT) != 0; }; //<! ASCII hexadecimal digit
+  inline constexpr bool isdigit(char c) { return (CHARCLASS[static_cast<unsigned char>(c)] & CHAR_DIGIT) != 0; }; //<! ASCII decimal digit
+  inline constexpr bool isalpha(char c) { return (CHARCLASS[static_cast<unsigned char>(c)] & CHAR_ALPHA) != 0; }; //<! ASCII letter
+  inline constexpr bool isalnum(char c) { return (CHARCLASS[static_cast<unsigned char>(c)] & CHAR_ALNUM) != 0; }; //<! ASCII letter or digit
+  inline constexpr bool istoken(char c) { return (CHARCLASS[static_cast<unsigned char>(c)] & CHAR_TOKEN) != 0; }; //<! valid in header names and methods
+  inline constexpr bool isurlsafe(char c) { return (CHARCLASS[static_cast<unsigned char>(c)] & CHAR_URL) != 0; }; //<! left as is when encoding urls
+  inline constexpr char asciiLower(char c) { return static_cast<char>(ASCIILOWER[static_cast<unsigned char>(c)]); }; //<! ASCII lowercase
+  inline constexpr char asciiUpper(char c) { return (CHARCLASS[static_cast<unsigned char>(c)] & CHAR_ALPHA) != 0 ? static_cast<char>(c & ~0x20) : c; }; //<! ASCII uppercase
+
+  bool isspace(char c, const std::locale& loc); //<! whitespace in locale
+  bool isxdigit(char c, const std::locale& loc); //<! hexadecimal digit in locale
+  bool isdigit(char c, const std::locale& loc); //<! decimal digit in locale
+  bool isalnum(char c, const std::locale& loc); //<! letter or digit in locale
+
+  inline uint64_t asciiLowerWord(uint64_t x) {
+    const uint64_t ones = 0x0101010101010101ULL;
+    uint64_t heptets = x & (0x7f * ones);
+    uint64_t aboveZ = heptets + ((0x7f - 'Z') * ones);
+    uint64_t fromA = heptets + ((0x80 - 'A') * ones);
+    return x | (((fromA ^ aboveZ) & ~x & (0x80 * ones)) >> 2);
+  }; //<! ASCII lowercase eight bytes at once
+
+#ifdef __SSE2__
+  inline __m128i asciiLowerVector(__m128i x) {
+    __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(x, _mm_set1_epi8('A' - 1)), _mm_cmplt_epi8(x, _mm_set1_epi8('Z' + 1)));
+    return _mm_or_si128(x, _mm_and_si128(upper, _mm_set1_epi8(0x20)));
+  }; //<! ASCII lowercase sixteen bytes at once
+#endif
+
+  inline int asciiCaseCompare(const char* a, const char* b, size_t n) {
+    size_t i = 0;
+#ifdef __SSE2__
+    for(; i + 16 <= n; i += 16) {
+      __m128i x = asciiLowerVector(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)));
+      __m128i y = asciiLowerVector(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i)));
+      if (_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) != 0xffff) break;
+    }
+#endif
+    for(; i + 8 <= n; i += 8) {
+      uint64_t x, y;
+      ::memcpy(&x, a + i, 8);
+      ::memcpy(&y, b + i, 8);
+      if (asciiLowerWord(x) != asciiLowerWord(y)) break;
+    }
+    // locate the difference, if any
+    for(; i < n; i++) {
+      int v = static_cast<unsigned char>(asciiLower(a[i])) - static_cast<unsigned char>(asciiLower(b[i]));
+      if (v != 0) return v;
+    }
+    return 0;
+  }; //<! ASCII case-insensitive comparison of n bytes, returns negative, zero or positive like memcmp
+
+  inline void asciiToLower(std::string& str) {
+    for(std::string::iterator i = str.begin(); i != str.end(); i++) *i = asciiLower(*i);
+  }; //<! ASCII lowercase string in place
+
+  inline void asciiToUpper(std::string& str) {
+    for(std::string::iterator i = str.begin(); i != str.end(); i++) *i = asciiUpper(*i);
+  }; //<! ASCII uppercase string in place
 
   /*! Case-Insensitive NULL safe comparator for string maps */
   struct ASCIICINullSafeComparator {
     bool operator() (const std::string& lhs, const std::string& rhs) const {
-      int v;
-      std::string::const_iterator lhi = lhs.begin();
-      std::string::const_iterator rhi = rhs.begin();
-      for(;lhi != lhs.end() && rhi != rhs.end(); lhi++, rhi++)
-        if ((v = ::tolower(*lhi) - ::tolower(*rhi)) != 0) return v<0; 
-      if (lhi == lhs.end() && rhi != rhs.end()) return true;
-      if (lhi != lhs.end() && rhi == rhs.end()) return false;
-      return false; // they are equal
+      int v = asciiCaseCompare(lhs.data(), rhs.data(), std::min(lhs.size(), rhs.size()));
+      if (v != 0) return v<0;
+      return lhs.size() < rhs.size();
     }
   };
 
+  /*! Case-Insensitive hash for unordered string maps, consistent with ASCIICIEqual */
+  struct ASCIICIHash {
+    size_t operator() (const std::string& str) const {
+      uint64_t h = 0xcbf29ce484222325ULL;
+      size_t i = 0;
+      for(; i + 8 <= str.size(); i += 8) {
+        uint64_t w;
+        ::memcpy(&w, str.data() + i, 8);
+        h = (h ^ asciiLowerWord(w)) * 0x9e3779b97f4a7c15ULL;
+        h ^= h >> 32;
+      }
+      for(; i < str.size(); i++)
+        h = (h ^ static_cast<unsigned char>(asciiLower(str[i]))) * 0x100000001b3ULL;
+      return static_cast<size_t>(h ^ (h >> 29));
+    }
+  };
+
+  /*! Case-Insensitive equality for unordered string maps */
+  struct ASCIICIEqual {
+    bool operator() (const std::string& lhs, const std::string& rhs) const {
+      return lhs.size() == rhs.size() && asciiCaseCompare(lhs.data(), rhs.data(), lhs.size()) == 0;
+    }
+  };
+
+#ifdef YAHTTP_USE_UNORDERED_MAP
+  typedef std::unordered_map<std::string,std::string,ASCIICIHash,ASCIICIEqual> strstr_map_t; //<! String to String map
+#else
   typedef std::map<std::string,std::string,ASCIICINullSafeComparator> strstr_map_t; //<! String to String map
+#endif
+
+  /*! Non-owning reference to a range of characters, valid only as long as the underlying buffer is */
+  class StringView {
+  public:
+    static const size_t npos = static_cast<size_t>(-1); //<! not found
+
+    StringView(): ptr(""), len(0) {}; //<! construct empty view
+    StringView(const char* ptr_, size_t len_): ptr(ptr_), len(len_) {}; //<! construct view of len_ characters at ptr_
+    StringView(const std::string& str): ptr(str.data()), len(str.size()) {}; //<! construct view of string
+
+    const char* data() const { return ptr; }; //<! start of view
+    size_t size() const { return len; }; //<! length of view
+    bool empty() const { return len == 0; }; //<! whether view is empty
+    const char* begin() const { return ptr; }; //<! iterator to start
+    const char* end() const { return ptr + len; }; //<! iterator to end
+    char operator[](size_t i) const { return ptr[i]; }; //<! character at i, no bounds checking
+
+    size_t find(char c, size_t pos = 0) const {
+      for(; pos < len; pos++)
+        if (ptr[pos] == c) return pos;
+      return npos;
+    }; //<! position of c at or after pos, npos if not found
+
+    StringView substr(size_t pos, size_t n = npos) const {
+      if (pos > len) pos = len;
+      if (n > len - pos) n = len - pos;
+      return StringView(ptr + pos, n);
+    }; //<! view of at most n characters starting at pos
+
+    std::string str() const { return std::string(ptr, len); }; //<! copy into string
+    void assignTo(std::string& target) const { target.assign(ptr, len); }; //<! copy into existing string, reusing its storage
+
+    bool operator==(const StringView& rhs) const {
+      return len == rhs.len && std::equal(ptr, ptr + len, rhs.ptr);
+    }; //<! compare contents
+    bool operator!=(const StringView& rhs) const { return !(*this == rhs); }; //<! compare contents
+
+    friend std::ostream& operator<<(std::ostream& os, const StringView& view) {
+      os.write(view.ptr, view.len);
+      return os;
+    };
+  private:
+    const char* ptr; //<! start of characters
+    size_t len; //<! number of characters
+  };
 
   /*! Represents a date/time with utc offset */
   class DateTime {
@@ -149,6 +346,13 @@ namespace YaHTTP {
 
        return oss.str(); 
      }; //<! converts this date into a RFC-822 format
+
+     std::string http_str() const {
+       char buf[32];
+       validate();
+       snprintf(buf, sizeof(buf), "%s, %02d %s %04d %02d:%02d:%02d GMT", DAYS[wday], day, MONTHS[month], year, hours, minutes, seconds);
+       return buf;
+     }; //<! converts this date into HTTP-date (RFC 7231 IMF-fixdate), date must be in GMT
  
      std::string cookie_str() const {
        std::ostringstream oss;
@@ -204,6 +408,50 @@ namespace YaHTTP {
        }
      }; //<! parses HTTP Cookie date
 
+     void parseHttp(const std::string &http_date) {
+       const char *ptr = http_date.c_str();
+       if (http_date.size() == 29 && ptr[3] == ',' && ptr[4] == ' ' && ptr[7] == ' ' && ptr[11] == ' ' && ptr[16] == ' ' &&
+           ptr[19] == ':' && ptr[22] == ':' && http_date.compare(25, 4, " GMT") == 0) {
+         // IMF-fixdate, parsed by position as it is what everyone sends
+         static const int positions[] = { 5, 6, 12, 13, 14, 15, 17, 18, 20, 21, 23, 24 };
+         for(size_t i = 0; i < sizeof(positions)/sizeof(positions[0]); i++)
+           if (ptr[positions[i]] < '0' || ptr[positions[i]] > '9') throw YaHTTP::ParseError("Unparseable date");
+         initialize();
+         for(wday = 0; DAYS[wday] != NULL && ::strncmp(DAYS[wday], ptr, 3) != 0; wday++);
+         for(month = 1; MONTHS[month] != NULL && ::strncmp(MONTHS[month], ptr + 8, 3) != 0; month++);
+         if (DAYS[wday] == NULL || MONTHS[month] == NULL) throw YaHTTP::ParseError("Unparseable date");
+         day = (ptr[5] - '0') * 10 + (ptr[6] - '0');
+         year = (ptr[12] - '0') * 1000 + (ptr[13] - '0') * 100 + (ptr[14] - '0') * 10 + (ptr[15] - '0');
+         hours = (ptr[17] - '0') * 10 + (ptr[18] - '0');
+         minutes = (ptr[20] - '0') * 10 + (ptr[21] - '0');
+         seconds = (ptr[23] - '0') * 10 + (ptr[24] - '0');
+         if (day < 1 || day > 31) throw YaHTTP::ParseError("Unparseable date");
+         isSet = true;
+         return;
+       }
+       struct tm tm;
+       // obsolete RFC 850 and asctime formats
+       ::memset(&tm, 0, sizeof(tm));
+       if ((ptr = strptime(http_date.c_str(), "%A, %d-%b-%y %T GMT", &tm)) == NULL) {
+         ::memset(&tm, 0, sizeof(tm));
+         ptr = strptime(http_date.c_str(), "%a %b %e %T %Y", &tm);
+       }
+       if (ptr == NULL || *ptr != '\0') throw YaHTTP::ParseError("Unparseable date");
+       fromTm(&tm);
+       this->utc_offset = 0;
+     }; //<! parses HTTP-date, the IMF-fixdate format or the obsolete RFC 850 and asctime formats
+
+     time_t utctime() const {
+       // days from civil, computed without mktime so that it does not depend on local time zone
+       int y = year - (month <= 2 ? 1 : 0);
+       long era = (y >= 0 ? y : y - 399) / 400;
+       long yoe = y - era * 400;
+       long doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+       long doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+       long long days = era * 146097LL + doe - 719468;
+       return static_cast<time_t>(days * 86400 + hours * 3600 + minutes * 60 + seconds - utc_offset);
+     }; //<! returns this datetime as unixtime, taking utc_offset (in seconds) into account. cheap enough for comparing dates
+
      time_t unixtime() const {
        struct tm tm;
        tm.tm_year = year-1900;
@@ -218,73 +466,176 @@ namespace YaHTTP {
 #endif
        return mktime(&tm);
      }; //<! returns this datetime as unixtime. will not work for dates before 1970/1/1 00:00:00 GMT
+
+     bool operator==(const DateTime& rhs) const {
+       return isSet == rhs.isSet && seconds == rhs.seconds && minutes == rhs.minutes && hours == rhs.hours &&
+              day == rhs.day && month == rhs.month && year == rhs.year && wday == rhs.wday &&
+              utc_offset == rhs.utc_offset;
+     }; //<! whether all fields are equal, does not convert between UTC offsets
+
+     bool operator!=(const DateTime& rhs) const {
+       return !(*this == rhs);
+     }; //<! whether any field differs
   };
 
   /*! Various helpers needed in the code */ 
   class Utility {
   public:
-    static std::string decodeURL(const std::string& component) {
-        std::string result = component;
-        size_t pos1,pos2;
-        pos2 = 0;
-        while((pos1 = result.find_first_of("%", pos2))!=std::string::npos) {
-           std::string code;
-           char a,b,c;
-           if (pos1 + 2 > result.length()) return result; // end of result
-           code = result.substr(pos1+1, 2);
-           a = std::tolower(code[0]); b = std::tolower(code[1]);
-
-           if ((( '0' > a || a > '9') && ('a' > a || a > 'f')) ||
-              (( '0' > b || b > '9') && ('a' > b || b > 'f'))) {
-              pos2 = pos1+3;
-              continue;
-           }
-
-           if ('0' <= a && a <= '9') a = a - '0';
-           else if ('a' <= a && a <= 'f') a = a - 'a' + 0x0a;
-           if ('0' <= b && b <= '9') b = b - '0';
-           else if ('a' <= b && b <= 'f') b = b - 'a' + 0x0a;
-
-           c = (a<<4)+b;
-           result = result.replace(pos1,3,1,c);
-           pos2=pos1;
+    static void decodeURL(const char* data, size_t len, std::string& result) {
+      const char *end = data + len;
+      const char *pct;
+      result.reserve(result.size() + len);
+      // memchr skips over runs without escapes
+      while(data < end && (pct = static_cast<const char*>(::memchr(data, '%', end - data))) != NULL) {
+        result.append(data, pct);
+        if (end - pct > 2 &&
+            HEXVALUE[static_cast<unsigned char>(pct[1])] != 0xff &&
+            HEXVALUE[static_cast<unsigned char>(pct[2])] != 0xff) {
+          result += static_cast<char>((HEXVALUE[static_cast<unsigned char>(pct[1])] << 4) |
+                                       HEXVALUE[static_cast<unsigned char>(pct[2])]);
+          data = pct + 3;
+        } else {
+          // not an escape, keep as is
+          data = (end - pct > 2 ? pct + 3 : end);
+          result.append(pct, data);
         }
-        return result;
+      }
+      if (data < end) result.append(data, end);
+    }; //<! Decodes %xx from data and appends the bytes to result
+
+    static std::string decodeURL(const std::string& component) {
+      std::string result;
+      decodeURL(component.data(), component.size(), result);
+      return result;
     }; //<! Decodes %xx from string into bytes
-    
-    static std::string encodeURL(const std::string& component, bool asUrl = true) {
-      std::string result = component;
-      std::string skip = "+-.:,&;_#%[]?/@(){}=";
-      char repl[3];
-      size_t pos;
-      for(std::string::iterator iter = result.begin(); iter != result.end(); iter++) {
-        if (!YaHTTP::isalnum(*iter) && (!asUrl || skip.find(*iter) == std::string::npos)) {
-          // replace with different thing
-          pos = std::distance(result.begin(), iter);
-          ::snprintf(repl,3,"%02x", static_cast<unsigned char>(*iter));
-          result = result.replace(pos, 1, "%", 1).insert(pos+1, repl, 2);
-          iter = result.begin() + pos + 2;
-        }
+
+    static size_t safeRun(const char* data, const char* end, unsigned char safe) {
+      const char *ptr = data;
+#ifdef __SSE2__
+      // take 16 bytes at a time while they are all letters or digits, which are safe in every mode
+      const __m128i digit_lo = _mm_set1_epi8('0' - 1), digit_hi = _mm_set1_epi8('9' + 1);
+      const __m128i alpha_lo = _mm_set1_epi8('a' - 1), alpha_hi = _mm_set1_epi8('z' + 1);
+      const __m128i fold = _mm_set1_epi8(0x20);
+      while(end - ptr >= 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr));
+        __m128i l = _mm_or_si128(v, fold);
+        __m128i ok = _mm_or_si128(
+          _mm_and_si128(_mm_cmpgt_epi8(v, digit_lo), _mm_cmplt_epi8(v, digit_hi)),
+          _mm_and_si128(_mm_cmpgt_epi8(l, alpha_lo), _mm_cmplt_epi8(l, alpha_hi)));
+        if (_mm_movemask_epi8(ok) != 0xffff) break;
+        ptr += 16;
+      }
+#endif
+      while(ptr < end && (CHARCLASS[static_cast<unsigned char>(*ptr)] & safe)) ptr++;
+      return ptr - data;
+    }; //<! Length of run of bytes in class safe at data
+
+    static void encodeURL(const char* data, size_t len, std::string& result, bool asUrl = true, unsigned char urlsafe = CHAR_URL) {
+      static const char hex[] = "0123456789abcdef";
+      const unsigned char safe = (asUrl ? urlsafe : static_cast<unsigned char>(CHAR_ALNUM));
+      const char *end = data + len;
+      result.reserve(result.size() + len);
+      while(data < end) {
+        size_t n = safeRun(data, end, safe);
+        result.append(data, n);
+        data += n;
+        if (data == end) break;
+        const char escape[3] = { '%', hex[static_cast<unsigned char>(*data) >> 4], hex[static_cast<unsigned char>(*data) & 0x0f] };
+        result.append(escape, 3);
+        data++;
       }
+    }; //<! Escapes data into %xx representation when necessary and appends it to result, set asUrl to false to fully encode the url
+
+    static std::string encodeURL(const std::string& component, bool asUrl = true) {
+      std::string result;
+      encodeURL(component.data(), component.size(), result, asUrl);
       return result;
     }; //<! Escapes any characters into %xx representation when necessary, set asUrl to false to fully encode the url
 
     static std::string encodeURL(const std::wstring& component, bool asUrl = true) {
-      unsigned char const *p = reinterpret_cast<unsigned char const*>(&component[0]);
-      std::size_t s = component.size() * sizeof((*component.begin()));
-      std::vector<unsigned char> vec(p, p+s);
-
-      std::ostringstream result;
-      std::string skip = "+-.,&;_#%[]?/@(){}=";
-      for(std::vector<unsigned char>::iterator iter = vec.begin(); iter != vec.end(); iter++) {
-        if (!YaHTTP::isalnum((char)*iter) && (!asUrl || skip.find((char)*iter) == std::string::npos)) {
-          // bit more complex replace
-          result << "%" << std::hex << std::setw(2) << std::setfill('0') << static_cast<unsigned int>(*iter);
-        } else result << (char)*iter;
-      }
-      return result.str();
+      std::string result;
+      encodeURL(reinterpret_cast<const char*>(component.data()), component.size() * sizeof(wchar_t), result, asUrl, CHAR_WURL);
+      return result;
     }; //<! Escapes any characters into %xx representation when necessary, set asUrl to false to fully encode the url, for wide strings, returns ordinary string
 
+    static void encodeCookie(const char* data, size_t len, std::string& result, bool name = false) {
+      static const char hex[] = "0123456789ABCDEF";
+      const char *end = data + len;
+      result.reserve(result.size() + len);
+      for(; data < end; data++) {
+        const unsigned char c = static_cast<unsigned char>(*data);
+        // names are tokens, values cookie-octets (RFC 6265), % is escaped so that decodeURL gives data back
+        bool safe = (name ? YaHTTP::istoken(*data) : (c > 0x20 && c < 0x7f && c != '"' && c != ',' && c != ';' && c != '\\')) && c != '%';
+        if (safe) {
+          result += *data;
+        } else {
+          const char escape[3] = { '%', hex[c >> 4], hex[c & 0x0f] };
+          result.append(escape, 3);
+        }
+      }
+    }; //<! Escapes bytes not allowed in cookie name or value into %XX representation and appends data to result
+
+    static std::string normalizePath(const std::string& path) {
+      static const char hex[] = "0123456789ABCDEF";
+      std::string escaped, result;
+      std::vector<size_t> segments;
+      size_t pos, end;
+
+      // decode escaped unreserved characters and uppercase remaining escapes
+      escaped.reserve(path.size());
+      for(pos = 0; pos < path.size(); pos++) {
+        if (path[pos] == '%' && pos + 2 < path.size() &&
+            HEXVALUE[static_cast<unsigned char>(path[pos+1])] != 0xff &&
+            HEXVALUE[static_cast<unsigned char>(path[pos+2])] != 0xff) {
+          unsigned char c = (HEXVALUE[static_cast<unsigned char>(path[pos+1])] << 4) | HEXVALUE[static_cast<unsigned char>(path[pos+2])];
+          if (YaHTTP::isalnum(c) || c == '-' || c == '.' || c == '_' || c == '~') {
+            escaped += static_cast<char>(c);
+          } else {
+            escaped += '%';
+            escaped += hex[c >> 4];
+            escaped += hex[c & 0x0f];
+          }
+          pos += 2;
+        } else {
+          escaped += path[pos];
+        }
+      }
+
+      if (escaped.empty() || escaped[0] != '/') return escaped;
+
+      // remove empty and dot segments, never going above root
+      bool directory = false;
+      result.reserve(escaped.size());
+      for(pos = 1; pos <= escaped.size(); pos = end + 1) {
+        if ((end = escaped.find('/', pos)) == std::string::npos) end = escaped.size();
+        directory = true;
+        if (end == pos || (end - pos == 1 && escaped[pos] == '.')) continue;
+        if (end - pos == 2 && escaped[pos] == '.' && escaped[pos+1] == '.') {
+          if (segments.size() > 0) {
+            result.resize(segments.back());
+            segments.pop_back();
+          }
+          continue;
+        }
+        segments.push_back(result.size());
+        result += '/';
+        result.append(escaped, pos, end - pos);
+        directory = false;
+      }
+      if (result.empty() || directory) result += '/';
+      return result;
+    }; //<! Normalizes path: decodes escaped unreserved characters, uppercases escapes and removes empty, . and .. segments
+
+    static bool statusHasBody(int status) {
+      return !(status >= 100 && status < 200) && status != 204 && status != 304;
+    }; //<! whether response with this status can have a body
+
+    static std::string makeETag(time_t mtime, size_t size) {
+      std::ostringstream tag;
+      tag << "\"" << std::hex << mtime << "-" << size << "\"";
+      return tag.str();
+    }; //<! builds strong entity tag for file from its modification time and size
+
     static std::string status2text(int status) {
        switch(status) {
        case 200:
@@ -348,7 +699,7 @@ namespace YaHTTP {
        case 415:
            return "Unsupported Media Type";
        case 416:
-           return "Requested range not satisfiable";
+           return "Range Not Satisfiable";
        case 417:
            return "Expectation Failed";
        case 422:
@@ -370,80 +721,32 @@ namespace YaHTTP {
        }
     }; //<! static HTTP codes to text mappings
 
-    static strstr_map_t parseUrlParameters(const std::string& parameters) {
-      strstr_map_t parameter_map;
-      if (parameters.size() > YAHTTP_MAX_REQUEST_LINE_SIZE) {
-        return parameter_map;
-      }
-
-      std::string::size_type pos = 0;
-      while (pos != std::string::npos) {
-        // find next parameter start
-        std::string::size_type nextpos = parameters.find("&", pos);
-        std::string::size_type delim = parameters.find("=", pos);
-        if (delim > nextpos) {
-          delim = nextpos;
-        }
-        std::string key;
-        std::string value;
-        if (delim == std::string::npos) {
-          key = parameters.substr(pos);
-        } else {
-          key = parameters.substr(pos, delim-pos);
-          if (nextpos == std::string::npos) {
-            value = parameters.substr(delim+1);
-          } else {
-            value = parameters.substr(delim+1, nextpos-delim-1);
-          }
-        }
-        if (key.empty()) {
-          // no parameters at all
-          break;
-        }
-        parameter_map[decodeURL(key)] = decodeURL(value);
-        if (nextpos == std::string::npos) {
-          // no more parameters left
-          break;
-        }
-        if (parameter_map.size() >= YAHTTP_MAX_REQUEST_FIELDS) {
-          break;
-        }
-
-        pos = nextpos+1;
-      }
-      return parameter_map;
-    }; //<! parses URL parameters into string map 
+    static strstr_map_t parseUrlParameters(const std::string& parameters); //<! parses URL parameters into string map, later values replace earlier ones
 
     static bool iequals(const std::string& a, const std::string& b, size_t length) {
-      std::string::const_iterator ai, bi;
-      size_t i;
-      for(ai = a.begin(), bi = b.begin(), i = 0; ai != a.end() && bi != b.end() && i < length; ai++,bi++,i++) {
-        if (::toupper(*ai) != ::toupper(*bi)) return false;
-      }
+      size_t n = std::min(std::min(a.size(), b.size()), length);
+      if (asciiCaseCompare(a.data(), b.data(), n) != 0) return false;
 
-      if (ai == a.end() && bi == b.end()) return true;
-      if ((ai == a.end() && bi != b.end()) ||
-          (ai != a.end() && bi == b.end())) return false;
-      
-      return ::toupper(*ai) == ::toupper(*bi);
+      if (a.size() == n && b.size() == n) return true;
+      if (a.size() == n || b.size() == n) return false;
+
+      return asciiLower(a[n]) == asciiLower(b[n]);
     }; //<! case-insensitive comparison with length
 
     static bool iequals(const std::string& a, const std::string& b) {
       if (a.size() != b.size()) return false;
-      return iequals(a,b,a.size());
+      return asciiCaseCompare(a.data(), b.data(), a.size()) == 0;
     }; //<! case-insensitive comparison
 
     static void trimLeft(std::string &str) {
-       const std::locale &loc = std::locale::classic();
        std::string::iterator iter = str.begin();
-       while(iter != str.end() && YaHTTP::isspace(*iter, loc)) iter++;
+       while(iter != str.end() && YaHTTP::isspace(*iter)) iter++;
        str.erase(str.begin(), iter);
     }; //<! removes whitespace from left
 
     static void trimRight(std::string &str) {
-       const std::locale &loc = std::locale::classic();
        std::string::reverse_iterator iter = str.rbegin();
-       while(iter != str.rend() && YaHTTP::isspace(*iter, loc)) iter++;
+       while(iter != str.rend() && YaHTTP::isspace(*iter)) iter++;
        str.erase(iter.base(), str.end());
     }; //<! removes whitespace from right
 
@@ -455,19 +758,132 @@ namespace YaHTTP {
     static std::string camelizeHeader(const std::string &str) {
        std::string::const_iterator iter = str.begin();
        std::string result;
-       const std::locale &loc = std::locale::classic();
 
        bool doNext = true;
 
+       result.reserve(str.size());
        while(iter != str.end()) {
          if (doNext) 
-            result.insert(result.end(), std::toupper(*iter, loc));
+            result += asciiUpper(*iter);
          else 
-            result.insert(result.end(), std::tolower(*iter, loc)); 
+            result += asciiLower(*iter);
          doNext = (*(iter++) == '-');
        }
 
        return result;
    }; //<! camelizes headers, such as, content-type => Content-Type
   };
+
+  /*! Order preserving list of URL parameters.
+
+Keeps a copy of the parameter string and offsets of keys and values, which are decoded only when asked for.
+Keys can repeat, lookups by name are case-insensitive like with strstr_map_t.
+  */
+  class ParameterList {
+  public:
+    ParameterList() {}; //<! construct empty list
+    ParameterList(const std::string& parameters) { parse(parameters); }; //<! construct list from parameter string
+
+    void parse(const std::string& parameters, size_t maxfields = YAHTTP_MAX_REQUEST_FIELDS) {
+      size_t start, eq, pos;
+      Entry entry;
+      raw = parameters;
+      entries.clear();
+      for(start = 0, eq = std::string::npos, pos = 0; pos <= raw.size() && entries.size() < maxfields; pos++) {
+        if (pos < raw.size() && raw[pos] != '&') {
+          if (raw[pos] == '=' && eq == std::string::npos) eq = pos;
+          continue;
+        }
+        // end of pair
+        if (eq == std::string::npos) eq = pos;
+        if (eq > start) { // skip pairs without key
+          entry.key = start;
+          entry.keylen = eq - start;
+          entry.value = (eq < pos ? eq + 1 : pos);
+          entry.valuelen = pos - entry.value;
+          entries.push_back(entry);
+        }
+        start = pos + 1;
+        eq = std::string::npos;
+      }
+    }; //<! parse key=value pairs separated with &, at most maxfields pairs are kept
+
+    void clear() { raw.clear(); entries.clear(); }; //<! remove all parameters
+    size_t size() const { return entries.size(); }; //<! number of parameters
+    bool empty() const { return entries.empty(); }; //<! whether there are no parameters
+
+    StringView rawKey(size_t i) const { return StringView(raw.data() + entries[i].key, entries[i].keylen); }; //<! undecoded key of parameter i
+    StringView rawValue(size_t i) const { return StringView(raw.data() + entries[i].value, entries[i].valuelen); }; //<! undecoded value of parameter i
+
+    std::string key(size_t i) const {
+      std::string result;
+      Utility::decodeURL(raw.data() + entries[i].key, entries[i].keylen, result);
+      return result;
+    }; //<! decoded key of parameter i
+
+    std::string value(size_t i) const {
+      std::string result;
+      Utility::decodeURL(raw.data() + entries[i].value, entries[i].valuelen, result);
+      return result;
+    }; //<! decoded value of parameter i
+
+    size_t find(const std::string& name, size_t from = 0) const {
+      for(size_t i = from; i < entries.size(); i++)
+        if (keyIs(i, name)) return i;
+      return StringView::npos;
+    }; //<! index of first parameter named name at or after from, StringView::npos if not found
+
+    bool has(const std::string& name) const { return find(name) != StringView::npos; }; //<! whether parameter exists
+
+    bool get(const std::string& name, std::string& result) const {
+      size_t i = find(name);
+      if (i == StringView::npos) return false;
+      result.clear();
+      Utility::decodeURL(raw.data() + entries[i].value, entries[i].valuelen, result);
+      return true;
+    }; //<! decodes first value of name into result, returns false if not found
+
+    std::string get(const std::string& name) const {
+      std::string result;
+      get(name, result);
+      return result;
+    }; //<! decoded first value of name, empty if not found
+
+    std::vector<std::string> getAll(const std::string& name) const {
+      std::vector<std::string> result;
+      for(size_t i = find(name); i != StringView::npos; i = find(name, i + 1))
+        result.push_back(value(i));
+      return result;
+    }; //<! decoded values of all parameters named name, in order
+
+    strstr_map_t toMap() const {
+      strstr_map_t result;
+      for(size_t i = 0; i < entries.size(); i++)
+        result[key(i)] = value(i);
+      return result;
+    }; //<! convert into map, later values replace earlier ones
+
+  private:
+    struct Entry {
+      size_t key; //<! offset of key
+      size_t keylen; //<! length of key
+      size_t value; //<! offset of value
+      size_t valuelen; //<! length of value
+    };
+
+    bool keyIs(size_t i, const std::string& name) const {
+      const char *ptr = raw.data() + entries[i].key;
+      if (::memchr(ptr, '%', entries[i].keylen) != NULL)
+        return Utility::iequals(key(i), name);
+      if (entries[i].keylen != name.size()) return false;
+      return asciiCaseCompare(ptr, name.data(), name.size()) == 0;
+    }; //<! compare key of parameter i with name, decoding only when necessary
+
+    std::string raw; //<! parameter string
+    std::vector<Entry> entries; //<! parameter offsets in order
+  };
+
+  inline strstr_map_t Utility::parseUrlParameters(const std::string& parameters) {
+    return ParameterList(parameters).toMap();
+  };
 };
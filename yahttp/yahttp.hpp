@@ -15,8 +15,13 @@
 #include "url.hpp"
 #include "utility.hpp"
 #include "url.hpp"
+#include "urlcache.hpp"
 #include "cookie.hpp"
 #include "reqresp.hpp"
+#include "multipart.hpp"
+#include "compress.hpp"
+#include "filecache.hpp"
+#include "bundle.hpp"
 
 /*! \mainpage Yet Another HTTP Library Documentation
 \section sec_quick_start Quick start example